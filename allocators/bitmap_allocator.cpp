@@ -12,6 +12,7 @@ namespace physical_allocator {
         kAssert(paging::pageAligned(this->memBase), "memBase is not page aligned");
 
         this->cntPages_ = this->memSize / PAGE_SIZE;
+        this->cntFree_ = this->cntPages_;
         this->isFree_ = (bool *) this->allocatorMemory;
 
         std::fill(this->isFree_, this->isFree_ + this->cntPages_, false);
@@ -23,6 +24,7 @@ namespace physical_allocator {
                 return !x;
             })) {
                 std::fill(isFree_ + i, isFree_ + i + cntPages, true);
+                cntFree_ -= cntPages;
 
                 return memBase + i * PAGE_SIZE;
             }
@@ -41,5 +43,16 @@ namespace physical_allocator {
         kAssert(indexEnd <= cntPages_, "[P_ALLOC] Wrong index value");
 
         std::fill(isFree_ + indexStart, isFree_ + indexEnd, false);
+        cntFree_ += cntPages;
+    }
+
+    size_t BitmapAllocator::largestFreeBlock() const {
+        size_t longest = 0, run = 0;
+        for (size_t i = 0; i < cntPages_; i++) {
+            /// A set entry is an allocated page
+            run = isFree_[i] ? 0 : run + 1;
+            longest = std::max(longest, run);
+        }
+        return longest;
     }
 }
@@ -0,0 +1,146 @@
+/*
+ * buddy_allocator.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "allocators/buddy_allocator.h"
+#include "std/algorithm.h"
+
+namespace physical_allocator {
+    BuddyAllocator::BuddyAllocator(size_t memBase, size_t memSize) : Allocator(memBase, memSize) {
+        Logger::instance().println("[P_ALLOCATOR] Initializing buddy allocator...");
+        kAssert(paging::pageAligned(this->memBase), "memBase is not page aligned");
+
+        size_t cntPages = this->memSize / PAGE_SIZE;
+        kAssert(cntPages != 0, "[P_ALLOC] No memory to allocate from");
+        kAssert(cntPages < NONE, "[P_ALLOC] Too much memory for the free list links");
+
+        this->basePfn_ = this->memBase / PAGE_SIZE;
+        this->endPfn_ = this->basePfn_ + cntPages;
+        this->maxOrder_ = std::min(log2(cntPages), ORDERS - 1);
+        this->cntFree_ = 0;
+
+        this->links_ = static_cast<Link *>(this->allocatorMemory);
+        auto *words = reinterpret_cast<uint64_t *>(this->links_ + cntPages);
+        for (size_t order = 0; order <= this->maxOrder_; order++) {
+            this->heads_[order] = NONE;
+            this->blocks_[order] = blocksBetween(this->basePfn_, this->endPfn_, order);
+            this->free_[order] = words;
+
+            size_t cntWords = (this->blocks_[order] + BITS - 1) / BITS;
+            std::fill(words, words + cntWords, 0);
+            words += cntWords;
+        }
+        Logger::instance().println("[P_ALLOCATOR] %X pages, maxOrder_ = %X", cntPages, this->maxOrder_);
+
+        freeRange(this->basePfn_, cntPages);
+        Logger::instance().println("[P_ALLOCATOR] Buddy allocator initialized successfully!");
+    }
+
+    bool BuddyAllocator::isFree(size_t pfn, size_t order) const {
+        /// Blocks before the memory wrap around and are out of range too
+        size_t index = (pfn >> order) - (basePfn_ >> order);
+        if (index >= blocks_[order])
+            return false;
+        return free_[order][index / BITS] & (1ULL << (index % BITS));
+    }
+
+    void BuddyAllocator::setFree(size_t pfn, size_t order, bool free) {
+        size_t index = (pfn >> order) - (basePfn_ >> order);
+        if (free)
+            free_[order][index / BITS] |= 1ULL << (index % BITS);
+        else
+            free_[order][index / BITS] &= ~(1ULL << (index % BITS));
+    }
+
+    void BuddyAllocator::insert(size_t pfn, size_t order) {
+        auto page = static_cast<uint32_t>(pfn - basePfn_);
+        links_[page] = {heads_[order], NONE};
+        if (heads_[order] != NONE)
+            links_[heads_[order]].prev = page;
+        heads_[order] = page;
+        setFree(pfn, order, true);
+    }
+
+    void BuddyAllocator::remove(size_t pfn, size_t order) {
+        auto page = static_cast<uint32_t>(pfn - basePfn_);
+        Link link = links_[page];
+        if (link.prev != NONE)
+            links_[link.prev].next = link.next;
+        else
+            heads_[order] = link.next;
+        if (link.next != NONE)
+            links_[link.next].prev = link.prev;
+        setFree(pfn, order, false);
+    }
+
+    void BuddyAllocator::freeBlock(size_t pfn, size_t order) {
+        kAssert(!isFree(pfn, order), "[P_ALLOC] Block is already free");
+        while (order < maxOrder_) {
+            size_t buddy = pfn ^ (1ULL << order);
+            if (!isFree(buddy, order))
+                break;
+            remove(buddy, order);
+            pfn &= ~(1ULL << order);
+            order++;
+        }
+        insert(pfn, order);
+    }
+
+    void BuddyAllocator::freeRange(size_t pfn, size_t cntPages) {
+        cntFree_ += cntPages;
+        while (cntPages) {
+            size_t alignment = pfn ? __builtin_ctzll(pfn) : maxOrder_;
+            size_t order = std::min(std::min(alignment, log2(cntPages)), maxOrder_);
+            freeBlock(pfn, order);
+            pfn += 1ULL << order;
+            cntPages -= 1ULL << order;
+        }
+    }
+
+    size_t BuddyAllocator::allocateImplementation(size_t cntPages) {
+        size_t order = log2(cntPages);
+        if (cntPages != (1ULL << order))
+            order++;
+
+        size_t found = order;
+        while (found <= maxOrder_ && heads_[found] == NONE)
+            found++;
+        if (found > maxOrder_)
+            kPanic("[P_ALLOC] Can't allocate enough memory");
+
+        size_t pfn = basePfn_ + heads_[found];
+        remove(pfn, found);
+
+        /// The block is split, the left half is kept and the right half goes to the list below
+        while (found > order) {
+            found--;
+            insert(pfn + (1ULL << found), found);
+        }
+        cntFree_ -= 1ULL << order;
+
+        /// The pages past the request go back now, not when the block is freed
+        if (cntPages != (1ULL << order))
+            freeRange(pfn + cntPages, (1ULL << order) - cntPages);
+        return pfn * PAGE_SIZE;
+    }
+
+    void BuddyAllocator::freeImplementation(size_t base, size_t cntPages) {
+        kAssert(paging::pageAligned(base), "[P_ALLOC] Address to free is not page aligned");
+
+        kAssert(base >= this->memBase, "Address has to be bigger than memBase");
+        size_t pfn = base / PAGE_SIZE;
+        kAssert(pfn + cntPages <= endPfn_, "[P_ALLOC] Wrong index value");
+
+        freeRange(pfn, cntPages);
+    }
+
+    size_t BuddyAllocator::largestFreeBlock() const {
+        for (size_t order = maxOrder_ + 1; order-- > 0;) {
+            if (heads_[order] != NONE)
+                return 1ULL << order;
+        }
+        return 0;
+    }
+}
@@ -0,0 +1,167 @@
+/*
+ * hierarchical_bitmap_allocator.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "allocators/hierarchical_bitmap_allocator.h"
+#include "std/algorithm.h"
+
+namespace physical_allocator {
+    HierarchicalBitmapAllocator::HierarchicalBitmapAllocator(size_t memBase, size_t memSize, void *mapped)
+            : Allocator(memBase, memSize, mapped) {
+        kAssert(paging::pageAligned(this->memBase), "memBase is not page aligned");
+
+        this->cntPages_ = this->memSize / PAGE_SIZE;
+        kAssert(this->cntPages_ != 0, "[P_ALLOC] No memory to allocate from");
+
+        auto *words = static_cast<uint64_t *>(this->allocatorMemory);
+        size_t cntWords = (this->cntPages_ + BITS - 1) / BITS;
+        this->levels_ = 0;
+        while (true) {
+            kAssert(this->levels_ < MAX_LEVELS, "[P_ALLOC] Too much memory for the bitmap levels");
+            this->bits_[this->levels_] = words;
+            this->words_[this->levels_] = cntWords;
+            this->levels_++;
+            words += cntWords;
+            if (cntWords == 1)
+                break;
+            cntWords = (cntWords + BITS - 1) / BITS;
+        }
+        Logger::instance().println("[P_ALLOCATOR] Bitmap of %X pages in %X levels", this->cntPages_, this->levels_);
+
+        /// Everything starts allocated, so the bits past the last page stay set and are never handed out
+        for (size_t level = 0; level < this->levels_; level++)
+            std::fill(this->bits_[level], this->bits_[level] + this->words_[level], FULL);
+        markRange(0, this->cntPages_, false);
+        this->cntFree_ = this->cntPages_;
+    }
+
+    void HierarchicalBitmapAllocator::updateSummary(size_t index) {
+        for (size_t level = 1; level < levels_; level++) {
+            bool full = bits_[level - 1][index] == FULL;
+            uint64_t &summary = bits_[level][index / BITS];
+            bool wasFull = summary == FULL;
+            if (full)
+                summary |= bit(index);
+            else
+                summary &= ~bit(index);
+
+            /// The levels above only care whether the whole word is full
+            if ((summary == FULL) == wasFull)
+                return;
+            index /= BITS;
+        }
+    }
+
+    void HierarchicalBitmapAllocator::markRange(size_t first, size_t cntPages, bool used) {
+        size_t end = first + cntPages;
+        while (first < end) {
+            size_t offset = first % BITS;
+            size_t length = std::min(BITS - offset, end - first);
+            uint64_t mask = (length == BITS ? FULL : (1ULL << length) - 1) << offset;
+
+            uint64_t &word = bits_[0][first / BITS];
+            if (used) {
+                kAssert((word & mask) == 0, "[P_ALLOC] Page is already allocated");
+                word |= mask;
+            } else {
+                kAssert((word & mask) == mask, "[P_ALLOC] Page is already free");
+                word &= ~mask;
+            }
+            updateSummary(first / BITS);
+            first += length;
+        }
+    }
+
+    size_t HierarchicalBitmapAllocator::findPage() {
+        if (bits_[levels_ - 1][0] == FULL)
+            kPanic("[P_ALLOC] Can't allocate enough memory");
+
+        /// A clear bit means the word below it has a free page
+        size_t index = 0;
+        for (size_t level = levels_; level-- > 0;)
+            index = index * BITS + __builtin_ctzll(~bits_[level][index]);
+        return index;
+    }
+
+    size_t HierarchicalBitmapAllocator::findRun(size_t cntPages) {
+        size_t order = 63 - __builtin_clzll(cntPages);
+        size_t run = 0, runStart = 0, longestSkipped = 0;
+
+        for (size_t index = hints_[order] / BITS; index < words_[0]; index++) {
+            if (levels_ > 1) {
+                uint64_t summary = bits_[1][index / BITS];
+                if (summary & bit(index)) {
+                    longestSkipped = std::max(longestSkipped, run);
+                    run = 0;
+                    /// The whole group is full, go to the next one
+                    if (summary == FULL)
+                        index |= BITS - 1;
+                    continue;
+                }
+            }
+
+            uint64_t used = bits_[0][index];
+            for (size_t offset = 0; offset < BITS;) {
+                uint64_t rest = used >> offset;
+                if (rest & 1) {
+                    /// The shift filled the top with zeros, so the used pages end at the first of them
+                    size_t length = ~rest ? __builtin_ctzll(~rest) : BITS - offset;
+                    longestSkipped = std::max(longestSkipped, run);
+                    run = 0;
+                    offset += length;
+                    continue;
+                }
+
+                size_t length = rest ? __builtin_ctzll(rest) : BITS - offset;
+                if (run == 0)
+                    runStart = index * BITS + offset;
+                run += length;
+                offset += length;
+
+                if (run >= cntPages) {
+                    /// Every run the walk went past was too short, so none of this order starts before the new one
+                    if (longestSkipped < (1ULL << order))
+                        hints_[order] = runStart + cntPages;
+                    return runStart;
+                }
+            }
+        }
+        kPanic("[P_ALLOC] Can't allocate enough memory");
+        return 0;
+    }
+
+    size_t HierarchicalBitmapAllocator::allocateImplementation(size_t cntPages) {
+        size_t first = cntPages == 1 ? findPage() : findRun(cntPages);
+        markRange(first, cntPages, true);
+        cntFree_ -= cntPages;
+        return memBase + first * PAGE_SIZE;
+    }
+
+    void HierarchicalBitmapAllocator::freeImplementation(size_t base, size_t cntPages) {
+        kAssert(paging::pageAligned(base), "[P_ALLOC] Address to free is not page aligned");
+
+        kAssert(base >= this->memBase, "Address has to be bigger than memBase");
+        auto indexStart = (base - this->memBase) / PAGE_SIZE;
+        kAssert(indexStart + cntPages <= cntPages_, "[P_ALLOC] Wrong index value");
+
+        markRange(indexStart, cntPages, false);
+        cntFree_ += cntPages;
+
+        /// A run that now starts before a hint was shorter than its order before it reached the freed pages
+        for (size_t order = 1; order < ORDERS; order++) {
+            size_t reach = std::min(indexStart, (size_t{1} << order) - 1);
+            hints_[order] = std::min(hints_[order], indexStart - reach);
+        }
+    }
+
+    size_t HierarchicalBitmapAllocator::largestFreeBlock() const {
+        size_t longest = 0, run = 0;
+        for (size_t page = 0; page < cntPages_; page++) {
+            run = bits_[0][page / BITS] & bit(page) ? 0 : run + 1;
+            longest = std::max(longest, run);
+        }
+        return longest;
+    }
+}
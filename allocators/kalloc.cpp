@@ -13,164 +13,149 @@
  */
 
 #include "allocators/kalloc.h"
-#include "std/vector_early.h"
 #include "allocators/virtual_allocator.h"
+#include "allocators/slab.h"
+#include "allocators/tlsf.h"
+#include "allocators/magazine.h"
+#include "std/cstring.h"
+#include "std/algorithm.h"
 
 namespace kalloc {
     constexpr const size_t PAGE_SIZE = paging::PAGE_SIZE;
-    /*!
-     * The heap is organized in arenas, arenas are independent heaps
-     * For each arena we will use a linked list to allocate memory
-     */
-
-    constexpr const size_t ARENA_SIZE_PAGES = 8;
-    constexpr const size_t ARENA_SIZE = ARENA_SIZE_PAGES * PAGE_SIZE;
     /// Any bigger than this and we will allocate entire pages
     constexpr const size_t MMAP_THRESHOLD = PAGE_SIZE;
+    /// Below this many free pages the objects cached in magazines are given back
+    constexpr const size_t PRESSURE_LOW = 512;
+    /// After a reclaim, the next one waits until free memory went back above this
+    constexpr const size_t PRESSURE_HIGH = 1024;
+    /// Or until this many allocations later, if memory stays low the magazines fill up again meanwhile
+    constexpr const size_t RECLAIM_INTERVAL = 4096;
+
+    bool reclaimed = false; ///> Set by a reclaim, cleared once free memory is above PRESSURE_HIGH
+    size_t sinceReclaim = 0; ///> Allocations under pressure since the last reclaim
+
+    /// Checked before any lock is taken, reclaiming frees into the slabs and the VirtualAllocator
+    void relievePressure() {
+        size_t freePages = virtual_allocator::VirtualAllocator::instance()->freePages();
+        if (freePages >= PRESSURE_HIGH) {
+            __atomic_store_n(&reclaimed, false, __ATOMIC_RELAXED);
+            return;
+        }
+        if (freePages >= PRESSURE_LOW)
+            return;
+        if (__atomic_load_n(&reclaimed, __ATOMIC_RELAXED) &&
+            __atomic_add_fetch(&sinceReclaim, 1, __ATOMIC_RELAXED) < RECLAIM_INTERVAL)
+            return;
+
+        __atomic_store_n(&reclaimed, true, __ATOMIC_RELAXED);
+        __atomic_store_n(&sinceReclaim, 0, __ATOMIC_RELAXED);
+        reclaim();
+    }
 
     /// Statistics for mmap
     size_t mmapedPointers = 0, mmapedMemory = 0, maxMmapedMemory = 0;
 
-    std::vector_early<MmapedRegion, virtual_allocator::virtualStdAllocator<MmapedRegion>>
-            mmapedRegions{virtual_allocator::virtualStdAllocator<MmapedRegion>()};
+    /// Sizes between the slab classes and whole pages
+    Tlsf heap;
+    /// Guards the heap and the mmap statistics, slabs and magazines have their own locks
+    locking::SpinLock heapLock;
+
+    /// One entry per page of the kernel heap, indexed by the page number from heapStart
+    PageOwner *owners = nullptr;
+    size_t heapStart = 0, heapPages = 0;
+
+    void setOwner(void *start, size_t pages, Owner owner, size_t data) {
+        size_t first = ((size_t) start - heapStart) / PAGE_SIZE;
+        kAssert((size_t) start >= heapStart && first + pages <= heapPages, "[KALLOC] Page outside of the heap");
+        for (size_t i = 0; i < pages; i++)
+            owners[first + i] = {(uint64_t) owner, data};
+    }
 
-    std::vector_early<Arena, virtual_allocator::virtualStdAllocator<Arena>>
-            arenas{virtual_allocator::virtualStdAllocator<Arena>()};
+    PageOwner ownerOf(const void *ptr) {
+        size_t page = ((size_t) ptr - heapStart) / PAGE_SIZE;
+        if ((size_t) ptr < heapStart || page >= heapPages)
+            return {};
+        return owners[page];
+    }
 
     void *allocMmaped(size_t size) {
         size_t cntPages = size / PAGE_SIZE + ((size % PAGE_SIZE == 0) ? 0 : 1);
         Logger::instance().println("[KALLOC] Allocating %X pages via mmap", cntPages);
 
         kAssert(cntPages > 0, "[V_ALLOC] Mmap should allocate at least one page");
+        locking::Guard<locking::SpinLock> guard(heapLock);
         void *ptr = virtual_allocator::VirtualAllocator::instance()->vAlloc(cntPages);
-        for (auto &mmapedRegion: mmapedRegions)
-            if (mmapedRegion.isEmpty()) {
-                mmapedRegion = {ptr, cntPages};
-
-                // Statistics
-                mmapedPointers++;
-                mmapedMemory += cntPages;
-                maxMmapedMemory = std::max(maxMmapedMemory, mmapedMemory);
-
-                return ptr;
-            }
-        mmapedRegions.push_back({ptr, cntPages});
+        /// Only the first page, a free always gets the start of the region
+        setOwner(ptr, 1, Owner::MMAPED, cntPages);
 
+        // Statistics
         mmapedPointers++;
         mmapedMemory += cntPages;
         maxMmapedMemory = std::max(maxMmapedMemory, mmapedMemory);
 
         return ptr;
-        // __builtin_unreachable();
-        return nullptr; // unreachable
     }
 
 
-    Arena::Arena(void *start, size_t size) {
-        kAssert(size >= sizeof(MemoryChunk), "[KALLOC] Size should be bigger than a memory chunk!");
-        this->first = (MemoryChunk *) start;
-        this->totalSize = size;
-
-        this->first->allocated = false;
-        this->first->prev = nullptr;
-        this->first->next = nullptr;
-        this->first->size = size - sizeof(MemoryChunk);
+    const Tlsf &generalHeap() {
+        return heap;
     }
 
-    [[nodiscard]] void *Arena::malloc(size_t size) const {
-        MemoryChunk *result = nullptr;
-
-        for (MemoryChunk *chunk = first; chunk != nullptr && result == nullptr; chunk = chunk->next)
-            if (chunk->size >= size && !chunk->allocated)
-                result = chunk;
-
-        if (result == nullptr)
-            return nullptr;
-
-        if (result->size >= size + sizeof(MemoryChunk) + 1) {
-            auto *temp = (MemoryChunk *) ((size_t) result + sizeof(MemoryChunk) + size);
-
-            temp->allocated = false;
-            temp->size = result->size - size - sizeof(MemoryChunk);
-            temp->prev = result;
-            temp->next = result->next;
-            if (temp->next != nullptr)
-                temp->next->prev = temp;
-
-            result->size = size;
-            result->next = temp;
-        }
-
-        result->allocated = true;
-        return (void *) (((size_t) result) + sizeof(MemoryChunk));
-    }
-
-    void Arena::free(void *ptr) {
-        auto *chunk = (MemoryChunk *) ((size_t) ptr - sizeof(MemoryChunk));
-
-        chunk->allocated = false;
-
-        if (chunk->prev != nullptr && !chunk->prev->allocated) {
-            chunk->prev->next = chunk->next;
-            chunk->prev->size += chunk->size + sizeof(MemoryChunk);
-            if (chunk->next != nullptr)
-                chunk->next->prev = chunk->prev;
-
-            chunk = chunk->prev;
-        }
-
-        if (chunk->next != nullptr && !chunk->next->allocated) {
-            chunk->size += chunk->next->size + sizeof(MemoryChunk);
-            chunk->next = chunk->next->next;
-            if (chunk->next != nullptr)
-                chunk->next->prev = chunk;
-        }
-
-    }
-
-
     void init() {
         Logger::instance().println("[KALLOC] Initializing...");
-        mmapedRegions.resize(4096);
-        std::fill(mmapedRegions.begin(), mmapedRegions.end(), MmapedRegion{});
-        arenas.reserve(1024);
+        auto allocator = virtual_allocator::VirtualAllocator::instance();
+        heapStart = allocator->virtualStart();
+        heapPages = (allocator->virtualEnd() - heapStart) / PAGE_SIZE;
+        size_t mapPages = physical_allocator::toPages(heapPages * sizeof(PageOwner));
+        owners = static_cast<PageOwner *>(allocator->vAlloc(mapPages));
+        memset(owners, 0, heapPages * sizeof(PageOwner));
+        Logger::instance().println("[KALLOC] Owner map of %X pages for %X heap pages", mapPages, heapPages);
         Logger::instance().println("[KALLOC] Finished initializing");
     }
 
     void *kAlloc(size_t size) {
+        relievePressure();
+
         if (size >= MMAP_THRESHOLD) {
             return allocMmaped(size);
         }
-        Logger::instance().println("[KALLOC] Allocating %X bytes into arenas", size);
-        for (auto it: arenas) {
-            auto ptr = it.malloc(size);
-            if (ptr != nullptr)
-                return ptr;
+        /// Small objects come from the slab of their size class, without a header, through the magazines
+        if (slabSize(size)) {
+            return magazineAlloc(slabClass(size));
         }
-        Logger::instance().println("[KALLOC] Allocating new arena...");
-        void *arenaStart = virtual_allocator::VirtualAllocator::instance()->vAlloc(ARENA_SIZE_PAGES);
-        Logger::instance().println("[KALLOC] Allocated memory for arena!");
-        arenas.push_back({arenaStart, ARENA_SIZE});
-        Logger::instance().println("[KALLOC] Allocating into new arena...");
-        return arenas.back().malloc(size);
+        locking::Guard<locking::SpinLock> guard(heapLock);
+        auto ptr = heap.malloc(size);
+        kAssert(ptr, "[KALLOC] Out of heap memory");
+        return ptr;
     }
 
 
     void kFree(void *ptr) {
-        /// If it is mmaped, release that memory and return
-        for (auto &mmapedRegion: mmapedRegions)
-            if (!mmapedRegion.isEmpty() && mmapedRegion.ptr == ptr) {
-                virtual_allocator::VirtualAllocator::instance()->vFree(ptr, mmapedRegion.cntPages);
-                mmapedRegion = {nullptr, 0};
+        /// The page of the pointer says who allocated it, whatever the size of the heap
+        auto owner = ownerOf(ptr);
+        switch (owner.kind()) {
+            case Owner::MMAPED: {
+                kAssert((size_t) ptr % PAGE_SIZE == 0, "[KALLOC] Pointer is inside of an mmaped region");
+                locking::Guard<locking::SpinLock> guard(heapLock);
+                virtual_allocator::VirtualAllocator::instance()->vFree(ptr, owner.data);
+                setOwner(ptr, 1, Owner::NONE);
+                mmapedPointers--;
+                mmapedMemory -= owner.data;
                 return;
             }
-
-        for (auto it: arenas)
-            if (ptr >= it.first && ptr < it.first + it.totalSize) {
-                it.free(ptr);
+            case Owner::HEAP: {
+                locking::Guard<locking::SpinLock> guard(heapLock);
+                heap.free(ptr);
                 return;
             }
-
-        kPanic("[KALLOC] We should have freed the pointer by now!");
+            case Owner::SLAB: {
+                auto slab = slabOf(ptr);
+                kAssert(slab, "[KALLOC] Slab page without a slab header");
+                magazineFree(slabIndex(slab), ptr);
+                return;
+            }
+            default:
+                kPanic("[KALLOC] We should have freed the pointer by now!");
+        }
     }
-}
\ No newline at end of file
+}
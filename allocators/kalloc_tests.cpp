@@ -9,6 +9,9 @@
 #include "arch/x86_64/logging.h"
 #include "arch/x86_64/exceptions.h"
 #include "allocators/kalloc.h"
+#include "allocators/slab.h"
+#include "allocators/tlsf.h"
+#include "allocators/magazine.h"
 #include "std/new_custom.h"
 
 namespace kalloc::tests {
@@ -34,7 +37,8 @@ namespace kalloc::tests {
         // Verify that allocations are consecutive
         auto *addrNext = (uint8_t *) new MyObject[4];
         Logger::instance().println("[KALLOC] addr: %X, addrNext: %X", addr, addrNext);
-        auto *expectedAddress = addr + 4 * sizeof(MyObject) + sizeof(MemoryChunk);
+        // Both come from the same slab, objects have no header
+        auto *expectedAddress = addr + 4 * sizeof(MyObject);
         Logger::instance().println("[KALLOC] Expected addrNext: %X", expectedAddress);
         kAssert(addrNext == expectedAddress, "[KALLOC] Subsequent allocation is not consecutive");
 
@@ -54,6 +58,96 @@ namespace kalloc::tests {
         delete[] addr3; // Cleanup
     }
 
+    void testSlabClasses() {
+        kAssert(slabClass(1) == 0 && slabClass(16) == 0 && slabClass(17) == 1 && slabClass(24) == 1 &&
+                slabClass(25) == 2 && slabClass(769) == SLAB_CLASSES - 1 &&
+                slabClass(SLAB_MAX_OBJECT) == SLAB_CLASSES - 1, "[KALLOC] Wrong slab class");
+
+        // More objects than fit a slab, then all of them freed and reclaimed from the magazines
+        reclaim();
+        auto &cache = slabCache(slabClass(sizeof(MyObject)));
+        size_t slabs = cache.slabs, objects = cache.objects;
+        constexpr size_t count = 2 * SLAB_SIZE / sizeof(MyObject);
+        MyObject *allocated[count];
+        for (auto &object: allocated)
+            object = new MyObject();
+        kAssert(cache.slabs > slabs + 1 && cache.objects == objects + count, "[KALLOC] Slabs were not added");
+
+        for (auto object: allocated)
+            delete object;
+        // Freed objects stay in the magazines until they are reclaimed
+        reclaim();
+        kAssert(cache.objects == objects && cache.slabs <= slabs, "[KALLOC] Empty slabs were not released");
+    }
+
+    void testOwnerMap() {
+        auto *small = new MyObject();
+        auto *big = new uint8_t[3 * paging::PAGE_SIZE];
+        kAssert(ownerOf(small).kind() == Owner::SLAB, "[KALLOC] Small object should be owned by a slab");
+        kAssert(ownerOf(big).kind() == Owner::MMAPED && ownerOf(big).data == 3,
+                "[KALLOC] Big allocation should be mmaped with its page count");
+        kAssert(ownerOf(nullptr).kind() == Owner::NONE, "[KALLOC] Null is outside of the heap");
+
+        delete[] big;
+        kAssert(ownerOf(big).kind() == Owner::NONE, "[KALLOC] Freed region still has an owner");
+        delete small;
+    }
+
+    void testGeneralHeap() {
+        auto &heap = generalHeap();
+        // The heap keeps its last chunk, make sure it has one
+        delete[] new uint8_t[SLAB_MAX_OBJECT + 1];
+        size_t freeBytes = heap.freeBytes(), chunks = heap.chunks();
+
+        // Enough medium blocks to need more chunks, freed in an order that leaves holes until the end
+        constexpr size_t count = 256;
+        uint8_t *blocks[count];
+        for (size_t i = 0; i < count; i++) {
+            size_t size = SLAB_MAX_OBJECT + 1 + (i * 97) % (paging::PAGE_SIZE - SLAB_MAX_OBJECT - 1);
+            blocks[i] = new uint8_t[size];
+            kAssert(ownerOf(blocks[i]).kind() == Owner::HEAP && (size_t) blocks[i] % Tlsf::ALIGN == 0,
+                    "[KALLOC] Medium block should come aligned from the heap");
+            blocks[i][0] = blocks[i][size - 1] = (uint8_t) i;
+        }
+        kAssert(heap.chunks() > chunks, "[KALLOC] Heap should have grown");
+
+        for (size_t i = 0; i < count; i += 2)
+            delete[] blocks[i];
+        for (size_t i = 1; i < count; i += 2)
+            delete[] blocks[i];
+
+        // Everything was coalesced back and the chunks that were added are gone
+        kAssert(heap.freeBytes() == freeBytes && heap.chunks() == chunks, "[KALLOC] Heap was not coalesced");
+    }
+
+    void testMagazines() {
+        // A loop of new and delete is served by the magazines of the CPU
+        auto before = magazineStats(locking::cpu());
+        for (size_t i = 0; i < 100; i++)
+            delete new MyObject();
+        auto after = magazineStats(locking::cpu());
+        kAssert(after.hits >= before.hits + 99 && after.misses <= before.misses + 1,
+                "[KALLOC] Magazines should serve a loop of new and delete");
+
+        // Objects freed past two magazines go through the depot and come back from it
+        constexpr size_t count = 4 * MAGAZINE_ROUNDS;
+        MyObject *objects[count];
+        for (auto &object: objects)
+            object = new MyObject();
+        for (auto object: objects)
+            delete object;
+        before = magazineStats(locking::cpu());
+        for (auto &object: objects)
+            object = new MyObject();
+        after = magazineStats(locking::cpu());
+        kAssert(after.depotHits > before.depotHits && after.misses == before.misses,
+                "[KALLOC] Full magazines should come back from the depot");
+        for (auto object: objects)
+            delete object;
+
+        kAssert(reclaim() >= count, "[KALLOC] Cached objects were not reclaimed");
+    }
+
     void runAllTests() {
         Logger::instance().println("[KALLOC] Running testAllocateSingle...");
         testAllocateSingle();
@@ -66,5 +160,21 @@ namespace kalloc::tests {
         Logger::instance().println("[KALLOC] Running testEdgeWraparound...");
         testEdgeWraparound();
         Logger::instance().println("[KALLOC] Success!");
+
+        Logger::instance().println("[KALLOC] Running testSlabClasses...");
+        testSlabClasses();
+        Logger::instance().println("[KALLOC] Success!");
+
+        Logger::instance().println("[KALLOC] Running testOwnerMap...");
+        testOwnerMap();
+        Logger::instance().println("[KALLOC] Success!");
+
+        Logger::instance().println("[KALLOC] Running testGeneralHeap...");
+        testGeneralHeap();
+        Logger::instance().println("[KALLOC] Success!");
+
+        Logger::instance().println("[KALLOC] Running testMagazines...");
+        testMagazines();
+        Logger::instance().println("[KALLOC] Success!");
     }
 }
\ No newline at end of file
@@ -0,0 +1,188 @@
+/*
+ * magazine.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "allocators/magazine.h"
+#include "allocators/slab.h"
+#include "arch/x86_64/exceptions.h"
+#include "util/locks.h"
+#include "std/utility.h"
+#include "std/initializer_list.h"
+
+namespace kalloc {
+    namespace {
+        static_assert(sizeof(Magazine) == 128, "A magazine should fill its slab class");
+
+        struct Depot {
+            locking::SpinLock lock;
+            Magazine *full{}, *empty{};
+            size_t fullCount{};
+        };
+
+        CpuCache cpuCaches[MAX_CPUS][SLAB_CLASSES];
+        Depot depots[SLAB_CLASSES];
+
+        /// Magazines come straight from their slab, not through the magazines of their own class
+        Magazine *newMagazine() {
+            auto *magazine = static_cast<Magazine *>(slabCache(slabClass(sizeof(Magazine))).alloc());
+            magazine->rounds = 0;
+            magazine->next = nullptr;
+            return magazine;
+        }
+
+        void deleteMagazine(Magazine *magazine) {
+            slabFree(slabOf(magazine), magazine);
+        }
+
+        /// Gives the rounds of a magazine back to their slabs
+        size_t drain(Magazine *magazine) {
+            size_t rounds = magazine->rounds;
+            while (magazine->rounds) {
+                void *ptr = magazine->objects[--magazine->rounds];
+                slabFree(slabOf(ptr), ptr);
+            }
+            return rounds;
+        }
+
+        Magazine *pop(Magazine *&list) {
+            Magazine *magazine = list;
+            if (magazine)
+                list = magazine->next;
+            return magazine;
+        }
+
+        void push(Magazine *&list, Magazine *magazine) {
+            magazine->next = list;
+            list = magazine;
+        }
+
+        CpuCache &cpuCache(size_t index) {
+            size_t cpu = locking::cpu();
+            kAssert(cpu < MAX_CPUS, "[KALLOC] More CPUs than magazines");
+            return cpuCaches[cpu][index];
+        }
+    }
+
+    void *magazineAlloc(size_t index) {
+        CpuCache &cache = cpuCache(index);
+        if (cache.loaded && cache.loaded->rounds) {
+            cache.hits++;
+            return cache.loaded->objects[--cache.loaded->rounds];
+        }
+        if (cache.previous && cache.previous->rounds) {
+            std::swap(cache.loaded, cache.previous);
+            cache.hits++;
+            return cache.loaded->objects[--cache.loaded->rounds];
+        }
+
+        /// Both are empty, the previous one goes to the depot in exchange for a full one
+        Depot &depot = depots[index];
+        {
+            locking::Guard<locking::SpinLock> guard(depot.lock);
+            if (Magazine *full = pop(depot.full)) {
+                depot.fullCount--;
+                if (cache.previous)
+                    push(depot.empty, cache.previous);
+                cache.previous = cache.loaded;
+                cache.loaded = full;
+                cache.depotHits++;
+                return cache.loaded->objects[--cache.loaded->rounds];
+            }
+        }
+
+        cache.misses++;
+        return slabCache(index).alloc();
+    }
+
+    void magazineFree(size_t index, void *ptr) {
+        CpuCache &cache = cpuCache(index);
+        if (cache.loaded && cache.loaded->rounds < MAGAZINE_ROUNDS) {
+            cache.loaded->objects[cache.loaded->rounds++] = ptr;
+            return;
+        }
+        if (cache.previous && cache.previous->rounds < MAGAZINE_ROUNDS) {
+            std::swap(cache.loaded, cache.previous);
+            cache.loaded->objects[cache.loaded->rounds++] = ptr;
+            return;
+        }
+
+        /// Both are full, the previous one goes to the depot and an empty one is loaded
+        Depot &depot = depots[index];
+        Magazine *empty, *overflow = nullptr;
+        {
+            locking::Guard<locking::SpinLock> guard(depot.lock);
+            if (cache.previous) {
+                if (depot.fullCount < DEPOT_FULL_LIMIT) {
+                    push(depot.full, cache.previous);
+                    depot.fullCount++;
+                } else {
+                    overflow = cache.previous;
+                }
+            }
+            empty = pop(depot.empty);
+        }
+
+        /// The depot has enough full magazines, the objects go back to the slabs and the magazine is reused
+        if (overflow) {
+            drain(overflow);
+            if (empty)
+                deleteMagazine(overflow);
+            else
+                empty = overflow;
+        }
+        if (!empty)
+            empty = newMagazine();
+
+        cache.previous = cache.loaded;
+        cache.loaded = empty;
+        cache.loaded->objects[cache.loaded->rounds++] = ptr;
+    }
+
+    size_t reclaim() {
+        size_t objects = 0;
+        size_t cpu = locking::cpu();
+        for (size_t index = 0; index < SLAB_CLASSES; index++) {
+            CpuCache &cache = cpuCaches[cpu][index];
+            for (Magazine *magazine: {cache.loaded, cache.previous}) {
+                if (magazine) {
+                    objects += drain(magazine);
+                    deleteMagazine(magazine);
+                }
+            }
+            cache.loaded = cache.previous = nullptr;
+
+            /// The lists are taken out of the depot first, the slabs are not called under its lock
+            Magazine *full, *empty;
+            {
+                Depot &depot = depots[index];
+                locking::Guard<locking::SpinLock> guard(depot.lock);
+                full = depot.full;
+                empty = depot.empty;
+                depot.full = depot.empty = nullptr;
+                depot.fullCount = 0;
+            }
+            while (Magazine *magazine = pop(full)) {
+                objects += drain(magazine);
+                deleteMagazine(magazine);
+            }
+            while (Magazine *magazine = pop(empty))
+                deleteMagazine(magazine);
+        }
+
+        for (size_t index = 0; index < SLAB_CLASSES; index++)
+            slabCache(index).releaseSpare();
+        return objects;
+    }
+
+    MagazineStats magazineStats(size_t cpu) {
+        MagazineStats stats{};
+        for (auto &cache: cpuCaches[cpu]) {
+            stats.hits += cache.hits;
+            stats.depotHits += cache.depotHits;
+            stats.misses += cache.misses;
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,167 @@
+/*
+ * slab.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "allocators/slab.h"
+#include "allocators/virtual_allocator.h"
+#include "allocators/kalloc.h"
+
+namespace kalloc {
+    namespace {
+        constexpr const uint64_t SLAB_MAGIC = 0x51AB51AB51AB51ABULL;
+        constexpr const size_t SLAB_HEADER = 64; ///> Objects start after the header, aligned to a cache line
+
+        static_assert(sizeof(Slab) <= SLAB_HEADER, "The slab header has to fit before the objects");
+
+        constexpr size_t classSize(size_t index) {
+            /// Even classes are powers of two, odd ones are 1.5 times the power before them
+            size_t power = SLAB_MIN_OBJECT << (index / 2);
+            return index % 2 ? power + power / 2 : power;
+        }
+
+        static_assert(classSize(SLAB_CLASSES - 1) == SLAB_MAX_OBJECT, "The last class has to be the biggest object");
+
+        SlabCache caches[SLAB_CLASSES]{
+                {classSize(0)}, {classSize(1)}, {classSize(2)}, {classSize(3)}, {classSize(4)},
+                {classSize(5)}, {classSize(6)}, {classSize(7)}, {classSize(8)}, {classSize(9)},
+                {classSize(10)}, {classSize(11)}, {classSize(12)},
+        };
+
+        uint8_t *firstObject(Slab *slab) {
+            return reinterpret_cast<uint8_t *>(slab) + SLAB_HEADER;
+        }
+
+        void pushPartial(SlabCache *cache, Slab *slab) {
+            slab->prev = nullptr;
+            slab->next = cache->partial;
+            if (cache->partial)
+                cache->partial->prev = slab;
+            cache->partial = slab;
+        }
+
+        void removePartial(SlabCache *cache, Slab *slab) {
+            if (slab->prev)
+                slab->prev->next = slab->next;
+            else
+                cache->partial = slab->next;
+            if (slab->next)
+                slab->next->prev = slab->prev;
+            slab->prev = slab->next = nullptr;
+        }
+
+        Slab *newSlab(SlabCache *cache) {
+            auto *slab = static_cast<Slab *>(virtual_allocator::VirtualAllocator::instance()->vAlloc(1));
+            *slab = {SLAB_MAGIC, cache, nullptr, nullptr, nullptr, 0, 0,
+                     (uint32_t) ((SLAB_SIZE - SLAB_HEADER) / cache->objectSize)};
+            setOwner(slab, 1, Owner::SLAB);
+            cache->slabs++;
+            return slab;
+        }
+
+        void releaseSlab(SlabCache *cache, Slab *slab) {
+            slab->magic = 0;
+            setOwner(slab, 1, Owner::NONE);
+            cache->slabs--;
+            virtual_allocator::VirtualAllocator::instance()->vFree(slab, 1);
+        }
+    }
+
+    size_t slabClass(size_t size) {
+        if (size <= SLAB_MIN_OBJECT)
+            return 0;
+
+        /// size is in (2^power, 2^(power + 1)], the lower half of that range is the 1.5 class
+        size_t power = 63 - __builtin_clzll(size - 1);
+        size_t index = 2 * (power - 4);
+        return size <= (3ULL << (power - 1)) ? index + 1 : index + 2;
+    }
+
+    void *SlabCache::alloc() {
+        locking::Guard<locking::SpinLock> guard(lock);
+        Slab *slab = partial;
+        if (!slab) {
+            if (spare) {
+                slab = spare;
+                spare = nullptr;
+            } else {
+                slab = newSlab(this);
+            }
+            pushPartial(this, slab);
+        }
+
+        void *ptr;
+        if (slab->free) {
+            ptr = slab->free;
+            slab->free = *static_cast<void **>(ptr);
+        } else {
+            ptr = firstObject(slab) + slab->fresh * objectSize;
+            slab->fresh++;
+        }
+
+        slab->used++;
+        objects++;
+        if (slab->used == slab->capacity)
+            removePartial(this, slab);
+        return ptr;
+    }
+
+    void SlabCache::free(Slab *slab, void *ptr) {
+        kAssert((size_t) (static_cast<uint8_t *>(ptr) - firstObject(slab)) % objectSize == 0,
+                "[KALLOC] Pointer is not the start of a slab object");
+        locking::Guard<locking::SpinLock> guard(lock);
+
+        /// A full slab is back in the partial list as soon as it has a free object
+        if (slab->used == slab->capacity)
+            pushPartial(this, slab);
+
+        *static_cast<void **>(ptr) = slab->free;
+        slab->free = ptr;
+        slab->used--;
+        objects--;
+        if (slab->used)
+            return;
+
+        /// Empty, the page goes back unless it becomes the spare
+        removePartial(this, slab);
+        if (spare) {
+            releaseSlab(this, slab);
+        } else {
+            slab->free = nullptr;
+            slab->fresh = 0;
+            spare = slab;
+        }
+    }
+
+    void SlabCache::releaseSpare() {
+        locking::Guard<locking::SpinLock> guard(lock);
+        if (spare) {
+            releaseSlab(this, spare);
+            spare = nullptr;
+        }
+    }
+
+    void *slabAlloc(size_t size) {
+        return caches[slabClass(size)].alloc();
+    }
+
+    Slab *slabOf(void *ptr) {
+        auto *slab = reinterpret_cast<Slab *>(reinterpret_cast<size_t>(ptr) & ~(SLAB_SIZE - 1));
+        if ((void *) slab == ptr || slab->magic != SLAB_MAGIC)
+            return nullptr;
+        return slab;
+    }
+
+    void slabFree(Slab *slab, void *ptr) {
+        slab->cache->free(slab, ptr);
+    }
+
+    size_t slabIndex(const Slab *slab) {
+        return slab->cache - caches;
+    }
+
+    SlabCache &slabCache(size_t index) {
+        return caches[index];
+    }
+}
@@ -0,0 +1,176 @@
+/*
+ * tlsf.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "allocators/tlsf.h"
+#include "allocators/kalloc.h"
+#include "allocators/virtual_allocator.h"
+#include "std/algorithm.h"
+
+namespace kalloc {
+    namespace {
+        size_t fls(size_t value) {
+            return 63 - __builtin_clzll(value);
+        }
+    }
+
+    void Tlsf::mapping(size_t size, size_t &fl, size_t &sl) {
+        if (size < SMALL_BLOCK) {
+            fl = 0;
+            sl = size / (SMALL_BLOCK / SL_COUNT);
+            return;
+        }
+
+        size_t power = fls(size);
+        sl = (size >> (power - SL_LOG2)) ^ SL_COUNT;
+        fl = power - FL_SHIFT + 1;
+    }
+
+    Tlsf::Block *Tlsf::next(Block *block) {
+        return reinterpret_cast<Block *>(reinterpret_cast<uint8_t *>(block) + HEADER + block->payload());
+    }
+
+    Tlsf::Block *Tlsf::fromPayload(void *ptr) {
+        return reinterpret_cast<Block *>(static_cast<uint8_t *>(ptr) - HEADER);
+    }
+
+    void Tlsf::insert(Block *block) {
+        size_t fl, sl;
+        mapping(block->payload(), fl, sl);
+
+        block->prevFree = nullptr;
+        block->nextFree = heads[fl][sl];
+        if (block->nextFree)
+            block->nextFree->prevFree = block;
+        heads[fl][sl] = block;
+
+        flBitmap |= 1u << fl;
+        slBitmap[fl] |= 1u << sl;
+        freeSize += block->payload();
+    }
+
+    void Tlsf::remove(Block *block) {
+        size_t fl, sl;
+        mapping(block->payload(), fl, sl);
+
+        if (block->prevFree)
+            block->prevFree->nextFree = block->nextFree;
+        else
+            heads[fl][sl] = block->nextFree;
+        if (block->nextFree)
+            block->nextFree->prevFree = block->prevFree;
+
+        if (!heads[fl][sl]) {
+            slBitmap[fl] &= ~(1u << sl);
+            if (!slBitmap[fl])
+                flBitmap &= ~(1u << fl);
+        }
+        freeSize -= block->payload();
+    }
+
+    Tlsf::Block *Tlsf::find(size_t size) {
+        /// Rounded up to the next list, every block there is at least as big
+        if (size >= SMALL_BLOCK)
+            size += (1ULL << (fls(size) - SL_LOG2)) - 1;
+
+        size_t fl, sl;
+        mapping(size, fl, sl);
+
+        uint32_t slMap = slBitmap[fl] & (~0u << sl);
+        if (!slMap) {
+            uint32_t flMap = fl + 1 < 32 ? flBitmap & (~0u << (fl + 1)) : 0;
+            if (!flMap)
+                return nullptr;
+            fl = __builtin_ctz(flMap);
+            slMap = slBitmap[fl];
+        }
+        sl = __builtin_ctz(slMap);
+
+        Block *block = heads[fl][sl];
+        remove(block);
+        return block;
+    }
+
+    void Tlsf::split(Block *block, size_t size) {
+        size_t payload = block->payload();
+        if (payload < size + HEADER + MIN_BLOCK)
+            return;
+
+        auto *rest = reinterpret_cast<Block *>(reinterpret_cast<uint8_t *>(block) + HEADER + size);
+        rest->prevPhysical = block;
+        rest->size = (payload - size - HEADER) | 1;
+        next(rest)->prevPhysical = rest;
+        block->size = size | (block->size & 1);
+        insert(rest);
+    }
+
+    bool Tlsf::grow() {
+        void *chunk = virtual_allocator::VirtualAllocator::instance()->vAlloc(CHUNK_PAGES);
+        if (!chunk)
+            return false;
+        setOwner(chunk, CHUNK_PAGES, Owner::HEAP);
+
+        /// One free block over the whole chunk, then a used block of size 0 so the last block has a neighbour
+        auto *first = static_cast<Block *>(chunk);
+        first->prevPhysical = nullptr;
+        first->size = (CHUNK_SIZE - 2 * HEADER) | 1;
+        Block *sentinel = next(first);
+        sentinel->prevPhysical = first;
+        sentinel->size = 0;
+
+        insert(first);
+        chunkCount++;
+        Logger::instance().println("[KALLOC] Heap grew to %X chunks", chunkCount);
+        return true;
+    }
+
+    void *Tlsf::malloc(size_t size) {
+        if (size == 0 || size > MAX_SIZE)
+            return nullptr;
+
+        size = std::max((size + ALIGN - 1) & ~(ALIGN - 1), MIN_BLOCK);
+        Block *block = find(size);
+        if (!block) {
+            if (!grow())
+                return nullptr;
+            block = find(size);
+        }
+
+        split(block, size);
+        block->size &= ~(size_t) 1;
+        return reinterpret_cast<uint8_t *>(block) + HEADER;
+    }
+
+    void Tlsf::free(void *ptr) {
+        Block *block = fromPayload(ptr);
+        kAssert(!block->isFree(), "[KALLOC] Block is already free");
+
+        /// Merged with both neighbours right away, two free blocks are never next to each other
+        Block *prev = block->prevPhysical;
+        if (prev && prev->isFree()) {
+            remove(prev);
+            prev->size = prev->payload() + HEADER + block->payload();
+            block = prev;
+        }
+
+        Block *after = next(block);
+        if (after->isFree()) {
+            remove(after);
+            block->size = block->payload() + HEADER + after->payload();
+            after = next(block);
+        }
+        after->prevPhysical = block;
+        block->size |= 1;
+
+        /// The whole chunk is free, the sentinel follows its only block
+        if (!block->prevPhysical && after->size == 0 && chunkCount > 1) {
+            setOwner(block, CHUNK_PAGES, Owner::NONE);
+            virtual_allocator::VirtualAllocator::instance()->vFree(block, CHUNK_PAGES);
+            chunkCount--;
+            return;
+        }
+        insert(block);
+    }
+}
@@ -39,6 +39,26 @@ namespace virtual_allocator {
         instance_->vFree(myBigString2, 2);
         instance_->vFree(myBigString3, 1);
 
+        /// 2 MiB and more are mapped with huge pages
+        auto *huge = (char *) instance_->vAlloc(paging::HUGE_PAGE_PAGES + 1);
+        kAssert(paging::hugePagePresent(reinterpret_cast<size_t>(huge)), "[V_ALLOC] 2 MiB should be a huge page");
+        kAssert(!paging::hugePagePresent(reinterpret_cast<size_t>(huge + paging::HUGE_PAGE_SIZE)),
+                "[V_ALLOC] The page after the huge page should be a normal page");
+        for (size_t i = 0; i < paging::HUGE_PAGE_SIZE + paging::PAGE_SIZE; i += paging::PAGE_SIZE)
+            huge[i] = 'A';
+        instance_->vFree(huge, paging::HUGE_PAGE_PAGES + 1);
+        kAssert(!paging::pagePresent(reinterpret_cast<size_t>(huge)), "[V_ALLOC] Huge page was not unmapped");
+
+        /// The other backend runs the same tests over a scratch range, it keeps its bitmap at the start of the range
+        Logger::instance().println("[V_ALLOC] Testing the hierarchical bitmap allocator...");
+        constexpr const size_t SCRATCH_PAGES = 1024;
+        auto *scratch = instance_->vAlloc(SCRATCH_PAGES);
+        size_t scratchBase = paging::physicalAddress(reinterpret_cast<size_t>(scratch));
+        physical_allocator::HierarchicalBitmapAllocator bitmap(scratchBase, SCRATCH_PAGES * paging::PAGE_SIZE, scratch);
+        physical_allocator::tests::PhysicalAllocatorTester bitmapTester(bitmap);
+        bitmapTester.runAllTests();
+        instance_->vFree(scratch, SCRATCH_PAGES);
+
         Logger::instance().println("[V_ALLOC] Finished testing.");
     }
 
@@ -46,11 +66,16 @@ namespace virtual_allocator {
             : physicalAllocator(memBase, memSize),
               KERNEL_VIRTUAL_START(paging::PHYSICAL_ALLOCATOR_VIRTUAL_START +
                                    physicalAllocator.cntAllocatorPages * paging::PAGE_SIZE) {
+        /// Virtual addresses are 2 MiB aligned where physical ones are, so mapPages can use huge pages
+        KERNEL_VIRTUAL_START += (physicalAllocator.memBase - KERNEL_VIRTUAL_START) % paging::HUGE_PAGE_SIZE;
+        /// paging::init only made PTs for KERNEL_VIRTUAL_SIZE, and physicalPtOf in paging.cpp finds them by address
+        kAssert(virtualEnd() <= paging::KERNEL_VIRTUAL_SIZE, "[V_ALLOC] Memory doesn't fit in the kernel window");
         Logger::instance().println("[V_ALLOC] Kernel Virtual start is %X", KERNEL_VIRTUAL_START);
     }
 
     void *VirtualAllocator::vAlloc(size_t pages) {
         Logger::instance().println("[V_ALLOC] Allocating %X pages...", pages);
+        locking::Guard<locking::SpinLock> guard(lock);
         size_t physicalAddress = physicalAllocator.allocate(pages);
         size_t virtualAddressStart = KERNEL_VIRTUAL_START + (physicalAddress - physicalAllocator.memBase);
         paging::mapPages(virtualAddressStart, physicalAddress, pages);
@@ -59,8 +84,22 @@ namespace virtual_allocator {
 
     void VirtualAllocator::vFree(void *virtualAddress, size_t pages) {
         auto vir = reinterpret_cast<uint64_t>(virtualAddress);
+        locking::Guard<locking::SpinLock> guard(lock);
         size_t physicalAddress = physicalAllocator.memBase + (vir - KERNEL_VIRTUAL_START);
         paging::unmapPages(vir, pages);
         physicalAllocator.free(physicalAddress, pages);
     }
+
+    size_t VirtualAllocator::freePages() const {
+        return physicalAllocator.freePages();
+    }
+
+    size_t VirtualAllocator::virtualStart() const {
+        return KERNEL_VIRTUAL_START;
+    }
+
+    size_t VirtualAllocator::virtualEnd() const {
+        /// Physical memory is mapped at a fixed offset
+        return KERNEL_VIRTUAL_START + physicalAllocator.memSize;
+    }
 }
@@ -33,6 +33,7 @@ struct IDTPointer {
 static_assert(AssertSize<IDTPointer, 10>());
 
 static std::array<InterruptHandler, NUM_IDT_ENTRIES> interruptHandlers;
+static std::array<ExceptionHandler, 32> exceptionHandlers;
 std::array<InterruptDescriptor, NUM_IDT_ENTRIES> idt;
 IDTPointer IDT_ptr;
 
@@ -186,6 +187,7 @@ void setupInterrupts() {
 
     // Nullify all the interrupt handlers.
     std::fill(interruptHandlers.begin(), interruptHandlers.end(), InterruptHandler{});
+    std::fill(exceptionHandlers.begin(), exceptionHandlers.end(), ExceptionHandler{});
 
     remapIRQTable();
 
@@ -271,6 +273,10 @@ void isrHandler(RegistersState *state) {
 
     Logger::instance().println("[INTERRUPTS] In ISR handler no: %X", int_no);
     if (int_no < 32) {
+        // Some exceptions, like page faults of memory mapped files, are expected and handled
+        if (exceptionHandlers[int_no] && exceptionHandlers[int_no](state))
+            return;
+
         // TODO kException(state, exceptionMessages[int_no]);
         Logger::instance().println("[INTERRUPTS] Called exception ISR nr: %X, %s",
                                    int_no, exceptionMessages[int_no]);
@@ -291,7 +297,7 @@ void isrHandler(RegistersState *state) {
 
 bool isInterestingInterrupt(uint64_t intNo) {
     // Interrupt 0x2e has to do with the ATA disk, but we are using PIO mode, so we don't need the interrupt
-    return intNo != 0x20 && intNo != 0x21 && intNo != 0x2e;
+    return intNo != 0x20 && intNo != 0x21 && intNo != 0x2e && intNo != 0x2f;
 }
 
 void irqHandler(RegistersState *state) {
@@ -328,4 +334,10 @@ void setInterruptHandler(Byte num, InterruptHandler handler) {
     interruptHandlers[num] = handler;
     auto x = (unsigned int) num;
     Logger::instance().println("[INTERRUPTS] Setup interrupts handler with number %x", x);
-}
\ No newline at end of file
+}
+
+void setExceptionHandler(Byte num, ExceptionHandler handler) {
+    kAssert(num < 32, "[INTERRUPTS] Not an exception vector");
+    exceptionHandlers[num] = handler;
+    Logger::instance().println("[INTERRUPTS] Setup exception handler with number %x", (unsigned int) num);
+}
@@ -32,6 +32,27 @@ inline __attribute__((always_inline)) void setCR3(size_t physicalPml4Start) {
             );
 }
 
+size_t paging::faultAddress() {
+    size_t address;
+    asm volatile("mov %%cr2, %0" : "=r"(address));
+    return address;
+}
+
+/*!
+ * Makes read-only pages read-only for the kernel too, by setting the WP bit of CR0
+ * Writes to mapped files rely on it to fault, for dirty tracking and copy-on-write
+ */
+inline __attribute__((always_inline)) void enableWriteProtect() {
+    asm volatile(
+            "mov %%cr0, %%rax\n\t"
+            "or $0x10000, %%rax\n\t"  // WP is bit 16
+            "mov %%rax, %%cr0"
+            :
+            :
+            : "rax", "memory"
+            );
+}
+
 /*!
  * Zeros out a virtual page
  * @param page The virtual address of the page to be cleared
@@ -70,6 +91,12 @@ namespace paging {
     constexpr auto virtualPdStart = physicalPdStart;
     constexpr auto virtualPtStart = physicalPtStart;
 
+    // The flags of the entries that point to tables
+    constexpr auto tableFlags = PRESENT | WRITE | USER;
+
+    // The number of entries in a table
+    constexpr auto tableEntries = PAGE_SIZE / sizeof(uint64_t);
+
 
     pml4t_t findPml4T() {
         return reinterpret_cast<paging::pml4t_t>(paging::virtualPml4TStart);
@@ -102,6 +129,30 @@ paging::pt_t findPt(paging::pd_t pd, size_t pde) {
     return reinterpret_cast<paging::pt_t>(virtual_pt);
 }
 
+/*!
+ * The PD that holds the entry of a virtual address
+ * @return nullptr if the PML4T or PDPT entry is not present
+ */
+paging::pd_t findPdOf(VirtualAddress virt) {
+    auto pml4t = paging::findPml4T();
+    if (!(reinterpret_cast<uintptr_t>(pml4t[virt.p4Index]) & paging::PRESENT))
+        return nullptr;
+
+    auto pdpt = findPdpt(pml4t, virt.p4Index);
+    if (!(reinterpret_cast<uintptr_t>(pdpt[virt.p3Index]) & paging::PRESENT))
+        return nullptr;
+
+    return findPd(pdpt, virt.p3Index);
+}
+
+/*!
+ * The physical address of the PT that paging::init set in the PD entry of a virtual address
+ * PTs are contiguous, in the order of the virtual addresses they map
+ */
+size_t physicalPtOf(VirtualAddress virt) {
+    return paging::physicalPtStart + (virt.address / paging::pde_allocations) * paging::PAGE_SIZE;
+}
+
 //TODO Improve to support a status
 size_t paging::physicalAddress(VirtualAddress virt) {
     if (!pagePresent(virt)) {
@@ -111,6 +162,10 @@ size_t paging::physicalAddress(VirtualAddress virt) {
     auto pml4t = findPml4T();
     auto pdpt = findPdpt(pml4t, virt.p4Index);
     auto pd = findPd(pdpt, virt.p3Index);
+
+    auto pde = reinterpret_cast<uintptr_t>(pd[virt.p2Index]);
+    if (pde & HUGE_PAGE)
+        return virt.offset2M + (pde & ~(HUGE_PAGE_SIZE - 1));
     auto pt = findPt(pd, virt.p2Index);
     Logger::instance().println("PML4T %X, pdpt %X, pd %X, pt %X", pml4t, pdpt, pd, pt);
 
@@ -133,10 +188,22 @@ bool paging::pagePresent(VirtualAddress virt) {
         return false;
     }
 
+    if (reinterpret_cast<uintptr_t>(pd[virt.p2Index]) & HUGE_PAGE)
+        return true;
+
     auto pt = findPt(pd, virt.p2Index);
     return reinterpret_cast<uintptr_t>(pt[virt.p1Index]) & PRESENT;
 }
 
+bool paging::hugePagePresent(VirtualAddress virt) {
+    auto pd = findPdOf(virt);
+    if (!pd)
+        return false;
+
+    auto pde = reinterpret_cast<uintptr_t>(pd[virt.p2Index]);
+    return (pde & PRESENT) && (pde & HUGE_PAGE);
+}
+
 void paging::map(VirtualAddress virt, size_t physical, uint8_t flags) {
     // The address must be page-aligned
     kAssert(virt.isPageAligned(), "Page is not page-aligned");
@@ -151,6 +218,7 @@ void paging::map(VirtualAddress virt, size_t physical, uint8_t flags) {
 
     auto pd = findPd(pdpt, virt.p3Index);
     kAssert(reinterpret_cast<uintptr_t>(pd[virt.p2Index]) & PRESENT, "[PAGING] A PD entry is not PRESENT");
+    kAssert(!(reinterpret_cast<uintptr_t>(pd[virt.p2Index]) & HUGE_PAGE), "[PAGING] The page is inside a huge page");
 
     auto pt = findPt(pd, virt.p2Index);
 
@@ -173,14 +241,50 @@ void paging::mapPages(VirtualAddress virt, size_t physical, size_t pages, uint8_
     kAssert(virt.isPageAligned(), "[PAGING] Page is not page-aligned");
 
     // Map each page
-    for (size_t page = 0; page < pages; page++) {
+    for (size_t page = 0; page < pages;) {
         auto vAddr = virt.address + page * PAGE_SIZE;
         auto pAddr = physical + page * PAGE_SIZE;
 
+        /// A huge page takes one entry and one TLB entry instead of 512
+        if (pages - page >= HUGE_PAGE_PAGES && hugeAligned(vAddr) && hugeAligned(pAddr)) {
+            mapHuge(vAddr, pAddr, flags);
+            page += HUGE_PAGE_PAGES;
+            continue;
+        }
+
         map(vAddr, pAddr, flags);
+        page++;
     }
 }
 
+void paging::mapHuge(VirtualAddress virt, size_t physical, uint8_t flags) {
+    kAssert(hugeAligned(virt.address) && hugeAligned(physical), "[PAGING] Huge page is not 2 MiB aligned");
+
+    auto pd = findPdOf(virt);
+    kAssert(pd != nullptr, "[PAGING] A PML4T or PDPT entry is not PRESENT");
+    kAssert(!(reinterpret_cast<uintptr_t>(pd[virt.p2Index]) & HUGE_PAGE), "[PAGING] Huge page is already mapped");
+
+    /// The PT comes back when the huge page is unmapped, so it must not hold stale pages
+    auto pt = findPt(pd, virt.p2Index);
+    kAssert(std::all_of(pt, pt + tableEntries, [](page_entry entry) { return entry == nullptr; }),
+            "[PAGING] Huge page over mapped pages");
+
+    pd[virt.p2Index] = reinterpret_cast<pt_t>(physical | flags | HUGE_PAGE);
+
+    flushTlb(virt.address);
+}
+
+void paging::unmapHuge(VirtualAddress virt) {
+    kAssert(hugeAligned(virt.address), "[PAGING] Huge page is not 2 MiB aligned");
+    kAssert(hugePagePresent(virt), "[PAGING] Not a huge page");
+
+    /// The PD entry points to its PT again, as paging::init set it
+    auto pd = findPdOf(virt);
+    pd[virt.p2Index] = reinterpret_cast<pt_t>(physicalPtOf(virt) | tableFlags);
+
+    flushTlb(virt.address);
+}
+
 void paging::unmap(VirtualAddress virt) {
     // The address must be page-aligned
     kAssert(virt.isPageAligned(), "[PAGING] Page is not page aligned");
@@ -206,6 +310,7 @@ void paging::unmap(VirtualAddress virt) {
     // If not present, return
     if (!(reinterpret_cast<uintptr_t>(pd[virt.p2Index]) & PRESENT))
         return;
+    kAssert(!(reinterpret_cast<uintptr_t>(pd[virt.p2Index]) & HUGE_PAGE), "[PAGING] The page is inside a huge page");
 
     auto pt = findPt(pd, virt.p2Index);
 
@@ -221,9 +326,17 @@ void paging::unmapPages(VirtualAddress virt, size_t pages) {
     kAssert(virt.isPageAligned(), "[PAGING] Page is not page aligned");
 
     /// Unmap each page
-    for (size_t page = 0; page < pages; page++) {
+    for (size_t page = 0; page < pages;) {
         auto vAddr = virt.address + page * PAGE_SIZE;
+        if (hugePagePresent(vAddr)) {
+            kAssert(hugeAligned(vAddr) && pages - page >= HUGE_PAGE_PAGES, "[PAGING] Can't unmap part of a huge page");
+            unmapHuge(vAddr);
+            page += HUGE_PAGE_PAGES;
+            continue;
+        }
+
         unmap(vAddr);
+        page++;
     }
 }
 
@@ -235,7 +348,7 @@ void paging::init() {
     /// This static_assert ensures this holds
     static_assert(physicalPtStart + pdEntries * PAGE_SIZE < IDENTITY_MAPPED_EARLY);
 
-    auto flags = PRESENT | WRITE | USER;
+    auto flags = tableFlags;
 
     /// 1. Prepare PML4T - Page Map Level 4
     Logger::instance().println("[PAGING] Preparing PML4T, mapping %X entries", pml4Entries);
@@ -301,6 +414,7 @@ void paging::init() {
     static_assert(sizeof(physicalPml4TStart) == 8);
 
     setCR3(physicalPml4TStart);
+    enableWriteProtect();
 
     Logger::instance().println("[PAGING] New cr3 has been set!\n");
 
@@ -6,6 +6,7 @@
  */
 
 #include "fs/vfs.h"
+#include "fs/io_ring.h"
 #include "arch/x86_64/system_calls.h"
 #include "console/console_printer.h"
 
@@ -26,6 +27,14 @@ namespace sys_calls {
         }
     }
 
+    int64_t expected_to_i64(const std::expected<void *> &status) {
+        if (status) {
+            return reinterpret_cast<int64_t>(*status);
+        } else {
+            return -status.error();
+        }
+    }
+
     /*
      * Calling convention, syscall number through rax
      * Parameters in rdi, rsi, rdx, r10, r8, r9
@@ -49,9 +58,8 @@ namespace sys_calls {
         auto fd = regs->rdi;
         auto buffer = reinterpret_cast<uint8_t *>(regs->rsi);
         auto max = regs->rdx;
-        auto offset = regs->r10;
 
-        auto status = vfs::read(fd, buffer, max, offset);
+        auto status = vfs::read(fd, buffer, max);
         regs->rax = expected_to_i64(status);
     }
 
@@ -59,9 +67,148 @@ namespace sys_calls {
         auto fd = regs->rdi;
         auto buffer = reinterpret_cast<uint8_t *>(regs->rsi);
         auto max = regs->rdx;
+
+        auto status = vfs::write(fd, buffer, max);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_pread(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto buffer = reinterpret_cast<uint8_t *>(regs->rsi);
+        auto max = regs->rdx;
+        auto offset = regs->r10;
+
+        auto status = vfs::pread(fd, buffer, max, offset);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_pwrite(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto buffer = reinterpret_cast<uint8_t *>(regs->rsi);
+        auto max = regs->rdx;
         auto offset = regs->r10;
 
-        auto status = vfs::write(fd, buffer, max, offset);
+        auto status = vfs::pwrite(fd, buffer, max, offset);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_readv(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto vec = reinterpret_cast<const vfs::io_vec *>(regs->rsi);
+        auto count = regs->rdx;
+
+        auto status = vfs::readv(fd, vec, count);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_writev(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto vec = reinterpret_cast<const vfs::io_vec *>(regs->rsi);
+        auto count = regs->rdx;
+
+        auto status = vfs::writev(fd, vec, count);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_seek(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto offset = static_cast<ssize_t>(regs->rsi);
+        auto whence = regs->rdx;
+
+        auto status = vfs::seek(fd, offset, whence);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_fstat(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto st = reinterpret_cast<vfs::file_stat *>(regs->rsi);
+
+        auto status = vfs::stat(fd, *st);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_mmap(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto length = regs->rsi;
+        auto flags = regs->rdx;
+        auto offset = regs->r10;
+
+        auto status = vfs::mmap(fd, length, flags, offset);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_munmap(SystemCallRegisters *regs) {
+        auto address = reinterpret_cast<void *>(regs->rdi);
+        auto length = regs->rsi;
+
+        auto status = vfs::munmap(address, length);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_msync(SystemCallRegisters *regs) {
+        auto address = reinterpret_cast<void *>(regs->rdi);
+        auto length = regs->rsi;
+
+        auto status = vfs::msync(address, length);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_sync(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+
+        auto status = fd == vfs::SYNC_ALL ? vfs::sync() : vfs::sync(fd);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_fallocate(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto offset = regs->rsi;
+        auto length = regs->rdx;
+        auto flags = regs->r10;
+
+        auto status = vfs::fallocate(fd, offset, length, flags);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_copy_range(SystemCallRegisters *regs) {
+        auto src_fd = regs->rdi;
+        auto src_offset = regs->rsi;
+        auto dst_fd = regs->rdx;
+        auto dst_offset = regs->r10;
+        auto length = regs->r8;
+
+        auto status = vfs::copy_range(src_fd, src_offset, dst_fd, dst_offset, length);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_getdents(SystemCallRegisters *regs) {
+        auto fd = regs->rdi;
+        auto buffer = reinterpret_cast<uint8_t *>(regs->rsi);
+        auto length = regs->rdx;
+
+        auto status = vfs::getdents(fd, buffer, length);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_ring_setup(SystemCallRegisters *regs) {
+        auto entries = regs->rdi;
+
+        auto status = vfs::ring_setup(entries);
+        regs->rax = status ? reinterpret_cast<int64_t>(*status) : -status.error();
+    }
+
+    void sc_ring_enter(SystemCallRegisters *regs) {
+        auto ring = reinterpret_cast<vfs::io_ring *>(regs->rdi);
+        auto to_submit = regs->rsi;
+
+        auto status = vfs::ring_enter(ring, to_submit);
+        regs->rax = expected_to_i64(status);
+    }
+
+    void sc_ring_destroy(SystemCallRegisters *regs) {
+        auto ring = reinterpret_cast<vfs::io_ring *>(regs->rdi);
+
+        auto status = vfs::ring_destroy(ring);
         regs->rax = expected_to_i64(status);
     }
 
@@ -101,6 +248,26 @@ namespace sys_calls {
         regs->rax = expected_to_i64(status);
     }
 
+    void sc_defrag(SystemCallRegisters *regs) {
+        auto file = reinterpret_cast<const char *>(regs->rdi);
+        auto st = reinterpret_cast<vfs::frag_stat *>(regs->rsi);
+        auto flags = regs->rdx;
+
+        if (!(flags & vfs::DEFRAG_REPORT_ONLY)) {
+            auto status = vfs::defrag(file);
+            if (!status) {
+                regs->rax = expected_to_i64(status);
+                return;
+            }
+        }
+
+        /// The fragmentation after the run is reported back if asked for
+        std::expected<void> status{};
+        if (st)
+            status = vfs::fragmentation(file, *st);
+        regs->rax = expected_to_i64(status);
+    }
+
     void sc_ls(SystemCallRegisters *regs) {
         Logger::instance().println("[SYSCALL] In ls syscall...");
         std::vector<vfs::file> contents;
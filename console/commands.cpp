@@ -9,15 +9,21 @@
 #include "std/cstring.h"
 #include "arch/x86_64/system_calls.h"
 #include "console/console_printer.h"
+#include "fs/vfs.h"
 
 const char *commandsHelp[] = {"touch <fileName>",
                               "open <fileName>",
                               "close <fileDescriptor>",
                               "read <fileDescriptor>",
-                              "write <fileDescriptor> <data> <offset>",
+                              "write <fileDescriptor> <data> [offset]",
+                              "seek <fileDescriptor> <offset>",
+                              "stat <fileDescriptor>",
+                              "sync [fileDescriptor]",
                               "mkdir <dirName>",
                               "rmdir <dirName>",
-                              "rm <fileName>"};
+                              "rm <fileName>",
+                              "frag [fileName]",
+                              "defrag [fileName]"};
 
 void commands::doCommand(char *commandText) {
     const char *command = strtok(commandText, " ");
@@ -59,8 +65,9 @@ void commands::doCommand(char *commandText) {
         // uint64_t size = strtoul(strtok(nullptr, " "), nullptr, 10);
         // uint64_t offset = strtoul(strtok(nullptr, " "), nullptr, 10);
 
-        Logger::instance().println("[COMMANDS] Reading fd %X, data %s", fd);
-        result = sys_calls::issueSyscall(0x00, fd, reinterpret_cast<uint64_t>(buffer), 0, 0);
+        Logger::instance().println("[COMMANDS] Reading fd %X", fd);
+        // Reads from the offset of the file, leaving room for the terminator
+        result = sys_calls::issueSyscall(0x00, fd, reinterpret_cast<uint64_t>(buffer), sizeof(buffer) - 1, 0);
         if (result < 0) {
             Console::instance().println("Error reading file!");
             return;
@@ -70,13 +77,46 @@ void commands::doCommand(char *commandText) {
         uint64_t fd = strtoul(args, nullptr, 10);
         const char *data = strtok(nullptr, " ");
         uint64_t size = strlen(data);
-        uint64_t offset = strtoul(strtok(nullptr, " "), nullptr, 10);
-        Logger::instance().println("[COMMANDS] Writing fd %X, data %s, size %X, offset %X", fd, data, size, offset);
-        result = sys_calls::issueSyscall(0x01, fd, reinterpret_cast<uint64_t>(data), size, offset);
+        const char *offsetText = strtok(nullptr, " ");
+        // Without an offset the data goes to the offset of the file
+        if (offsetText) {
+            uint64_t offset = strtoul(offsetText, nullptr, 10);
+            Logger::instance().println("[COMMANDS] Writing fd %X, data %s, size %X, offset %X", fd, data, size, offset);
+            result = sys_calls::issueSyscall(0x12, fd, reinterpret_cast<uint64_t>(data), size, offset);
+        } else {
+            Logger::instance().println("[COMMANDS] Writing fd %X, data %s, size %X", fd, data, size);
+            result = sys_calls::issueSyscall(0x01, fd, reinterpret_cast<uint64_t>(data), size, 0);
+        }
         if (result < 0) {
             Console::instance().println("Error writing file!");
             return;
         }
+    } else if (strcmp(command, "seek") == 0) {
+        uint64_t fd = strtoul(args, nullptr, 10);
+        uint64_t offset = strtoul(strtok(nullptr, " "), nullptr, 10);
+        result = sys_calls::issueSyscall(0x08, fd, offset, vfs::SEEK_SET, 0);
+        if (result < 0) {
+            Console::instance().println("Error seeking file!");
+            return;
+        }
+    } else if (strcmp(command, "stat") == 0) {
+        uint64_t fd = strtoul(args, nullptr, 10);
+        vfs::file_stat st{};
+        result = sys_calls::issueSyscall(0x05, fd, reinterpret_cast<uint64_t>(&st), 0, 0);
+        if (result < 0) {
+            Console::instance().println("Error calling stat!");
+            return;
+        }
+        Console::instance().println("Size: %X bytes, allocated: %X blocks of %X bytes", st.size, st.blocks,
+                                    st.blockSize);
+    } else if (strcmp(command, "sync") == 0) {
+        // Without a descriptor every cached file is written back
+        uint64_t fd = args ? strtoul(args, nullptr, 10) : vfs::SYNC_ALL;
+        result = sys_calls::issueSyscall(0xA2, fd, 0, 0, 0);
+        if (result < 0) {
+            Console::instance().println("Error writing back cached data!");
+            return;
+        }
     } else if (strcmp(command, "cd") == 0 || strcmp(command, "cwd") == 0) {
         const char *path = args;
         result = sys_calls::issueSyscall(0x4B, reinterpret_cast<uint64_t>(path), 0, 0, 0);
@@ -112,6 +152,18 @@ void commands::doCommand(char *commandText) {
             Console::instance().println("Error listing directory!");
             return;
         }
+    } else if (strcmp(command, "frag") == 0 || strcmp(command, "defrag") == 0) {
+        // Without a file name the whole file system is used
+        vfs::frag_stat frag{};
+        uint64_t flags = strcmp(command, "frag") == 0 ? vfs::DEFRAG_REPORT_ONLY : 0;
+        result = sys_calls::issueSyscall(0xAD, reinterpret_cast<uint64_t>(args),
+                                         reinterpret_cast<uint64_t>(&frag), flags, 0);
+        if (result < 0) {
+            Console::instance().println("Error defragmenting!");
+            return;
+        }
+        Console::instance().println("Fragmentation score: %d, %d fragments for %d extents in %d files",
+                                    frag.score, frag.fragments, frag.extents, frag.files);
     } else if (strcmp(command, "clear") == 0) {
         Console::instance().print_clear();
     } else if (strcmp(command, "help") == 0) {
@@ -8,5 +8,6 @@
 #include "drivers/ata.h"
 
 namespace ata {
-    volatile bool Ata::primary_invoked = false;
+    volatile bool Ata::invoked[2] = {};
+    locking::SpinLock Ata::channel_locks[2];
 }
\ No newline at end of file
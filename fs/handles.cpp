@@ -6,26 +6,61 @@
  */
 
 #include "fs/handles.h"
-#include "std/vector.h"
 
 namespace handles {
-    std::vector<fd_t> handles;
-    constexpr fd_t INVALID_HANDLE = 0xFFFFFFFF;
+    FdTable kernel_table;
 
-    size_t register_new_handle(const fd_t &p) {
-        handles.push_back(p);
-        return handles.size();
+    FdTable::~FdTable() {
+        for (auto block: files)
+            delete[] block;
     }
 
-    void release_handle(size_t fd) {
-        handles[fd - 1] = INVALID_HANDLE;
+    ssize_t FdTable::allocate(const OpenFile &file) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        if (summary == ~0ULL)
+            return -1;
+
+        /// The first word with a free descriptor, then the first free descriptor in it
+        size_t word = __builtin_ctzll(~summary);
+        size_t bit = __builtin_ctzll(~used[word]);
+        fd_t fd = word * 64 + bit;
+
+        used[word] |= 1ULL << bit;
+        if (used[word] == ~0ULL)
+            summary |= 1ULL << word;
+
+        if (!files[word])
+            files[word] = new OpenFile[64];
+        files[word][bit] = file;
+        open++;
+
+        return (ssize_t) fd;
+    }
+
+    void FdTable::release(fd_t fd) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        if (!has(fd))
+            return;
+
+        used[fd / 64] &= ~(1ULL << (fd % 64));
+        summary &= ~(1ULL << (fd / 64));
+        files[fd / 64][fd % 64] = {};
+        open--;
+    }
+
+    bool FdTable::has(fd_t fd) const {
+        return fd < MAX_FDS && (used[fd / 64] & (1ULL << (fd % 64)));
+    }
+
+    OpenFile &FdTable::get(fd_t fd) {
+        return files[fd / 64][fd % 64];
     }
 
-    bool has_handle(size_t fd) {
-        return fd > 0 && fd <= handles.size() && handles[fd - 1] != INVALID_HANDLE;
+    size_t FdTable::count() const {
+        return open;
     }
 
-    const fd_t &get_handle(size_t fd) {
-        return handles[fd - 1];
+    FdTable &current() {
+        return kernel_table;
     }
 }
@@ -0,0 +1,138 @@
+/*
+ * io_ring.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "fs/io_ring.h"
+#include "fs/vfs.h"
+#include "util/locks.h"
+
+namespace vfs {
+    namespace {
+        /**
+         * @brief What the kernel knows about a ring, kept out of the memory the user can write
+         * The header only gives the indexes the user moves, everything else comes from here
+         */
+        struct Ring {
+            io_ring *shared;
+            uint32_t entries;
+            ring_submission *submissions;
+            ring_completion *completions;
+            uint32_t sq_head, cq_tail; ///> The indexes the kernel moves, copied out to the header
+            locking::SpinLock lock; ///> Two calls can't consume the same ring at once
+        };
+
+        std::vector<Ring> rings; ///> Rings handed out, the pointers from the user are checked against them
+        /// Shared while a ring is in use, so rings are only added and destroyed while none is running
+        locking::RwLock rings_lock;
+
+        Ring *find(io_ring *ring) {
+            for (auto &r: rings) {
+                if (r.shared == ring)
+                    return &r;
+            }
+            return nullptr;
+        }
+
+        int64_t result(const std::expected<size_t> &status) {
+            return status ? (int64_t) *status : -(int64_t) status.error();
+        }
+
+        int64_t execute(const ring_submission &sqe) {
+            auto buffer = reinterpret_cast<uint8_t *>(sqe.address);
+            switch (sqe.opcode) {
+                case RING_NOP:
+                    return 0;
+                case RING_READ:
+                    if (sqe.offset == RING_CURRENT_OFFSET)
+                        return result(read(sqe.fd, buffer, sqe.length));
+                    return result(pread(sqe.fd, buffer, sqe.length, sqe.offset));
+                case RING_WRITE:
+                    if (sqe.offset == RING_CURRENT_OFFSET)
+                        return result(write(sqe.fd, buffer, sqe.length));
+                    return result(pwrite(sqe.fd, buffer, sqe.length, sqe.offset));
+                case RING_OPEN: {
+                    auto fd = open(reinterpret_cast<const char *>(sqe.address), sqe.length);
+                    return fd ? (int64_t) *fd : -(int64_t) fd.error();
+                }
+                case RING_CLOSE:
+                    if (!handles::current().has(sqe.fd))
+                        return -(int64_t) std::ERROR_INVALID_FILE_DESCRIPTOR;
+                    close(sqe.fd);
+                    return 0;
+                default:
+                    return -(int64_t) std::ERROR_INVALID_REQUEST;
+            }
+        }
+    }
+
+    std::expected<io_ring *> ring_setup(size_t entries) {
+        if (!entries || entries > RING_MAX_ENTRIES) {
+            return std::make_unexpected<io_ring *>(std::ERROR_INVALID_COUNT);
+        }
+
+        size_t slots = 1;
+        while (slots < entries)
+            slots *= 2;
+
+        /// One allocation, so the user maps a single range: the header, then the submissions, then the completions
+        size_t size = sizeof(io_ring) + slots * sizeof(ring_submission) + 2 * slots * sizeof(ring_completion);
+        auto *memory = new uint8_t[size]{};
+        auto *ring = reinterpret_cast<io_ring *>(memory);
+        ring->entries = slots;
+        ring->submissions = reinterpret_cast<ring_submission *>(memory + sizeof(io_ring));
+        ring->completions = reinterpret_cast<ring_completion *>(ring->submissions + slots);
+
+        locking::Guard<locking::RwLock> guard(rings_lock);
+        rings.push_back({ring, ring->entries, ring->submissions, ring->completions, 0, 0, {}});
+        Logger::instance().println("[VFS] Ring with %X entries at %X", slots, ring);
+        return ring;
+    }
+
+    std::expected<size_t> ring_enter(io_ring *ring, size_t to_submit) {
+        locking::SharedGuard shared(rings_lock);
+        Ring *record = find(ring);
+        if (!record) {
+            return std::make_unexpected<size_t>(std::ERROR_INVALID_REQUEST);
+        }
+        locking::Guard<locking::SpinLock> guard(record->lock);
+
+        /// The user may change the header at any time, so its indexes are read once and checked against ours
+        const uint32_t completion_slots = 2 * record->entries;
+        uint32_t sq_tail = __atomic_load_n(&ring->sq_tail, __ATOMIC_ACQUIRE);
+        uint32_t cq_head = __atomic_load_n(&ring->cq_head, __ATOMIC_ACQUIRE);
+        if (sq_tail - record->sq_head > record->entries || record->cq_tail - cq_head > completion_slots) {
+            Logger::instance().println("[VFS] Ring indexes were corrupted by the user");
+            return std::make_unexpected<size_t>(std::ERROR_INVALID_REQUEST);
+        }
+
+        size_t submitted = 0;
+        while (submitted < to_submit && record->sq_head != sq_tail && record->cq_tail - cq_head < completion_slots) {
+            /// The submission is copied first, the user may reuse the slot as soon as sq_head moves past it
+            ring_submission sqe = record->submissions[record->sq_head & (record->entries - 1)];
+            record->sq_head++;
+            __atomic_store_n(&ring->sq_head, record->sq_head, __ATOMIC_RELEASE);
+
+            record->completions[record->cq_tail & (completion_slots - 1)] = {sqe.user_data, execute(sqe)};
+            record->cq_tail++;
+            __atomic_store_n(&ring->cq_tail, record->cq_tail, __ATOMIC_RELEASE);
+            submitted++;
+        }
+        return submitted;
+    }
+
+    std::expected<void> ring_destroy(io_ring *ring) {
+        locking::Guard<locking::RwLock> guard(rings_lock);
+        for (size_t i = 0; i < rings.size(); i++) {
+            if (rings[i].shared != ring)
+                continue;
+
+            rings[i] = rings.back();
+            rings.pop_back();
+            delete[] reinterpret_cast<uint8_t *>(ring);
+            return std::make_expected();
+        }
+        return std::make_unexpected<void>(std::ERROR_INVALID_REQUEST);
+    }
+}
@@ -0,0 +1,174 @@
+/*
+ * lz4.cpp
+ *
+ *  Created on: 10/18/26.
+ */
+
+#include "fs/lz4.h"
+#include "std/cstring.h"
+#include "std/algorithm.h"
+
+namespace lz4 {
+    namespace {
+        constexpr const size_t MIN_MATCH = 4;
+        constexpr const size_t LAST_LITERALS = 5; ///> The last bytes of the input are always literals
+        constexpr const size_t MF_LIMIT = 12; ///> A match can not start in the last MF_LIMIT bytes
+        constexpr const size_t RUN_MASK = 0xF;
+        constexpr const size_t MAX_OFFSET = 0xFFFF;
+
+        uint32_t read32(const uint8_t *p) {
+            uint32_t value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint32_t hash(uint32_t sequence) {
+            return (sequence * 2654435761u) >> (32 - HASH_LOG);
+        }
+
+        /// Bytes needed to encode the part of a length that does not fit in the token
+        size_t extraLengthBytes(size_t length) {
+            return length < RUN_MASK ? 0 : (length - RUN_MASK) / 255 + 1;
+        }
+
+        uint8_t *writeLength(uint8_t *op, size_t length) {
+            for (length -= RUN_MASK; length >= 255; length -= 255)
+                *op++ = 255;
+            *op++ = (uint8_t) length;
+            return op;
+        }
+
+        /**
+         * @brief Emits one sequence; a match length of 0 means the final, literal-only sequence
+         * @return the new output position; nullptr if the sequence does not fit
+         */
+        uint8_t *writeSequence(uint8_t *op, const uint8_t *opEnd, const uint8_t *literals, size_t literalLength,
+                               size_t offset, size_t matchLength) {
+            size_t needed = 1 + extraLengthBytes(literalLength) + literalLength;
+            if (matchLength)
+                needed += 2 + extraLengthBytes(matchLength - MIN_MATCH);
+            if (needed > (size_t) (opEnd - op))
+                return nullptr;
+
+            uint8_t *token = op++;
+            *token = (uint8_t) (std::min(literalLength, RUN_MASK) << 4);
+            if (literalLength >= RUN_MASK)
+                op = writeLength(op, literalLength);
+            memcpy(op, literals, literalLength);
+            op += literalLength;
+
+            if (matchLength) {
+                *op++ = (uint8_t) offset;
+                *op++ = (uint8_t) (offset >> 8);
+
+                size_t length = matchLength - MIN_MATCH;
+                *token |= (uint8_t) std::min(length, RUN_MASK);
+                if (length >= RUN_MASK)
+                    op = writeLength(op, length);
+            }
+            return op;
+        }
+
+        /// Reads the rest of a length whose token nibble was RUN_MASK
+        bool readLength(const uint8_t *&ip, const uint8_t *ipEnd, size_t &length) {
+            uint8_t byte;
+            do {
+                if (ip >= ipEnd)
+                    return false;
+                byte = *ip++;
+                length += byte;
+            } while (byte == 255);
+            return true;
+        }
+    }
+
+    size_t compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, uint16_t *hashTable) {
+        if (srcSize > MAX_INPUT_SIZE)
+            return 0;
+
+        uint8_t *op = dst;
+        const uint8_t *opEnd = dst + dstCapacity;
+        size_t anchor = 0;
+
+        if (srcSize > MF_LIMIT) {
+            /// Stale entries are harmless, every candidate is verified before it is used
+            memset(hashTable, 0, HASH_TABLE_SIZE * sizeof(uint16_t));
+
+            const size_t matchLimit = srcSize - LAST_LITERALS;
+            size_t ip = 0;
+            while (ip + MF_LIMIT <= srcSize) {
+                uint32_t sequence = read32(src + ip);
+                uint32_t h = hash(sequence);
+                size_t ref = hashTable[h];
+                hashTable[h] = (uint16_t) ip;
+
+                if (ref >= ip || ip - ref > MAX_OFFSET || read32(src + ref) != sequence) {
+                    ip++;
+                    continue;
+                }
+
+                size_t matchLength = MIN_MATCH;
+                while (ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength])
+                    matchLength++;
+
+                op = writeSequence(op, opEnd, src + anchor, ip - anchor, ip - ref, matchLength);
+                if (!op)
+                    return 0;
+
+                ip += matchLength;
+                anchor = ip;
+            }
+        }
+
+        op = writeSequence(op, opEnd, src + anchor, srcSize - anchor, 0, 0);
+        if (!op)
+            return 0;
+        return op - dst;
+    }
+
+    ssize_t decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity) {
+        const uint8_t *ip = src;
+        const uint8_t *ipEnd = src + srcSize;
+        uint8_t *op = dst;
+        uint8_t *opEnd = dst + dstCapacity;
+
+        while (ip < ipEnd) {
+            uint8_t token = *ip++;
+
+            size_t literalLength = token >> 4;
+            if (literalLength == RUN_MASK && !readLength(ip, ipEnd, literalLength))
+                return -1;
+            if (literalLength > (size_t) (ipEnd - ip) || literalLength > (size_t) (opEnd - op))
+                return -1;
+            memcpy(op, ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            /// The last sequence has no match
+            if (ip == ipEnd)
+                break;
+
+            if (ipEnd - ip < 2)
+                return -1;
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > (size_t) (op - dst))
+                return -1;
+
+            size_t matchLength = token & RUN_MASK;
+            if (matchLength == RUN_MASK && !readLength(ip, ipEnd, matchLength))
+                return -1;
+            matchLength += MIN_MATCH;
+            if (matchLength > (size_t) (opEnd - op))
+                return -1;
+
+            /// Byte by byte, the match may overlap the bytes it produces
+            const uint8_t *match = op - offset;
+            for (size_t i = 0; i < matchLength; i++)
+                op[i] = match[i];
+            op += matchLength;
+        }
+
+        return op - dst;
+    }
+}
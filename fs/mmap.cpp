@@ -0,0 +1,262 @@
+/*
+ * mmap.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "fs/mmap.h"
+#include "fs/vfs.h"
+#include "fs/page_cache.h"
+#include "arch/x86_64/interrupts.h"
+#include "allocators/virtual_allocator.h"
+#include "std/cstring.h"
+
+namespace vfs {
+    namespace {
+        constexpr const size_t PAGE_SIZE = PageCache::PAGE_SIZE;
+        constexpr const size_t PAGE_FAULT = 14;
+
+        enum class PageState : uint8_t {
+            ABSENT, ///< Not mapped yet, the first access faults it in
+            READ, ///< The page of the cache, mapped read-only so that writes fault
+            WRITE, ///< The page of the cache, mapped writable, it is dirty
+            COPY ///< A private copy of the page, made on the first write to a private mapping
+        };
+
+        struct MappedPage {
+            PageState state{PageState::ABSENT};
+            uint8_t *data{}; ///> The page of the cache, or the private copy
+        };
+
+        struct Mapping {
+            size_t start;
+            size_t pages;
+            FileSystem *fs;
+            size_t inode;
+            size_t firstPage; ///> Index in the file of the first mapped page
+            size_t flags;
+            std::vector<MappedPage> state;
+
+            [[nodiscard]] size_t end() const { return start + pages * PAGE_SIZE; }
+        };
+
+        std::vector<Mapping *> mappings; ///> Sorted by address
+        size_t windowStart{}, windowEnd{}; ///> Virtual addresses for mappings
+        /// Guards the mappings and their pages; nothing it covers touches mapped memory, so it is never taken
+        /// again from a fault
+        locking::SpinLock mapping_lock;
+
+        /// The position of the first mapping that starts after address
+        size_t upperBound(size_t address) {
+            size_t low = 0, high = mappings.size();
+            while (low < high) {
+                size_t mid = (low + high) / 2;
+                if (mappings[mid]->start <= address)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            return low;
+        }
+
+        Mapping *find(size_t address) {
+            size_t next = upperBound(address);
+            if (next == 0 || address >= mappings[next - 1]->end())
+                return nullptr;
+            return mappings[next - 1];
+        }
+
+        /// First fit in the gaps between mappings; 0 if there is no room
+        size_t place(size_t pages) {
+            size_t start = windowStart;
+            for (auto mapping: mappings) {
+                if (mapping->start - start >= pages * PAGE_SIZE)
+                    break;
+                start = mapping->end();
+            }
+            return windowEnd - start >= pages * PAGE_SIZE ? start : 0;
+        }
+
+        void insert(Mapping *mapping) {
+            mappings.push_back(mapping);
+            for (size_t i = mappings.size() - 1; i > 0 && mappings[i - 1]->start > mapping->start; i--)
+                std::swap(mappings[i - 1], mappings[i]);
+        }
+
+        /// Points the page at data; an existing entry is removed first, since map() refuses to change flags
+        void install(size_t address, const uint8_t *data, bool writable) {
+            kAssert(paging::pageAligned((size_t) data), "[VFS] Mapped memory has to be page aligned");
+            paging::unmap(address);
+            paging::map(address, paging::physicalAddress((size_t) data),
+                        paging::PRESENT | (writable ? paging::WRITE : 0));
+        }
+
+        bool pageFault(RegistersState *state) {
+            return handlePageFault(paging::faultAddress(), state->err_code);
+        }
+    }
+
+    void initMmap() {
+        /// Rounded to a page table, so mappings never share one with the allocator
+        constexpr const size_t TABLE = paging::pde_allocations;
+        windowStart = (virtual_allocator::VirtualAllocator::instance()->virtualEnd() + TABLE - 1) / TABLE * TABLE;
+        windowEnd = paging::KERNEL_VIRTUAL_SIZE;
+
+        setExceptionHandler(PAGE_FAULT, pageFault);
+        Logger::instance().println("[VFS] Mappings go from %X to %X", windowStart, windowEnd);
+    }
+
+    bool handlePageFault(size_t address, size_t error) {
+        locking::Guard<locking::SpinLock> guard(mapping_lock);
+        Mapping *mapping = find(address);
+        if (!mapping) {
+            Logger::instance().println("[VFS] Page fault at %X, outside of every mapping", address);
+            return false;
+        }
+
+        bool write = error & paging::FAULT_WRITE;
+        if (write && !(mapping->flags & PROT_WRITE)) {
+            Logger::instance().println("[VFS] Write to the read-only mapping at %X", address);
+            return false;
+        }
+
+        size_t page = (address - mapping->start) / PAGE_SIZE;
+        size_t virt = mapping->start + page * PAGE_SIZE;
+        size_t index = mapping->firstPage + page;
+        MappedPage &entry = mapping->state[page];
+        auto &cache = PageCache::instance();
+
+        if (entry.state == PageState::ABSENT) {
+            /// The page is read into the cache if needed, and stays pinned there while it is mapped
+            entry.data = cache.mapPage(mapping->fs, mapping->inode, index);
+            if (!entry.data) {
+                Logger::instance().println("[VFS] Page fault at %X, past the end of the file", address);
+                return false;
+            }
+            entry.state = PageState::READ;
+
+            if (!write) {
+                install(virt, entry.data, false);
+                return true;
+            }
+        }
+
+        if (entry.state == PageState::READ && write) {
+            if (mapping->flags & MAP_SHARED) {
+                /// The first write makes the page dirty, later ones don't fault until msync protects it again
+                cache.dirtyPage(mapping->fs, mapping->inode, index);
+                entry.state = PageState::WRITE;
+            } else {
+                auto *copy = (uint8_t *) virtual_allocator::VirtualAllocator::instance()->vAlloc(1);
+                memcpy(copy, entry.data, PAGE_SIZE);
+                cache.unmapPage(mapping->fs, mapping->inode, index);
+                entry = {PageState::COPY, copy};
+            }
+        }
+
+        install(virt, entry.data, entry.state != PageState::READ);
+        return true;
+    }
+
+    std::expected<void *> mmap(fd_t fd, size_t length, size_t flags, size_t offset) {
+        auto &table = handles::current();
+        if (!table.has(fd)) {
+            return std::make_unexpected<void *>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+        }
+        if (table.get(fd).flags & OPEN_DIRECTORY) {
+            return std::make_unexpected<void *>(std::ERROR_DIRECTORY);
+        }
+
+        bool shared = flags & MAP_SHARED;
+        if (shared == (bool) (flags & MAP_PRIVATE)) {
+            return std::make_unexpected<void *>(std::ERROR_INVALID_REQUEST);
+        }
+        if (!length) {
+            return std::make_unexpected<void *>(std::ERROR_INVALID_COUNT);
+        }
+        if (offset % PAGE_SIZE) {
+            return std::make_unexpected<void *>(std::ERROR_INVALID_OFFSET);
+        }
+
+        size_t pages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+        locking::Guard<locking::SpinLock> guard(mapping_lock);
+        size_t start = windowEnd ? place(pages) : 0;
+        if (!start) {
+            Logger::instance().println("[VFS] No room to map %X pages", pages);
+            return std::make_unexpected<void *>(std::ERROR_FAILED);
+        }
+
+        auto &file = table.get(fd);
+        auto *mapping = new Mapping{start, pages, file.file_system, file.inode, offset / PAGE_SIZE, flags, {}};
+        mapping->state.resize(pages);
+        insert(mapping);
+
+        Logger::instance().println("[VFS] Mapped %X pages of inode %X at %X", pages, file.inode, start);
+        return (void *) start;
+    }
+
+    std::expected<void> munmap(void *address, size_t length) {
+        size_t start = (size_t) address;
+        locking::Guard<locking::SpinLock> guard(mapping_lock);
+        size_t position = upperBound(start);
+        if (position == 0 || mappings[position - 1]->start != start ||
+            mappings[position - 1]->pages != (length + PAGE_SIZE - 1) / PAGE_SIZE) {
+            /// Only whole mappings can be removed
+            return std::make_unexpected<void>(std::ERROR_INVALID_REQUEST);
+        }
+
+        Mapping *mapping = mappings[position - 1];
+        for (size_t page = 0; page < mapping->pages; page++) {
+            MappedPage &entry = mapping->state[page];
+            if (entry.state == PageState::ABSENT)
+                continue;
+
+            paging::unmap(mapping->start + page * PAGE_SIZE);
+            if (entry.state == PageState::COPY)
+                virtual_allocator::VirtualAllocator::instance()->vFree(entry.data, 1);
+            else
+                PageCache::instance().unmapPage(mapping->fs, mapping->inode, mapping->firstPage + page);
+        }
+
+        for (size_t i = position - 1; i + 1 < mappings.size(); i++)
+            mappings[i] = mappings[i + 1];
+        mappings.pop_back();
+        delete mapping;
+        return std::make_expected();
+    }
+
+    std::expected<void> msync(void *address, size_t length) {
+        FileSystem *fs;
+        size_t inode;
+        {
+            locking::Guard<locking::SpinLock> guard(mapping_lock);
+            Mapping *mapping = find((size_t) address);
+            if (!mapping) {
+                return std::make_unexpected<void>(std::ERROR_INVALID_REQUEST);
+            }
+            if (!(mapping->flags & MAP_SHARED))
+                return std::make_expected();
+
+            /// Written pages are protected again, so that the next write marks them dirty
+            size_t first = ((size_t) address - mapping->start) / PAGE_SIZE;
+            size_t last = std::min(mapping->pages,
+                                   ((size_t) address - mapping->start + length + PAGE_SIZE - 1) / PAGE_SIZE);
+            for (size_t page = first; page < last; page++) {
+                MappedPage &entry = mapping->state[page];
+                if (entry.state == PageState::WRITE) {
+                    entry.state = PageState::READ;
+                    install(mapping->start + page * PAGE_SIZE, entry.data, false);
+                }
+            }
+            fs = mapping->fs;
+            inode = mapping->inode;
+        }
+
+        /// The disk is written without the lock, faults on other mappings go on meanwhile
+        if (PageCache::instance().sync(fs, inode))
+            return std::make_expected();
+
+        Logger::instance().println("[VFS] Error calling msync");
+        return std::make_unexpected<void>(std::ERROR_FAILED);
+    }
+}
@@ -0,0 +1,184 @@
+/*
+ * mount_table.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "fs/mount_table.h"
+#include "fs/path.h"
+#include "std/cstring.h"
+
+namespace vfs {
+    namespace {
+        /// The length is given, the constructor that counts it is not constexpr and globals are not constructed
+        constexpr std::string_view PARENT{"..", 2};
+
+        /// FNV-1a
+        size_t hashOf(std::string_view text) {
+            size_t hash = 0xcbf29ce484222325;
+            for (char c: text)
+                hash = (hash ^ (uint8_t) c) * 0x100000001b3;
+            return hash;
+        }
+
+        bool hasParent(std::string_view path) {
+            for (auto component: PathView(path)) {
+                if (component == PARENT)
+                    return true;
+            }
+            return false;
+        }
+    }
+
+    MountTable::~MountTable() {
+        if (root)
+            destroy(root);
+        for (auto old: retired)
+            destroy(old);
+    }
+
+    MountTable::Node *MountTable::clone(const Node *node) {
+        auto copy = new Node;
+        if (!node)
+            return copy;
+
+        copy->name = node->name;
+        copy->mount = node->mount;
+        for (auto child: node->children)
+            copy->children.push_back(clone(child));
+        return copy;
+    }
+
+    void MountTable::destroy(Node *node) {
+        for (auto child: node->children)
+            destroy(child);
+        delete node;
+    }
+
+    MountTable::Node *MountTable::Node::child(std::string_view component) const {
+        for (auto node: children) {
+            if (std::string_view(node->name) == component)
+                return node;
+        }
+        return nullptr;
+    }
+
+    void MountTable::add(std::string_view mountPoint, MountedFS *mount) {
+        locking::Guard<locking::SpinLock> guard(writer);
+        Node *newRoot = clone(root);
+        Node *node = newRoot;
+        for (auto component: PathView(mountPoint)) {
+            Node *next = node->child(component);
+            if (!next) {
+                next = new Node;
+                next->name = std::string(component.begin(), component.end());
+                node->children.push_back(next);
+            }
+            node = next;
+        }
+        node->mount = mount;
+
+        /// The root goes out before the generation: a lookup that sees the new generation also sees the new root
+        if (root)
+            retired.push_back(root);
+        __atomic_store_n(&root, newRoot, __ATOMIC_RELEASE);
+
+        /// Every memoized walk may now end at a different mount
+        __atomic_fetch_add(&generation, 1, __ATOMIC_RELEASE);
+    }
+
+    std::string MountTable::normalize(std::string_view path) {
+        std::vector<std::string_view> components;
+        for (auto component: PathView(path)) {
+            if (component != PARENT)
+                components.push_back(component);
+            else if (!components.empty())
+                components.pop_back();
+        }
+
+        std::string result;
+        for (auto component: components) {
+            result += '/';
+            result += component;
+        }
+        if (result.empty())
+            result += '/';
+        return result;
+    }
+
+    MountTable::Walk MountTable::walk(Node *root, std::string_view directory) {
+        /// Nothing was mounted yet
+        if (!root)
+            return {nullptr, nullptr, 0};
+
+        Walk result{root, root->mount, 0};
+        PathView view(directory);
+        for (auto it = view.begin(); it != view.end() && result.node; ++it) {
+            result.node = result.node->child(*it);
+            if (result.node && result.node->mount) {
+                result.mount = result.node->mount;
+                result.skip = it.end_offset();
+            }
+        }
+        return result;
+    }
+
+    MountTable::Resolved MountTable::resolve(const char *path, std::string &normalized) {
+        /// ".." may climb out of a mount, so it is resolved before the walk picks one
+        if (hasParent(path)) {
+            normalized = normalize(path);
+            path = normalized.c_str();
+        }
+
+        PathView view(path);
+        auto directory = view.directory();
+        auto name = view.file_name();
+
+        size_t hash = hashOf(directory);
+        MemoEntry &entry = memo[hash % MEMO_SIZE];
+        size_t current = __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+        Walk result;
+        if (memoized(entry, current, hash, directory, result)) {
+            __atomic_fetch_add(&hits, 1, __ATOMIC_RELAXED);
+        } else {
+            result = walk(__atomic_load_n(&root, __ATOMIC_ACQUIRE), directory);
+            memoize(entry, current, hash, directory, result);
+        }
+
+        /// The last component may be a mount point itself
+        if (result.node && !name.empty()) {
+            Node *last = result.node->child(name);
+            if (last && last->mount)
+                return {last->mount, path + view.string().size()};
+        }
+
+        /// The rest of the path starts after the mount point and the separators that follow it
+        size_t rest = result.skip;
+        while (rest < view.string().size() && path[rest] == '/')
+            rest++;
+        return {result.mount, path + rest};
+    }
+
+    bool MountTable::memoized(MemoEntry &entry, size_t current, size_t hash, std::string_view directory,
+                              Walk &result) {
+        uint32_t sequence = entry.lock.readBegin();
+        bool hit = entry.generation == current && entry.hash == hash && entry.length == directory.size() &&
+                   !memcmp(entry.directory, directory.data(), directory.size());
+        result = entry.walk;
+        return !entry.lock.readRetry(sequence) && hit;
+    }
+
+    void MountTable::memoize(MemoEntry &entry, size_t current, size_t hash, std::string_view directory,
+                             const Walk &result) {
+        /// Another writer is filling the entry, the walk is simply not remembered
+        if (directory.size() > MEMO_DIRECTORY || !entry.lock.tryWriteLock())
+            return;
+
+        entry.generation = current;
+        entry.hash = hash;
+        entry.length = directory.size();
+        memcpy(entry.directory, directory.data(), directory.size());
+        entry.walk = result;
+        entry.lock.writeUnlock();
+    }
+}
@@ -0,0 +1,622 @@
+/*
+ * page_cache.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "fs/page_cache.h"
+#include "fs/file_system.h"
+#include "std/algorithm.h"
+#include "std/cstring.h"
+#include "arch/x86_64/logging.h"
+
+namespace vfs {
+    namespace {
+        /// Whether a tree with this many levels has a slot for the page index
+        bool covers(size_t height, size_t index, size_t bits) {
+            return height * bits >= 64 || (index >> (height * bits)) == 0;
+        }
+    }
+
+    PageCache &PageCache::instance() {
+        static PageCache cache;
+        return cache;
+    }
+
+    size_t PageCache::bucket(FileSystem *fs, size_t inode) {
+        return (inode ^ ((size_t) fs >> 4)) % FILE_BUCKETS;
+    }
+
+    PageCache::CachedFile *PageCache::find(FileSystem *fs, size_t inode) {
+        for (CachedFile *file = files[bucket(fs, inode)]; file; file = file->next)
+            if (file->fs == fs && file->inode == inode)
+                return file;
+        return nullptr;
+    }
+
+    PageCache::CachedFile *PageCache::acquire(FileSystem *fs, size_t inode) {
+        CachedFile *file = find(fs, inode);
+        if (!file) {
+            lock.unlock();
+            ssize_t size = fs->shared([&] { return fs->stat(inode); });
+            lock.lock();
+            if (size < 0)
+                return nullptr;
+
+            /// Another operation may have started caching the file meanwhile
+            file = find(fs, inode);
+            if (!file) {
+                file = new CachedFile{fs, inode, (size_t) size};
+                size_t b = bucket(fs, inode);
+                file->next = files[b];
+                files[b] = file;
+            }
+        }
+
+        file->users++;
+        return file;
+    }
+
+    void PageCache::release(CachedFile *file) {
+        file->users--;
+        /// A file keeps its entry while it has pages, or an error that sync has to report
+        if (!file->users && !file->pages && !file->error)
+            destroy(file);
+    }
+
+    void PageCache::drop(CachedFile *file) {
+        /// Their pages are pinned or busy, they can't be freed under them
+        while (file->users > 1)
+            wait();
+
+        if (file->root)
+            dropTree(file->root, file->height - 1);
+        file->root = nullptr;
+        file->height = 0;
+        file->error = false;
+    }
+
+    void PageCache::wait() {
+        lock.unlock();
+        locking::relax();
+        lock.lock();
+    }
+
+    void PageCache::destroy(CachedFile *file) {
+        kAssert(!file->pages && !file->users, "[VFS] Destroying a cached file that is still in use");
+
+        CachedFile **link = &files[bucket(file->fs, file->inode)];
+        while (*link != file)
+            link = &(*link)->next;
+        *link = file->next;
+        delete file;
+    }
+
+    PageCache::Page *PageCache::lookup(CachedFile *file, size_t index) {
+        if (!file->root || !covers(file->height, index, RADIX_BITS))
+            return nullptr;
+
+        RadixNode *node = file->root;
+        for (size_t level = file->height - 1; level > 0; level--) {
+            node = (RadixNode *) node->slots[(index >> (level * RADIX_BITS)) % RADIX_FANOUT];
+            if (!node)
+                return nullptr;
+        }
+        return (Page *) node->slots[index % RADIX_FANOUT];
+    }
+
+    void PageCache::insert(CachedFile *file, Page *page) {
+        /// Add levels on top until the index fits, the old tree becomes the first child of the new root
+        while (!file->root || !covers(file->height, page->index, RADIX_BITS)) {
+            auto *root = new RadixNode;
+            if (file->root) {
+                root->slots[0] = file->root;
+                root->count = 1;
+            }
+            file->root = root;
+            file->height++;
+        }
+
+        RadixNode *node = file->root;
+        for (size_t level = file->height - 1; level > 0; level--) {
+            void *&slot = node->slots[(page->index >> (level * RADIX_BITS)) % RADIX_FANOUT];
+            if (!slot) {
+                slot = new RadixNode;
+                node->count++;
+            }
+            node = (RadixNode *) slot;
+        }
+
+        kAssert(!node->slots[page->index % RADIX_FANOUT], "[VFS] Page is already cached");
+        node->slots[page->index % RADIX_FANOUT] = page;
+        node->count++;
+        file->pages++;
+        counters.pages++;
+    }
+
+    bool PageCache::removeFrom(RadixNode *node, size_t level, size_t index) {
+        size_t slot = (index >> (level * RADIX_BITS)) % RADIX_FANOUT;
+        if (level > 0) {
+            auto *child = (RadixNode *) node->slots[slot];
+            if (!removeFrom(child, level - 1, index))
+                return false;
+            delete child;
+        }
+
+        node->slots[slot] = nullptr;
+        node->count--;
+        return node->count == 0;
+    }
+
+    void PageCache::remove(Page *page) {
+        CachedFile *file = page->file;
+
+        /// Nodes left without children are freed on the way back up
+        if (removeFrom(file->root, file->height - 1, page->index)) {
+            delete file->root;
+            file->root = nullptr;
+            file->height = 0;
+        }
+
+        unlink(page);
+        if (page->dirty())
+            counters.dirty--;
+        file->pages--;
+        counters.pages--;
+
+        delete[] page->data;
+        delete page;
+    }
+
+    void PageCache::dropTree(RadixNode *node, size_t level) {
+        for (void *slot: node->slots) {
+            if (!slot)
+                continue;
+
+            if (level > 0) {
+                dropTree((RadixNode *) slot, level - 1);
+                continue;
+            }
+
+            auto *page = (Page *) slot;
+            kAssert(!page->held() && !page->busy, "[VFS] Dropping a page that is in use");
+            unlink(page);
+            if (page->dirty())
+                counters.dirty--;
+            page->file->pages--;
+            counters.pages--;
+            delete[] page->data;
+            delete page;
+        }
+        delete node;
+    }
+
+    template<typename Fn>
+    void PageCache::forEach(RadixNode *node, size_t level, Fn fn) {
+        for (void *slot: node->slots) {
+            if (!slot)
+                continue;
+            if (level > 0)
+                forEach((RadixNode *) slot, level - 1, fn);
+            else
+                fn((Page *) slot);
+        }
+    }
+
+    void PageCache::touch(Page *page) {
+        if (lruFirst == page || page->held())
+            return;
+
+        unlink(page);
+        page->next = lruFirst;
+        if (lruFirst)
+            lruFirst->prev = page;
+        lruFirst = page;
+        if (!lruLast)
+            lruLast = page;
+    }
+
+    void PageCache::unlink(Page *page) {
+        if (page->prev)
+            page->prev->next = page->next;
+        else if (lruFirst == page)
+            lruFirst = page->next;
+
+        if (page->next)
+            page->next->prev = page->prev;
+        else if (lruLast == page)
+            lruLast = page->prev;
+
+        page->prev = page->next = nullptr;
+    }
+
+    bool PageCache::writeBack(Page *page) {
+        CachedFile *file = page->file;
+        size_t start = page->index * PAGE_SIZE;
+
+        /// Only the dirty bytes are written, so holes of sparse files outside of them stay holes
+        size_t end = file->size > start ? std::min(PAGE_SIZE, file->size - start) : 0;
+        size_t from = page->dirtyFrom, to = std::min((size_t) page->dirtyTo, end);
+        page->dirtyFrom = page->dirtyTo = 0;
+        counters.dirty--;
+
+        bool success = true;
+        if (from < to) {
+            /// The file keeps its pages while the lock is dropped, invalidating it waits for the write
+            page->busy = true;
+            file->users++;
+            lock.unlock();
+            auto fs = file->fs;
+            ssize_t written = fs->exclusive([&] {
+                return fs->write(file->inode, page->data + from, (int) (to - from), start + from);
+            });
+            lock.lock();
+            page->busy = false;
+            file->users--;
+
+            success = written == (ssize_t) (to - from);
+            counters.writebacks++;
+        }
+
+        if (!success) {
+            Logger::instance().println("[VFS] Failed to write back page %X of inode %X", page->index, file->inode);
+            file->error = true;
+        }
+        return success;
+    }
+
+    void PageCache::reclaim(size_t target) {
+        while (counters.pages > target) {
+            /// Pages that are being written back stay in the list, the next one is taken instead
+            Page *victim = lruLast;
+            while (victim && victim->busy)
+                victim = victim->prev;
+            if (!victim)
+                break;
+            CachedFile *file = victim->file;
+
+            if (victim->dirty()) {
+                writeBack(victim);
+                /// It may have been used again while the lock was dropped
+                if (victim->held() || victim->dirty())
+                    continue;
+            }
+            remove(victim);
+            counters.evictions++;
+
+            if (!file->users && !file->pages && !file->error)
+                destroy(file);
+        }
+    }
+
+    PageCache::Page *PageCache::getPage(CachedFile *file, size_t index, bool fill) {
+        /// The lock may be dropped while waiting and reclaiming, so the page is looked up again after both
+        bool reclaimed = false;
+        while (true) {
+            Page *page = lookup(file, index);
+            if (page && page->busy) {
+                wait();
+            } else if (page) {
+                counters.hits++;
+                page->pins++;
+                unlink(page);
+                return page;
+            } else if (!reclaimed) {
+                /// Make room first, the file itself is pinned by the caller so losing its other pages is fine
+                reclaim(budget - 1);
+                reclaimed = true;
+            } else {
+                break;
+            }
+        }
+        counters.misses++;
+
+        /// The page is cached before it is filled, so an operation that wants it meanwhile waits for the read
+        auto *page = new Page{file, index, new uint8_t[PAGE_SIZE]};
+        page->pins = 1;
+        page->busy = fill;
+        insert(file, page);
+
+        size_t filled = 0;
+        if (fill) {
+            /// Exclusive, reading a file system may fill its own buffers
+            lock.unlock();
+            auto fs = file->fs;
+            ssize_t result = fs->exclusive([&] {
+                return fs->read(file->inode, page->data, PAGE_SIZE, index * PAGE_SIZE);
+            });
+            lock.lock();
+            page->busy = false;
+
+            if (result < 0) {
+                page->pins = 0;
+                remove(page);
+                return nullptr;
+            }
+            filled = result;
+        }
+        /// Past the end of the file on disk the page reads as zeroes
+        memset(page->data + filled, 0, PAGE_SIZE - filled);
+        return page;
+    }
+
+    void PageCache::unpin(Page *page) {
+        if (!--page->pins)
+            touch(page);
+    }
+
+    ssize_t PageCache::read(FileSystem *fs, size_t inode, uint8_t *buffer, size_t count, size_t offset) {
+        io_vec vec{buffer, count};
+        return readv(fs, inode, &vec, 1, offset);
+    }
+
+    ssize_t PageCache::write(FileSystem *fs, size_t inode, const uint8_t *buffer, size_t count, size_t offset) {
+        io_vec vec{const_cast<uint8_t *>(buffer), count};
+        return writev(fs, inode, &vec, 1, offset);
+    }
+
+    ssize_t PageCache::readv(FileSystem *fs, size_t inode, const io_vec *vec, size_t count, size_t offset) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        CachedFile *file = acquire(fs, inode);
+        if (!file)
+            return -1;
+
+        /// The buffers are filled one after the other, a page that two of them share is looked up for each
+        ssize_t done = 0;
+        for (size_t i = 0; i < count && offset + done < file->size; i++) {
+            ssize_t result = readFrom(file, vec[i].base, vec[i].length, offset + done);
+            if (result < 0) {
+                done = done ? done : -1;
+                break;
+            }
+
+            done += result;
+            if ((size_t) result < vec[i].length)
+                break;
+        }
+
+        release(file);
+        return done;
+    }
+
+    ssize_t PageCache::writev(FileSystem *fs, size_t inode, const io_vec *vec, size_t count, size_t offset) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        CachedFile *file = acquire(fs, inode);
+        if (!file)
+            return -1;
+
+        size_t done = 0, total = 0;
+        for (size_t i = 0; i < count; i++) {
+            size_t result = writeTo(file, vec[i].base, vec[i].length, offset + done);
+            done += result;
+            total += vec[i].length;
+            if (result < vec[i].length)
+                break;
+        }
+
+        release(file);
+        return done || !total ? (ssize_t) done : -1;
+    }
+
+    ssize_t PageCache::readFrom(CachedFile *file, uint8_t *buffer, size_t count, size_t offset) {
+        ssize_t done = 0;
+        if (offset < file->size) {
+            count = std::min(count, file->size - offset);
+            while ((size_t) done < count) {
+                size_t index = (offset + done) / PAGE_SIZE;
+                size_t in_page = (offset + done) % PAGE_SIZE;
+                size_t chunk = std::min(PAGE_SIZE - in_page, count - done);
+
+                Page *page = getPage(file, index, true);
+                if (!page)
+                    return done ? done : -1;
+
+                /// The buffer may be mapped from the cache, faulting it in takes the lock
+                lock.unlock();
+                memcpy(buffer + done, page->data + in_page, chunk);
+                lock.lock();
+                unpin(page);
+                done += (ssize_t) chunk;
+            }
+        }
+        return done;
+    }
+
+    size_t PageCache::writeTo(CachedFile *file, const uint8_t *buffer, size_t count, size_t offset) {
+        size_t done = 0;
+        while (done < count) {
+            size_t index = (offset + done) / PAGE_SIZE;
+            size_t in_page = (offset + done) % PAGE_SIZE;
+            size_t chunk = std::min(PAGE_SIZE - in_page, count - done);
+
+            /// The old contents are only needed if the write leaves part of the page that lies inside the file
+            bool fill = chunk != PAGE_SIZE && index * PAGE_SIZE < file->size;
+            Page *page = getPage(file, index, fill);
+            if (!page)
+                break;
+
+            lock.unlock();
+            memcpy(page->data + in_page, buffer + done, chunk);
+            lock.lock();
+            unpin(page);
+            if (page->dirty()) {
+                page->dirtyFrom = std::min(page->dirtyFrom, (uint32_t) in_page);
+                page->dirtyTo = std::max(page->dirtyTo, (uint32_t) (in_page + chunk));
+            } else {
+                page->dirtyFrom = in_page;
+                page->dirtyTo = in_page + chunk;
+                counters.dirty++;
+            }
+
+            done += chunk;
+            file->size = std::max(file->size, offset + done);
+        }
+        return done;
+    }
+
+    ssize_t PageCache::size(FileSystem *fs, size_t inode) {
+        {
+            locking::Guard<locking::SpinLock> guard(lock);
+            if (CachedFile *file = find(fs, inode))
+                return (ssize_t) file->size;
+        }
+        return fs->shared([&] { return fs->stat(inode); });
+    }
+
+    bool PageCache::syncFile(CachedFile *file) {
+        /// Pages are written back in index order, which is also the order a file is laid out on disk.
+        /// The tree may change while a page is written, so the dirty pages are collected first
+        std::vector<size_t> dirty;
+        if (file->root) {
+            forEach(file->root, file->height - 1, [&dirty](Page *page) {
+                if (page->dirty())
+                    dirty.push_back(page->index);
+            });
+        }
+
+        for (size_t index: dirty) {
+            Page *page = lookup(file, index);
+            /// A page that is being written back by reclaim counts once that write is done
+            while (page && page->busy) {
+                wait();
+                page = lookup(file, index);
+            }
+            if (page && page->dirty())
+                writeBack(page);
+        }
+
+        bool success = !file->error;
+        file->error = false;
+        return success;
+    }
+
+    bool PageCache::sync(FileSystem *fs, size_t inode) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        CachedFile *file = find(fs, inode);
+        if (!file)
+            return true;
+
+        file->users++;
+        bool success = syncFile(file);
+        release(file);
+        return success;
+    }
+
+    bool PageCache::sync(FileSystem *fs) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        bool success = true;
+        for (CachedFile *first: files) {
+            for (CachedFile *file = first, *next; file; file = next) {
+                if (fs && file->fs != fs) {
+                    next = file->next;
+                    continue;
+                }
+
+                /// The lock is dropped while syncing, only the acquired file is sure to stay in the list
+                file->users++;
+                success &= syncFile(file);
+                next = file->next;
+                release(file);
+            }
+        }
+        return success;
+    }
+
+    void PageCache::invalidate(FileSystem *fs, size_t inode) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        CachedFile *file = find(fs, inode);
+        if (!file)
+            return;
+
+        file->users++;
+        drop(file);
+        release(file);
+    }
+
+    void PageCache::invalidate(FileSystem *fs) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        for (CachedFile *first: files) {
+            for (CachedFile *file = first, *next; file; file = next) {
+                if (file->fs != fs) {
+                    next = file->next;
+                    continue;
+                }
+
+                file->users++;
+                drop(file);
+                next = file->next;
+                release(file);
+            }
+        }
+    }
+
+    uint8_t *PageCache::mapPage(FileSystem *fs, size_t inode, size_t index) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        CachedFile *file = acquire(fs, inode);
+        if (!file)
+            return nullptr;
+
+        /// Like a read, a mapping can't reach past the end of the file
+        Page *page = index * PAGE_SIZE < file->size ? getPage(file, index, true) : nullptr;
+        if (page) {
+            page->maps++;
+            file->maps++;
+            unpin(page);
+        }
+
+        release(file);
+        return page ? page->data : nullptr;
+    }
+
+    void PageCache::unmapPage(FileSystem *fs, size_t inode, size_t index) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        CachedFile *file = find(fs, inode);
+        Page *page = file ? lookup(file, index) : nullptr;
+        kAssert(page && page->maps, "[VFS] Unmapping a page that is not mapped");
+
+        file->maps--;
+        if (!--page->maps)
+            touch(page);
+    }
+
+    void PageCache::dirtyPage(FileSystem *fs, size_t inode, size_t index) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        CachedFile *file = find(fs, inode);
+        Page *page = file ? lookup(file, index) : nullptr;
+        kAssert(page && page->maps, "[VFS] Dirtying a page that is not mapped");
+
+        /// The whole page may have been written, but only the part inside the file is kept
+        size_t start = index * PAGE_SIZE;
+        size_t end = file->size > start ? std::min(PAGE_SIZE, file->size - start) : 0;
+        if (!page->dirty() && end)
+            counters.dirty++;
+        page->dirtyFrom = 0;
+        page->dirtyTo = std::max(page->dirtyTo, (uint32_t) end);
+    }
+
+    bool PageCache::mapped(FileSystem *fs, size_t inode) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        CachedFile *file = find(fs, inode);
+        return file && file->maps;
+    }
+
+    bool PageCache::mapped(FileSystem *fs) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        for (CachedFile *first: files)
+            for (CachedFile *file = first; file; file = file->next)
+                if (file->fs == fs && file->maps)
+                    return true;
+        return false;
+    }
+
+    void PageCache::setBudget(size_t pages) {
+        locking::Guard<locking::SpinLock> guard(lock);
+        budget = std::max(pages, (size_t) 1);
+        reclaim(budget);
+    }
+
+    PageCache::Stats PageCache::stats() const {
+        locking::Guard<locking::SpinLock> guard(lock);
+        return counters;
+    }
+}
@@ -7,87 +7,151 @@
 
 #include "../include/fs/path.h"
 #include "arch/x86_64/exceptions.h"
-
-void update_positions(std::string &base, std::vector<Path::position_t> &positions) {
-    positions.clear();
-
-    if (base.empty()) {
-        return;
-    }
-
-    for (int i = base.size() - 2; i >= 0; --i) {
-        if (base[i] == '/' && base[i + 1] == '/') {
-            base.erase(size_t(i + 1));
+#include "std/cstring.h"
+
+void Path::assign(std::string_view first, std::string_view second) {
+    /// Collapsing only shrinks the path, so a source inside the current buffer is never overwritten before it is read
+    size_t needed = first.size() + second.size() + 2;
+    char *target = needed <= capacity ? data : new char[needed];
+
+    size_t size = 0;
+    auto append = [target, &size](std::string_view part) {
+        for (char c: part) {
+            if (c == '/' && size && target[size - 1] == '/')
+                continue;
+            target[size++] = c;
         }
+    };
+    append(first);
+    append(second);
+    if (size && target[size - 1] != '/')
+        target[size++] = '/';
+    target[size] = '\0';
+
+    if (target != data) {
+        if (data != small)
+            delete[] data;
+        data = target;
+        capacity = needed;
     }
+    length = size;
+}
 
-    if (base.back() != '/') {
-        base += '/';
+void Path::copy(std::string_view normalized) {
+    if (normalized.size() + 1 > capacity) {
+        if (data != small)
+            delete[] data;
+        capacity = normalized.size() + 1;
+        data = new char[capacity];
     }
+    memcpy(data, normalized.data(), normalized.size());
+    length = normalized.size();
+    data[length] = '\0';
+}
 
-    for (size_t i = 0; i < base.size(); ++i) {
-        if (base[i] == '/') {
-            positions.push_back(i);
-        }
+size_t Path::separator(size_t i) const {
+    for (size_t position = 0; position < length; position++) {
+        if (data[position] == '/' && i-- == 0)
+            return position;
     }
+    kPanic("[PATH] Component out of range");
+    return length;
 }
 
-Path::Path(std::string_view path) : base(path.begin(), path.end()) {
+Path::Path(std::string_view path) {
     kAssert(path.size(), "[PATH] Invalid base path");
 
-    update_positions(base, positions);
+    assign(path);
 }
 
-Path::Path(const Path &base_path, std::string_view p) : base(base_path.base) {
+Path::Path(const Path &base_path, std::string_view p) {
     kAssert(p.empty() || p[0] != '/', "[PATH] Impossible to add absolute path to another path");
 
-    base += std::string(p.begin(), p.end());
-
-    update_positions(base, positions);
+    assign(base_path.string(), p);
 }
 
-Path::Path(const Path &base_path, const Path &p) : base(base_path.base) {
+Path::Path(const Path &base_path, const Path &p) {
     kAssert(p.is_relative(), "[PATH] Impossible to add absolute path to another path");
-    base += p.base;
 
-    update_positions(base, positions);
+    assign(base_path.string(), p.string());
 }
 
-Path &Path::operator=(std::string_view rhs) {
-    base = rhs;
+Path::Path(const Path &other) {
+    copy(other.string());
+}
+
+Path::Path(Path &&other) noexcept {
+    *this = std::move(other);
+}
+
+Path::~Path() {
+    if (data != small)
+        delete[] data;
+}
 
-    update_positions(base, positions);
+Path &Path::operator=(const Path &other) {
+    if (this != &other)
+        copy(other.string());
+    return *this;
+}
+
+Path &Path::operator=(Path &&other) noexcept {
+    if (this == &other)
+        return *this;
+
+    if (other.data == other.small) {
+        copy(other.string());
+        return *this;
+    }
+
+    /// The allocation moves over, other goes back to its inline buffer
+    if (data != small)
+        delete[] data;
+    data = other.data;
+    length = other.length;
+    capacity = other.capacity;
+    other.data = other.small;
+    other.capacity = INLINE_CAPACITY;
+    other.length = 0;
+    other.small[0] = '\0';
+    return *this;
+}
+
+Path &Path::operator=(std::string_view rhs) {
+    assign(rhs);
 
     return *this;
 }
 
 std::string_view Path::string() const {
-    return {base.c_str(), base.size()};
+    return {data, length};
 }
 
 void Path::invalidate() {
-    base = "//";
-    positions.clear();
+    copy("//");
 }
 
 bool Path::empty() const {
-    return base.empty();
+    return !length;
 }
 
 bool Path::is_root() const {
-    return base == "/";
+    return string() == std::string_view("/");
 }
 
 bool Path::is_valid() const {
-    return !base.empty() && base != "//";
+    return length && string() != std::string_view("//");
 }
 
 bool Path::is_sub_root() const {
-    return is_absolute() && positions.size() == 2;
+    return is_absolute() && size() == 2;
 }
 
 size_t Path::size() const {
-    return positions.size();
+    size_t components = 0;
+    for (size_t position = 0; position < length; position++)
+        components += data[position] == '/';
+    return components;
 }
 
 std::string_view Path::base_name() const {
@@ -99,17 +163,12 @@ std::string_view Path::base_name() const {
         return "/";
     }
 
-    if (is_absolute()) {
-        return {base.begin() + positions[size() - 2] + 1,
-                base.size() - 1 - static_cast<size_t>(positions[size() - 2] + 1)};
+    if (is_relative() && size() == 1) {
+        return {data, length - 1};
     }
 
-    if (size() == 1) {
-        return {base.begin(), base.size() - 1};
-    } else {
-        return {base.begin() + positions[size() - 2] + 1,
-                base.size() - 1 - static_cast<size_t>(positions[size() - 2] + 1)};
-    }
+    size_t start = separator(size() - 2) + 1;
+    return {data + start, length - 1 - start};
 }
 
 std::string_view Path::root_name() const {
@@ -121,7 +180,7 @@ std::string_view Path::root_name() const {
         return "/";
     }
 
-    return {base.begin(), positions.front()};
+    return {data, separator(0)};
 }
 
 std::string_view Path::sub_root_name() const {
@@ -131,11 +190,11 @@ std::string_view Path::sub_root_name() const {
         return "";
     }
 
-    return {base.begin() + 1, static_cast<size_t>(positions[1]) - 1};
+    return {data + 1, separator(1) - 1};
 }
 
 bool Path::is_absolute() const {
-    return !base.empty() && base[0] == '/';
+    return length && data[0] == '/';
 }
 
 bool Path::is_relative() const {
@@ -143,19 +202,15 @@ bool Path::is_relative() const {
 }
 
 std::string_view Path::name(size_t i) const {
-    if (is_absolute()) {
-        if (i == 0) {
+    if (i == 0) {
+        if (is_absolute()) {
             return "/";
         }
-
-        return {base.begin() + positions[i - 1] + 1, size_t(positions[i] - 1) - positions[i - 1]};
-    }
-
-    if (i == 0) {
-        return {base.begin(), positions[i]};
+        return {data, separator(0)};
     }
 
-    return {base.begin() + positions[i - 1] + 1, size_t(positions[i] - 1) - positions[i - 1]};
+    size_t start = separator(i - 1) + 1;
+    return {data + start, separator(i) - start};
 }
 
 std::string_view Path::operator[](size_t i) const {
@@ -168,58 +223,30 @@ Path Path::sub_path(size_t i) const {
     }
 
     Path p;
-
-    if (is_absolute()) {
-        if (i == size()) {
-            return p;
-        }
-
-        p.base.assign(base.begin() + positions[i - 1] + 1, base.end());
-    } else {
-        if (i == size()) {
-            return p;
-        }
-
-        p.base.assign(base.begin() + positions[i - 1] + 1, base.end());
+    if (i == size()) {
+        return p;
     }
 
-    update_positions(p.base, p.positions);
-
+    p.copy(string().substr(separator(i - 1) + 1));
     return p;
 }
 
 Path Path::branch_path() const {
-    if (empty()) {
-        return *this;
-    }
-
-    if (is_root()) {
-        return *this;
-    }
-
-    if (is_relative() && size() == 1) {
+    if (empty() || is_root() || (is_relative() && size() == 1)) {
         return *this;
     }
 
     Path p;
-
-    if (is_relative()) {
-        p.base.assign(base.begin(), base.begin() + positions[size() - 2]);
-    } else {
-        p.base.assign(base.begin(), base.begin() + positions[size() - 2]);
-    }
-
-    update_positions(p.base, p.positions);
-
+    p.assign(string().substr(0, separator(size() - 2)));
     return p;
 }
 
 bool Path::operator==(const Path &p) const {
-    return base == p.base;
+    return string() == p.string();
 }
 
 bool Path::operator!=(const Path &p) const {
-    return base != p.base;
+    return !(*this == p);
 }
 
 bool Path::operator==(std::string_view p) const {
@@ -38,9 +38,14 @@ namespace simple_fs {
             disk_->read(i, block.data);
 
             for (auto &inode: block.inodes) {
-                if (inode.Valid) {
+                if (inode.Valid && !(inode.Valid & INODE_CONTINUATION)) {
                     Logger::instance().println("Inode %d:\n", ii);
                     Logger::instance().println("    file size: %d bytes\n", inode.Size);
+                    if (inode.Valid & INODE_INLINE) {
+                        Logger::instance().println("    inline data");
+                        ii++;
+                        continue;
+                    }
                     Logger::instance().println("    direct blocks:");
 
                     for (auto directPtr: inode.Direct)
@@ -140,6 +145,17 @@ namespace simple_fs {
         Logger::instance().println("[SIMPLE_FS] Finished formatting disk!");
     }
 
+    bool SimpleFS::formatted() {
+        checkDiskNotMounted();
+
+        Block block;
+        disk_->read(0, block.data);
+
+        /// Same checks as mount, the file system also has to fit on the disk
+        return block.super.MagicNumber == MAGIC_NUMBER && block.super == SuperBlock{block.super.Blocks} &&
+               block.super.Blocks <= disk_->size();
+    }
+
     void SimpleFS::mount() {
         Logger::instance().println("[SIMPLE_FS] Mounting...");
         /// Sanity check
@@ -170,6 +186,12 @@ namespace simple_fs {
         inode_counter.resize(MetaData.InodeBlocks);
         std::fill(inode_counter.begin(), inode_counter.end(), 0);
 
+        /// Allocate inode bitmap, the cursor starts at the beginning of the inode table
+        Logger::instance().println("[SIMPLE_FS] Allocating inode bitmap...");
+        inode_bitmap.resize((MetaData.Inodes + 63) / 64);
+        std::fill(inode_bitmap.begin(), inode_bitmap.end(), 0);
+        next_free_inode = 0;
+
         /// Setting free bit map node 0 to true for superBlock
         occupied_block[0] = true;
 
@@ -177,21 +199,24 @@ namespace simple_fs {
         for (uint32_t i = 1; i <= MetaData.InodeBlocks; i++) {
             disk_->read(i, block.data);
 
-            for (auto &inode: block.inodes) {
+            for (uint32_t j = 0; j < INODES_PER_BLOCK; j++) {
+                auto &inode = block.inodes[j];
                 if (inode.Valid) {
                     inode_counter[i - 1]++;
+                    mark_inode((i - 1) * INODES_PER_BLOCK + j, true);
 
                     /// Set free bit map for inode blocks
                     if (inode.Valid)
                         occupied_block[i] = true;
 
+                    /// Inline data and continuation slots hold no pointers
+                    if (inode.Valid & (INODE_INLINE | INODE_CONTINUATION))
+                        continue;
+
                     /// Set free bit map for direct pointers
-                    for (uint32_t k = 0; k < POINTERS_PER_INODE; k++) {
-                        if (inode.Direct[k]) {
-                            kAssert(inode.Direct[k] < MetaData.dataEnd,
-                                    "[SIMPLE_FS] Data pointer out of bounds!");
-                            occupied_block[inode.Direct[k]] = true;
-                        }
+                    for (auto ptr: inode.Direct) {
+                        if (ptr)
+                            mark_pointer(inode, ptr, true);
                     }
 
                     /// Set free bit map for indirect pointers
@@ -205,9 +230,8 @@ namespace simple_fs {
                         disk_->read(inode.Indirect, indirect.data);
                         /// Mark indirect pointer blocks as occupied
                         for (auto pointer: indirect.pointers) {
-                            kAssert(pointer < MetaData.dataEnd,
-                                    "[SIMPLE_FS] Indirect pointer out of bounds!");
-                            occupied_block[pointer] = true;
+                            if (pointer)
+                                mark_pointer(inode, pointer, true);
                         }
                     }
                 }
@@ -239,60 +263,90 @@ namespace simple_fs {
         Logger::instance().println("[SIMPLE_FS] Finished mount!");
     }
 
-    ssize_t SimpleFS::create() {
-        checkFsMounted();
+    void SimpleFS::mark_inode(size_t inumber, bool used) {
+        if (used) {
+            inode_bitmap[inumber / 64] |= (1ULL << (inumber % 64));
+        } else {
+            inode_bitmap[inumber / 64] &= ~(1ULL << (inumber % 64));
+            /// Keep the invariant that no inode below the cursor is free
+            next_free_inode = std::min(next_free_inode, inumber);
+        }
+    }
 
-        /// Read the superBlock
-        Block block;
-        disk_->read(0, block.data);
+    bool SimpleFS::inode_in_use(size_t inumber) const {
+        return inode_bitmap[inumber / 64] & (1ULL << (inumber % 64));
+    }
 
-        /// Locate free inode in inode table
-        for (uint32_t i = 1; i <= MetaData.InodeBlocks; i++) {
-            /// Check if inode block is full
-            if (inode_counter[i - 1] == INODES_PER_BLOCK)
+    ssize_t SimpleFS::find_free_inode() {
+        /// Skip whole words of used inodes, starting from the cursor
+        for (size_t word = next_free_inode / 64; word < inode_bitmap.size(); word++) {
+            if (inode_bitmap[word] == ~0ULL)
                 continue;
-            /// Inode block is not full
-            disk_->read(i, block.data);
 
-            /// Find the first empty inode
-            for (uint32_t j = 0; j < INODES_PER_BLOCK; j++) {
-                /// Set the inode to default values
-                if (!block.inodes[j].Valid) {
-                    block.inodes[j].clear();
-                    block.inodes[j].Valid = true;
-                    occupied_block[i] = true;
-                    inode_counter[i - 1]++;
+            size_t inumber = word * 64 + __builtin_ctzll(~inode_bitmap[word]);
+            if (inumber >= MetaData.Inodes)
+                break;
 
-                    disk_->write(i, block.data);
-
-                    return (((i - 1) * INODES_PER_BLOCK) + j);
-                }
-            }
+            next_free_inode = inumber;
+            return (ssize_t) inumber;
         }
 
-        Logger::instance().println("[SIMPLE_FS] Failed to create inode!");
+        next_free_inode = MetaData.Inodes;
         return -1;
     }
 
-    bool SimpleFS::load_inode(size_t inumber, Inode *node) {
+    ssize_t SimpleFS::create() {
         checkFsMounted();
 
-        if ((inumber > MetaData.Inodes)) {
+        /// Locate free inode in the in-memory inode bitmap
+        ssize_t inumber = find_free_inode();
+        if (inumber == -1) {
+            Logger::instance().println("[SIMPLE_FS] Failed to create inode!");
+            return -1;
+        }
+
+        size_t i = inumber / INODES_PER_BLOCK;
+        size_t j = inumber % INODES_PER_BLOCK;
+
+        /// An inode block with no valid inodes can be overwritten without reading it first
+        Block block;
+        if (inode_counter[i])
+            disk_->read(i + 1, block.data);
+
+        /// Set the inode to default values
+        block.inodes[j].clear();
+        block.inodes[j].Valid = INODE_VALID | (compress_new_files ? INODE_COMPRESSED : 0);
+        disk_->write(i + 1, block.data);
+
+        occupied_block[i + 1] = true;
+        inode_counter[i]++;
+        mark_inode(inumber, true);
+
+        return inumber;
+    }
+
+    bool SimpleFS::load_inode(size_t inumber, Inode *node, Block *block) {
+        checkFsMounted();
+
+        if ((inumber >= MetaData.Inodes)) {
             Logger::instance().println("[SIMPLE_FS] Invalid inode! %X", inumber);
             return false;
         }
 
-        Block block;
+        Block local;
+        if (!block)
+            block = &local;
 
         /// Find index of inode in the inode table
         size_t i = inumber / INODES_PER_BLOCK;
         size_t j = inumber % INODES_PER_BLOCK;
 
-        /// Load the inode into Inode *node
-        if (inode_counter[i]) {
-            disk_->read(i + 1, block.data);
-            if (block.inodes[j].Valid) {
-                *node = block.inodes[j];
+        /// Load the inode into Inode *node, free inodes are known without reading the disk
+        if (inode_counter[i] && inode_in_use(inumber)) {
+            disk_->read(i + 1, block->data);
+            /// Continuation slots are in use, but they hold data of another inode
+            if (block->inodes[j].Valid && !(block->inodes[j].Valid & INODE_CONTINUATION)) {
+                *node = block->inodes[j];
                 return true;
             }
             Logger::instance().println("[SIMPLE_FS] Inode is invalid!");
@@ -306,10 +360,16 @@ namespace simple_fs {
         checkFsMounted();
 
         Inode node{};
+        Block block;
 
         /// Check if the node is valid; if yes, then load the inode
-        if (load_inode(inumber, &node)) {
-            node.Valid = false;
+        if (load_inode(inumber, &node, &block)) {
+            if (node.Valid & INODE_INLINE) {
+                /// Inline files own no data blocks, only their continuation slots
+                resize_inline(node, block, inumber, 0);
+                std::fill(node.Direct.begin(), node.Direct.end(), 0);
+                node.Indirect = 0;
+            }
             node.Size = 0;
 
             /**- Decrement the corresponding inode block in inode counter
@@ -317,11 +377,13 @@ namespace simple_fs {
             if (!(--inode_counter[inumber / INODES_PER_BLOCK])) {
                 occupied_block[inumber / INODES_PER_BLOCK + 1] = false;
             }
+            mark_inode(inumber, false);
 
             /// Free direct blocks
-            for (uint32_t i = 0; i < POINTERS_PER_INODE; i++) {
-                occupied_block[node.Direct[i]] = false;
-                node.Direct[i] = 0;
+            for (auto &ptr: node.Direct) {
+                if (ptr)
+                    mark_pointer(node, ptr, false);
+                ptr = 0;
             }
 
             /// Free indirect blocks
@@ -333,12 +395,11 @@ namespace simple_fs {
 
                 for (auto indirectPtr: indirect.pointers) {
                     if (indirectPtr)
-                        occupied_block[indirectPtr] = false;
+                        mark_pointer(node, indirectPtr, false);
                 }
             }
+            node.Valid = 0;
 
-            Block block;
-            disk_->read(inumber / INODES_PER_BLOCK + 1, block.data);
             block.inodes[inumber % INODES_PER_BLOCK] = node;
             disk_->write(inumber / INODES_PER_BLOCK + 1, block.data);
 
@@ -360,122 +421,172 @@ namespace simple_fs {
         return -1;
     }
 
-    void SimpleFS::read_helper(uint32_t blockNum, int offset, int *length, uint8_t **data, uint8_t **ptr) {
-        /// Read the block from disk and change the pointers accordingly
-        disk_->read(blockNum, *ptr);
-        *data += offset;
-        *ptr += BLOCK_SIZE;
-        *length -= (BLOCK_SIZE - offset);
-    }
-
-    ssize_t SimpleFS::read(size_t inumber, uint8_t *data, int length, size_t offset) {
+    bool SimpleFS::stat(size_t inumber, vfs::file_stat &st) {
         checkFsMounted();
 
-        /// IMPORTANT: start reading from index = offset
-        auto size_inode = stat(inumber);
+        Inode node{};
+        if (!load_inode(inumber, &node))
+            return false;
 
-        /**- if offset is greater than size of inode, then no data can be read
-         * if length + offset exceeds the size of inode, adjust length accordingly
-        */
-        if ((int) offset >= size_inode)
-            return 0;
-        else if (length + (int) offset > size_inode)
-            length = size_inode - (int) offset;
+        st.size = node.Size;
+        st.blockSize = BLOCK_SIZE;
+        st.blocks = 0;
 
-        Inode node{};
+        /// Inline data lives in the inode block
+        if (node.Valid & INODE_INLINE)
+            return true;
 
-        /// Data is head; ptr is tail
-        uint8_t *ptr = data;
-        int to_read = length;
+        /// Holes are not allocated, so only the non-null pointers are counted
+        auto blocks_of = [&node](BlockPointer ptr) -> uint64_t {
+            if (!ptr)
+                return 0;
+            BlockPointer start;
+            uint32_t count;
+            node.extent(ptr, start, count);
+            return count;
+        };
 
-        /// Load inode; if invalid, return error
-        if (!load_inode(inumber, &node))
-            return -1;
+        for (auto ptr: node.Direct)
+            st.blocks += blocks_of(ptr);
 
-        /// The offset is within direct pointers
-        if (offset < POINTERS_PER_INODE * BLOCK_SIZE) {
-            /// Calculate the node to start reading from
-            uint32_t direct_node = offset / BLOCK_SIZE;
-            offset %= BLOCK_SIZE;
+        if (node.Indirect) {
+            Block indirect;
+            disk_->read(node.Indirect, indirect.data);
+            st.blocks++;
+            for (auto ptr: indirect.pointers)
+                st.blocks += blocks_of(ptr);
+        }
 
-            /// Check if the direct node is valid
-            if (!node.Direct[direct_node]) {
-                /// Inode has no stored data
-                return 0;
-            }
+        return true;
+    }
 
-            read_helper(node.Direct[direct_node++], offset, &length, &data, &ptr);
+    BlockPointer SimpleFS::get_block(const Inode &node, uint32_t index, IndirectBlock &indirect) {
+        if (index < POINTERS_PER_INODE)
+            return node.Direct[index];
 
-            /// Read the direct blocks
-            while (length > 0 && direct_node < POINTERS_PER_INODE && node.Direct[direct_node]) {
-                read_helper(node.Direct[direct_node++], 0, &length, &data, &ptr);
-            }
+        /// Without an indirect block everything past the direct pointers is a hole
+        if (!node.Indirect)
+            return 0;
 
-            /// If length <= 0, then enough data has been read
-            if (length <= 0)
-                return to_read;
+        if (!indirect.loaded) {
+            disk_->read(node.Indirect, indirect.block.data);
+            indirect.loaded = true;
+        }
+        return indirect.block.pointers[index - POINTERS_PER_INODE];
+    }
 
-            /// More data is to be read
+    bool SimpleFS::set_block(Inode &node, uint32_t index, BlockPointer ptr, IndirectBlock &indirect) {
+        if (index < POINTERS_PER_INODE) {
+            node.Direct[index] = ptr;
+            return true;
+        }
 
-            /// Check if all the direct nodes have been read completely and if the indirect pointer is valid
-            if (direct_node == POINTERS_PER_INODE && node.Indirect) {
-                Block indirect;
-                disk_->read(node.Indirect, indirect.data);
+        /// The indirect block is only allocated once a write goes past the direct pointers
+        if (!node.Indirect) {
+            node.Indirect = allocate_block();
+            if (!node.Indirect)
+                return false;
+            indirect.block.clear();
+            indirect.loaded = true;
+        } else if (!indirect.loaded) {
+            disk_->read(node.Indirect, indirect.block.data);
+            indirect.loaded = true;
+        }
 
-                /// Read the indirect nodes
-                for (auto pointer: indirect.pointers) {
-                    if (pointer && length > 0) {
-                        read_helper(pointer, 0, &length, &data, &ptr);
-                    } else break;
-                }
+        indirect.block.pointers[index - POINTERS_PER_INODE] = ptr;
+        indirect.dirty = true;
+        return true;
+    }
 
-                /// If length <= 0, then enough data has been read
-                if (length <= 0)
-                    return to_read;
-                /// Data exhausted, but the length requested was bigger
-                /// Logically, this should never happen
-                return (to_read - length);
-            } else {
-                /// Data exhausted, but the length requested was bigger
-                /// Logically, this should never happen
-                return (to_read - length);
-            }
-        } else {
-            /// Offset begins in the indirect block
-            /// Check if the indirect node is valid
+    BlockPointer SimpleFS::map_block(Inode &node, uint32_t index, IndirectBlock &indirect, bool &allocated) {
+        allocated = false;
 
-            if (!node.Indirect) {
-                /// The indirect node is invalid
-                return 0;
-            }
+        BlockPointer blockNum = get_block(node, index, indirect);
+        if (blockNum & POINTER_UNWRITTEN) {
+            /// First write to a preallocated block, it is handed out like a new one so the rest reads as zeroes
+            blockNum &= ~POINTER_UNWRITTEN;
+            set_block(node, index, blockNum, indirect);
+            allocated = true;
+            return blockNum;
+        }
+        if (blockNum)
+            return blockNum;
 
-            /// Change offset accordingly and find the indirect node to start reading from
-            offset -= (POINTERS_PER_INODE * BLOCK_SIZE);
-            uint32_t indirect_node = offset / BLOCK_SIZE;
-            offset %= BLOCK_SIZE;
+        blockNum = allocate_block();
+        if (!blockNum)
+            return 0;
 
-            Block indirect;
-            disk_->read(node.Indirect, indirect.data);
+        if (!set_block(node, index, blockNum, indirect)) {
+            occupied_block[blockNum] = false;
+            return 0;
+        }
 
-            if (indirect.pointers[indirect_node] && length > 0) {
-                read_helper(indirect.pointers[indirect_node++], offset, &length, &data, &ptr);
-            }
+        allocated = true;
+        return blockNum;
+    }
 
-            /// Iterate through the indirect nodes
-            for (uint32_t i = indirect_node; i < POINTERS_PER_BLOCK; i++) {
-                if (indirect.pointers[i] && length > 0) {
-                    read_helper(indirect.pointers[i], 0, &length, &data, &ptr);
-                } else break;
-            }
+    ssize_t SimpleFS::read(size_t inumber, uint8_t *data, int length, size_t offset) {
+        checkFsMounted();
 
-            /// If length <= 0, then enough data has been read
-            if (length <= 0)
-                return to_read;
+        Inode node{};
+        Block inode_block;
+
+        /// Load inode; if invalid, return error
+        if (!load_inode(inumber, &node, &inode_block))
+            return -1;
 
-            /// Data exhausted, but the length requested was bigger
-            /// Logically, this should never happen
-            return (to_read - length);
+        /**- if offset is greater than size of inode, then no data can be read
+         * if length + offset exceeds the size of inode, adjust length accordingly
+        */
+        if (offset >= node.Size || length <= 0)
+            return 0;
+        length = (int) std::min((size_t) length, node.Size - offset);
+
+        if (node.Valid & INODE_INLINE) {
+            /// Inline data comes from the inode block that was just read, no other disk access
+            for (int done = 0; done < length;) {
+                size_t available;
+                uint8_t *src = inline_segment(node, inode_block, inumber, offset + done, available);
+                int chunk = std::min((int) available, length - done);
+                memcpy(data + done, src, chunk);
+                done += chunk;
+            }
+            return length;
+        }
+
+        if (node.Valid & INODE_COMPRESSED)
+            return read_clusters(node, data, length, offset);
+
+        IndirectBlock indirect;
+
+        int done = 0;
+        while (done < length) {
+            uint32_t index = (offset + done) / BLOCK_SIZE;
+            uint32_t in_block = (offset + done) % BLOCK_SIZE;
+            int chunk = std::min((int) (BLOCK_SIZE - in_block), length - done);
+
+            BlockPointer blockNum = get_block(node, index, indirect);
+            if (!blockNum || (blockNum & POINTER_UNWRITTEN)) {
+                /// Holes and preallocated blocks read back as zeroes without touching the disk
+                memset(data + done, 0, chunk);
+            } else if (chunk == (int) BLOCK_SIZE) {
+                /// Full blocks that follow each other on disk are read with a single multi-sector transfer
+                uint32_t run = 1;
+                while ((int) ((run + 1) * BLOCK_SIZE) <= length - done &&
+                       get_block(node, index + run, indirect) == blockNum + run)
+                    run++;
+                disk_->readBlocks(blockNum, run, data + done);
+                chunk = run * BLOCK_SIZE;
+            } else {
+                /// Partial block, go through a bounce buffer so the caller's buffer is not overrun
+                Block block;
+                disk_->read(blockNum, block.data);
+                memcpy(data + done, block.data + in_block, chunk);
+            }
+            done += chunk;
         }
+
+        return done;
     }
 
     uint32_t SimpleFS::allocate_block() {
@@ -493,22 +604,33 @@ namespace simple_fs {
         return 0;
     }
 
-
-    bool SimpleFS::check_allocation(Inode *node, int read, int orig_offset, uint32_t &blockNum, bool write_indirect,
-                                    Block indirect) {
+    BlockPointer SimpleFS::allocate_run(uint32_t count) {
         checkFsMounted();
 
-        /// If blockNum is 0, then allocate a new block
-        if (!blockNum) {
-            blockNum = allocate_block();
-            /// Set size of node and write back to disk if it is an indirect node
-            if (!blockNum) {
-                node->Size = read + orig_offset;
-                if (write_indirect)
-                    disk_->write(node->Indirect, indirect.data);
-                return false;
+        /// First fit over the free block bitmap
+        uint32_t run = 0;
+        for (uint32_t i = MetaData.dataStart; i < MetaData.dataEnd; i++) {
+            run = occupied_block[i] ? 0 : run + 1;
+            if (run == count) {
+                uint32_t start = i + 1 - count;
+                for (uint32_t j = start; j <= i; j++)
+                    occupied_block[j] = true;
+                return start;
             }
         }
-        return true;
+
+        /// No run is long enough
+        return 0;
+    }
+
+    void SimpleFS::mark_pointer(const Inode &node, BlockPointer ptr, bool used) {
+        BlockPointer start;
+        uint32_t count;
+        node.extent(ptr, start, count);
+
+        kAssert(start >= MetaData.dataStart && start + count <= MetaData.dataEnd,
+                "[SIMPLE_FS] Data pointer out of bounds!");
+        for (uint32_t i = start; i < start + count; i++)
+            occupied_block[i] = used;
     }
 }
\ No newline at end of file
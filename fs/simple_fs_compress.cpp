@@ -0,0 +1,167 @@
+/*
+ * simple_fs_compress.cpp
+ *
+ *  Created on: 10/18/26.
+ */
+
+#include "fs/simple_fs.h"
+#include "fs/lz4.h"
+
+namespace simple_fs {
+    bool SimpleFS::setCompressed(size_t inumber, bool compressed) {
+        checkFsMounted();
+
+        Inode node{};
+        if (!load_inode(inumber, &node))
+            return false;
+
+        /// The pointers of the inode change meaning, so only files without data blocks can switch
+        bool empty = !node.Indirect && std::all_of(node.Direct.begin(), node.Direct.end(),
+                                                   [](BlockPointer ptr) { return ptr == 0; });
+        if (!empty) {
+            Logger::instance().println("[SIMPLE_FS] Can't change compression of a file with data!");
+            return false;
+        }
+
+        if (compressed)
+            node.Valid |= INODE_COMPRESSED;
+        else
+            node.Valid &= ~INODE_COMPRESSED;
+
+        write_ret(inumber, &node, 0);
+        return true;
+    }
+
+    void SimpleFS::alloc_cluster_buffers() {
+        /// Only allocated once compressed files are used
+        if (!cluster_buffer.empty())
+            return;
+
+        cluster_buffer.resize(CLUSTER_SIZE);
+        compress_buffer.resize(CLUSTER_SIZE);
+        lz4_table.resize(lz4::HASH_TABLE_SIZE);
+    }
+
+    bool SimpleFS::load_cluster(BlockPointer ptr, uint8_t *out) {
+        BlockPointer start = cluster::start(ptr);
+        uint32_t blocks = cluster::blocks(ptr);
+
+        if (cluster::is_raw(ptr)) {
+            disk_->readBlocks(start, blocks, out);
+            return true;
+        }
+
+        uint8_t *buf = compress_buffer.data();
+        disk_->readBlocks(start, blocks, buf);
+
+        size_t length = buf[0] | (buf[1] << 8);
+        if (length > blocks * BLOCK_SIZE - cluster::HEADER_SIZE ||
+            lz4::decompress(buf + cluster::HEADER_SIZE, length, out, CLUSTER_SIZE) != (ssize_t) CLUSTER_SIZE) {
+            Logger::instance().println("[SIMPLE_FS] Corrupted compressed cluster at block %X!", start);
+            return false;
+        }
+        return true;
+    }
+
+    BlockPointer SimpleFS::store_cluster(const Inode &node, BlockPointer old, uint8_t *cluster) {
+        uint8_t *buf = compress_buffer.data();
+
+        /// Compression has to save at least one block, otherwise the cluster is stored raw
+        const size_t capacity = (CLUSTER_BLOCKS - 1) * BLOCK_SIZE - cluster::HEADER_SIZE;
+        size_t length = lz4::compress(cluster, CLUSTER_SIZE, buf + cluster::HEADER_SIZE, capacity, lz4_table.data());
+
+        uint32_t blocks = CLUSTER_BLOCKS;
+        uint8_t *src = cluster;
+        if (length) {
+            buf[0] = (uint8_t) length;
+            buf[1] = (uint8_t) (length >> 8);
+            blocks = (length + cluster::HEADER_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            memset(buf + cluster::HEADER_SIZE + length, 0, blocks * BLOCK_SIZE - cluster::HEADER_SIZE - length);
+            src = buf;
+        }
+
+        BlockPointer start;
+        if (old && cluster::blocks(old) >= blocks) {
+            /// Rewrite in place and give back the blocks the cluster no longer needs
+            start = cluster::start(old);
+            for (uint32_t i = start + blocks; i < start + cluster::blocks(old); i++)
+                occupied_block[i] = false;
+        } else {
+            /// Allocate before freeing, so the old data survives a full disk
+            start = allocate_run(blocks);
+            if (!start)
+                return 0;
+            if (old)
+                mark_pointer(node, old, false);
+        }
+
+        disk_->writeBlocks(start, blocks, src);
+
+        return cluster::make(start, blocks);
+    }
+
+    ssize_t SimpleFS::read_clusters(const Inode &node, uint8_t *data, int length, size_t offset) {
+        alloc_cluster_buffers();
+
+        IndirectBlock indirect;
+
+        int done = 0;
+        while (done < length) {
+            uint32_t index = (offset + done) / CLUSTER_SIZE;
+            uint32_t in_cluster = (offset + done) % CLUSTER_SIZE;
+            int chunk = std::min((int) (CLUSTER_SIZE - in_cluster), length - done);
+
+            BlockPointer ptr = get_block(node, index, indirect);
+            if (!ptr) {
+                memset(data + done, 0, chunk);
+            } else if (chunk == (int) CLUSTER_SIZE) {
+                /// Whole clusters are decompressed straight into the caller's buffer
+                if (!load_cluster(ptr, data + done))
+                    return -1;
+            } else {
+                if (!load_cluster(ptr, cluster_buffer.data()))
+                    return -1;
+                memcpy(data + done, cluster_buffer.data() + in_cluster, chunk);
+            }
+            done += chunk;
+        }
+
+        return done;
+    }
+
+    int SimpleFS::write_clusters(Inode &node, const uint8_t *data, int length, size_t offset,
+                                 IndirectBlock &indirect) {
+        alloc_cluster_buffers();
+
+        int written = 0;
+        while (written < length) {
+            uint32_t index = (offset + written) / CLUSTER_SIZE;
+            uint32_t in_cluster = (offset + written) % CLUSTER_SIZE;
+            int chunk = std::min((int) (CLUSTER_SIZE - in_cluster), length - written);
+
+            BlockPointer old = get_block(node, index, indirect);
+            uint8_t *cluster = cluster_buffer.data();
+
+            /// A partial write is merged with the old contents of the cluster, a hole starts zeroed
+            if (chunk != (int) CLUSTER_SIZE) {
+                if (!old)
+                    memset(cluster, 0, CLUSTER_SIZE);
+                else if (!load_cluster(old, cluster))
+                    break;
+            }
+            memcpy(cluster + in_cluster, data + written, chunk);
+
+            BlockPointer ptr = store_cluster(node, old, cluster);
+            if (!ptr || (ptr != old && !set_block(node, index, ptr, indirect))) {
+                if (ptr)
+                    mark_pointer(node, ptr, false);
+                Logger::instance().println("[SIMPLE_FS] Disk is full!");
+                break;
+            }
+
+            written += chunk;
+        }
+
+        return written;
+    }
+}
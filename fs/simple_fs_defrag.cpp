@@ -0,0 +1,189 @@
+/*
+ * simple_fs_defrag.cpp
+ *
+ *  Created on: 10/18/26.
+ */
+
+#include "fs/simple_fs.h"
+
+namespace simple_fs {
+    constexpr const uint32_t DEFRAG_COPY_BLOCKS = 16; ///> Blocks moved with one multi-sector transfer
+
+    void SimpleFS::count_fragments(const Inode &node, vfs::frag_stat &st) {
+        /// Inline files have no data blocks
+        if (node.Valid & INODE_INLINE)
+            return;
+
+        IndirectBlock indirect;
+        const uint32_t slots = POINTERS_PER_INODE + (node.Indirect ? POINTERS_PER_BLOCK : 0);
+
+        /// Holes are skipped, a run continues as long as the next extent starts where the last one ended
+        BlockPointer end = 0;
+        uint64_t extents = 0;
+        for (uint32_t i = 0; i < slots; i++) {
+            BlockPointer ptr = get_block(node, i, indirect);
+            if (!ptr)
+                continue;
+
+            BlockPointer start;
+            uint32_t count;
+            node.extent(ptr, start, count);
+
+            if (start != end)
+                st.fragments++;
+            end = start + count;
+            st.blocks += count;
+            extents++;
+        }
+
+        st.extents += extents;
+        if (extents)
+            st.files++;
+    }
+
+    bool SimpleFS::fragmentation(size_t inumber, vfs::frag_stat &st) {
+        checkFsMounted();
+
+        Inode node{};
+        if (!load_inode(inumber, &node))
+            return false;
+
+        st = {};
+        count_fragments(node, st);
+        st.update_score();
+        return true;
+    }
+
+    bool SimpleFS::fragmentation(vfs::frag_stat &st) {
+        checkFsMounted();
+
+        st = {};
+        for (size_t inumber = 0; inumber < MetaData.Inodes; inumber++) {
+            Inode node{};
+            if (inode_in_use(inumber) && load_inode(inumber, &node))
+                count_fragments(node, st);
+        }
+        st.update_score();
+        return true;
+    }
+
+    bool SimpleFS::defrag(size_t inumber) {
+        checkFsMounted();
+
+        Inode node{};
+        if (!load_inode(inumber, &node))
+            return false;
+
+        return defrag(inumber, node);
+    }
+
+    bool SimpleFS::defrag(size_t inumber, const Inode &node) {
+        vfs::frag_stat st{};
+        count_fragments(node, st);
+
+        /// Nothing to do for files that already are a single run
+        if (st.fragments <= 1)
+            return true;
+
+        /// The new indirect block goes right before the data, in the order a read touches them
+        BlockPointer run = allocate_run(st.blocks + (node.Indirect ? 1 : 0));
+        if (!run) {
+            Logger::instance().println("[SIMPLE_FS] No free run of %d blocks to defragment inode %d!",
+                                       st.blocks, inumber);
+            return false;
+        }
+
+        Inode moved = node;
+        Block moved_indirect;
+        BlockPointer next = run;
+        if (node.Indirect)
+            moved.Indirect = next++;
+
+        /// Copy the data first, the old blocks stay untouched until the inode points to the new ones
+        std::vector<uint8_t> buffer(DEFRAG_COPY_BLOCKS * BLOCK_SIZE);
+        BlockPointer copy_src = 0, copy_dst = 0;
+        uint32_t copy_len = 0;
+        auto flush = [&]() {
+            if (!copy_len)
+                return;
+            disk_->readBlocks(copy_src, copy_len, buffer.data());
+            disk_->writeBlocks(copy_dst, copy_len, buffer.data());
+            copy_len = 0;
+        };
+
+        IndirectBlock indirect;
+        const uint32_t slots = POINTERS_PER_INODE + (node.Indirect ? POINTERS_PER_BLOCK : 0);
+        for (uint32_t i = 0; i < slots; i++) {
+            BlockPointer ptr = get_block(node, i, indirect);
+            if (!ptr)
+                continue;
+
+            BlockPointer start;
+            uint32_t count;
+            node.extent(ptr, start, count);
+
+            /// Extents that are already adjacent are copied together, preallocated blocks hold nothing to copy
+            if (!(ptr & POINTER_UNWRITTEN)) {
+                if (!copy_len || start != copy_src + copy_len || next != copy_dst + copy_len ||
+                    copy_len + count > DEFRAG_COPY_BLOCKS) {
+                    flush();
+                    copy_src = start;
+                    copy_dst = next;
+                }
+                copy_len += count;
+            }
+
+            BlockPointer moved_ptr = (node.Valid & INODE_COMPRESSED) ? cluster::make(next, count)
+                                                                     : next | (ptr & POINTER_UNWRITTEN);
+            if (i < POINTERS_PER_INODE)
+                moved.Direct[i] = moved_ptr;
+            else
+                moved_indirect.pointers[i - POINTERS_PER_INODE] = moved_ptr;
+            next += count;
+        }
+        flush();
+
+        if (moved.Indirect)
+            disk_->write(moved.Indirect, moved_indirect.data);
+
+        /// Writing the inode is a single sector write, it switches every pointer at once
+        write_ret(inumber, &moved, 0);
+
+        /// Only now the old blocks can be given back
+        for (uint32_t i = 0; i < slots; i++) {
+            BlockPointer ptr = get_block(node, i, indirect);
+            if (ptr)
+                mark_pointer(node, ptr, false);
+        }
+        if (node.Indirect)
+            occupied_block[node.Indirect] = false;
+
+        return true;
+    }
+
+    bool SimpleFS::defrag() {
+        checkFsMounted();
+
+        bool success = true;
+        Block block;
+        for (size_t i = 0; i < inode_counter.size(); i++) {
+            if (!inode_counter[i])
+                continue;
+
+            /// Each inode block is read once, defrag only rewrites the slot of the inode it moves
+            disk_->read(i + 1, block.data);
+            for (size_t j = 0; j < INODES_PER_BLOCK; j++) {
+                size_t inumber = i * INODES_PER_BLOCK + j;
+                const Inode &node = block.inodes[j];
+                /// Continuation slots are in use but hold inline data of the inode before them
+                if (inumber >= MetaData.Inodes || !inode_in_use(inumber) || !node.Valid ||
+                    (node.Valid & INODE_CONTINUATION))
+                    continue;
+                if (!defrag(inumber, node))
+                    success = false;
+            }
+        }
+
+        return success;
+    }
+}
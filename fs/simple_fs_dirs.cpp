@@ -117,6 +117,51 @@ namespace simple_fs {
         return true;
     }
 
+    std::expected<size_t> SimpleFS::openDir(const char name[]) {
+        checkFsMounted();
+
+        /// The root of the mount is always the first directory
+        if (!name[0])
+            return 0;
+
+        int offset = dir_lookup(curr_dir, name);
+        if (offset == -1 || curr_dir.Table[offset].isFile)
+            return std::make_unexpected<size_t>(std::ERROR_NOT_EXISTS);
+        return curr_dir.Table[offset].inum;
+    }
+
+    ssize_t SimpleFS::readDir(size_t dir, size_t cookie, vfs::dir_entry *entries, size_t count) {
+        checkFsMounted();
+
+        if (dir >= MetaData.DirBlocks * DIR_PER_BLOCK)
+            return -1;
+
+        /// The directory is read straight from its block, it does not have to be the current one
+        Block block{};
+        disk_->read(MetaData.Blocks - 1 - dir / DIR_PER_BLOCK, block.data);
+        const Directory &directory = block.Directories[dir % DIR_PER_BLOCK];
+        if (!directory.Valid)
+            return -1;
+
+        /// Slots don't move when entries are added or removed, so the next slot is a stable cookie
+        size_t filled = 0;
+        for (size_t slot = cookie; slot < ENTRIES_PER_DIR && filled < count; slot++) {
+            const Dirent &dirent = directory.Table[slot];
+            if (!dirent.valid)
+                continue;
+
+            vfs::dir_entry &entry = entries[filled++];
+            entry.inum = dirent.inum;
+            entry.cookie = slot + 1;
+            entry.isFile = dirent.isFile;
+            size_t length = 0;
+            for (; length < NAME_SIZE && length + 1 < vfs::DIRENT_NAME_MAX && dirent.Name[length]; length++)
+                entry.name[length] = dirent.Name[length];
+            entry.name[length] = '\0';
+        }
+        return (ssize_t) filled;
+    }
+
     bool SimpleFS::mkdir(const char name[NAME_SIZE]) {
         checkFsMounted();
 
@@ -0,0 +1,86 @@
+/*
+ * simple_fs_inline.cpp
+ *
+ *  Created on: 10/18/26.
+ */
+
+#include "fs/simple_fs.h"
+
+namespace simple_fs {
+    uint8_t *SimpleFS::inline_segment(Inode &node, Block &block, size_t inumber, size_t offset, size_t &available) {
+        kAssert(offset < INLINE_MAX_SIZE, "[SIMPLE_FS] Inline offset out of bounds!");
+
+        if (offset < INLINE_SIZE) {
+            available = INLINE_SIZE - offset;
+            return node.inline_data() + offset;
+        }
+
+        offset -= INLINE_SIZE;
+        uint32_t slot = inumber % INODES_PER_BLOCK + 1 + offset / CONTINUATION_SIZE;
+        kAssert(slot < INODES_PER_BLOCK, "[SIMPLE_FS] Continuation slot out of bounds!");
+
+        available = CONTINUATION_SIZE - offset % CONTINUATION_SIZE;
+        return block.inodes[slot].continuation_data() + offset % CONTINUATION_SIZE;
+    }
+
+    bool SimpleFS::inline_fits(const Inode &node, size_t inumber, size_t size) {
+        if (size > INLINE_MAX_SIZE)
+            return false;
+
+        uint32_t have = (node.Valid & INODE_INLINE) ? inline_slots(node.Size) : 0;
+        uint32_t need = inline_slots(size);
+
+        /// Continuation slots never cross into the next inode block
+        if (inumber % INODES_PER_BLOCK + need >= INODES_PER_BLOCK)
+            return false;
+
+        for (uint32_t k = have + 1; k <= need; k++) {
+            if (inode_in_use(inumber + k))
+                return false;
+        }
+        return true;
+    }
+
+    void SimpleFS::resize_inline(Inode &node, Block &block, size_t inumber, size_t size) {
+        uint32_t have = (node.Valid & INODE_INLINE) ? inline_slots(node.Size) : 0;
+        uint32_t need = inline_slots(size);
+        size_t i = inumber / INODES_PER_BLOCK;
+        size_t j = inumber % INODES_PER_BLOCK;
+
+        /// Claimed slots start zeroed, bytes past the end of an inline file are always 0
+        for (uint32_t k = have + 1; k <= need; k++) {
+            block.inodes[j + k].clear();
+            block.inodes[j + k].Valid = INODE_CONTINUATION;
+            mark_inode(inumber + k, true);
+            inode_counter[i]++;
+        }
+
+        for (uint32_t k = need + 1; k <= have; k++) {
+            block.inodes[j + k].clear();
+            mark_inode(inumber + k, false);
+            inode_counter[i]--;
+        }
+    }
+
+    bool SimpleFS::spill_inline(Inode &node, Block &block, size_t inumber, IndirectBlock &indirect) {
+        uint8_t saved[INLINE_MAX_SIZE];
+        int size = (int) node.Size;
+        for (int done = 0; done < size;) {
+            size_t available;
+            uint8_t *src = inline_segment(node, block, inumber, done, available);
+            int chunk = std::min((int) available, size - done);
+            memcpy(saved + done, src, chunk);
+            done += chunk;
+        }
+
+        resize_inline(node, block, inumber, 0);
+        node.Valid &= ~INODE_INLINE;
+        std::fill(node.Direct.begin(), node.Direct.end(), 0);
+        node.Indirect = 0;
+
+        int written = (node.Valid & INODE_COMPRESSED) ? write_clusters(node, saved, size, 0, indirect)
+                                                      : write_blocks(node, saved, size, 0, indirect);
+        node.Size = written;
+        return written == size;
+    }
+}
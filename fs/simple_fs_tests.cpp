@@ -42,6 +42,209 @@ namespace simple_fs {
         kAssert(std::equal(data, data + SIZE_TO_READ, buffer), "[SIMPLE_FS] Data mismatch on read back");
     }
 
+    void test_sparse_file(SimpleFS &fs) {
+        bool touchSucceeded = fs.touch("sparse_file");
+        kAssert(touchSucceeded, "[SIMPLE_FS] Failed to create file!");
+
+        auto fileOffset = fs.dir_lookup(fs.curr_dir, "sparse_file");
+        auto inodeNumber = fs.curr_dir.Table[fileOffset].inum;
+
+        // Writing past the direct pointers should allocate only the indirect block and the touched block
+        constexpr const size_t OFFSET = (POINTERS_PER_INODE + 2) * BLOCK_SIZE + 10;
+        const uint8_t data[] = {'a', 'b', 'c'};
+        auto bytes_written = fs.write(inodeNumber, data, sizeof(data), OFFSET);
+        kAssert(bytes_written == sizeof(data), "[SIMPLE_FS] Failed to write past a hole");
+
+        vfs::file_stat st{};
+        kAssert(fs.stat(inodeNumber, st), "[SIMPLE_FS] Failed to stat sparse file");
+        kAssert(st.size == OFFSET + sizeof(data) && st.blocks == 2, "[SIMPLE_FS] Holes should not be allocated");
+
+        uint8_t buffer[BLOCK_SIZE];
+        memset(buffer, 0xFF, BLOCK_SIZE);
+        auto bytes_read = fs.read(inodeNumber, buffer, BLOCK_SIZE, BLOCK_SIZE);
+        kAssert(bytes_read == BLOCK_SIZE, "[SIMPLE_FS] Failed to read a hole");
+        kAssert(std::all_of(buffer, buffer + BLOCK_SIZE, [](uint8_t b) { return b == 0; }),
+                "[SIMPLE_FS] Hole should read back as zeroes");
+
+        // A partial overwrite has to keep the rest of the block intact
+        const uint8_t patch = 'X';
+        fs.write(inodeNumber, &patch, 1, OFFSET + 1);
+        bytes_read = fs.read(inodeNumber, buffer, sizeof(data), OFFSET);
+        kAssert(bytes_read == sizeof(data) && buffer[0] == 'a' && buffer[1] == 'X' && buffer[2] == 'c',
+                "[SIMPLE_FS] Partial overwrite corrupted the block");
+
+        bool removed = fs.rm("sparse_file");
+        kAssert(removed, "[SIMPLE_FS] Failed to remove sparse file");
+    }
+
+    void test_compressed_file(SimpleFS &fs) {
+        bool touchSucceeded = fs.touch("compressed_file");
+        kAssert(touchSucceeded, "[SIMPLE_FS] Failed to create file!");
+
+        auto fileOffset = fs.dir_lookup(fs.curr_dir, "compressed_file");
+        auto inodeNumber = fs.curr_dir.Table[fileOffset].inum;
+        kAssert(fs.setCompressed(inodeNumber, true), "[SIMPLE_FS] Failed to enable compression");
+
+        // Two clusters of repetitive data, written one block at a time
+        uint8_t buffer[BLOCK_SIZE];
+        for (size_t offset = 0; offset < 2 * CLUSTER_SIZE; offset += BLOCK_SIZE) {
+            for (size_t i = 0; i < BLOCK_SIZE; i++)
+                buffer[i] = 'a' + (offset + i) % 7;
+            auto bytes_written = fs.write(inodeNumber, buffer, BLOCK_SIZE, offset);
+            kAssert(bytes_written == BLOCK_SIZE, "[SIMPLE_FS] Failed to write compressed file");
+        }
+
+        vfs::file_stat st{};
+        kAssert(fs.stat(inodeNumber, st), "[SIMPLE_FS] Failed to stat compressed file");
+        kAssert(st.size == 2 * CLUSTER_SIZE && st.blocks < 2 * CLUSTER_BLOCKS,
+                "[SIMPLE_FS] Compressible data should take fewer blocks");
+
+        // Read across the cluster boundary
+        constexpr const size_t OFFSET = CLUSTER_SIZE - 100;
+        auto bytes_read = fs.read(inodeNumber, buffer, BLOCK_SIZE, OFFSET);
+        kAssert(bytes_read == BLOCK_SIZE, "[SIMPLE_FS] Failed to read compressed file");
+        for (size_t i = 0; i < BLOCK_SIZE; i++)
+            kAssert(buffer[i] == 'a' + (OFFSET + i) % 7, "[SIMPLE_FS] Data mismatch in compressed file");
+
+        kAssert(!fs.setCompressed(inodeNumber, false), "[SIMPLE_FS] Compression of a file with data can't change");
+
+        bool removed = fs.rm("compressed_file");
+        kAssert(removed, "[SIMPLE_FS] Failed to remove compressed file");
+    }
+
+    void test_defrag(SimpleFS &fs) {
+        kAssert(fs.touch("frag_a") && fs.touch("frag_b"), "[SIMPLE_FS] Failed to create files!");
+
+        auto inodeA = fs.curr_dir.Table[fs.dir_lookup(fs.curr_dir, "frag_a")].inum;
+        auto inodeB = fs.curr_dir.Table[fs.dir_lookup(fs.curr_dir, "frag_b")].inum;
+
+        // Interleaved writes make the two files share the same area of the disk
+        constexpr const size_t BLOCKS = POINTERS_PER_INODE + 3;
+        uint8_t buffer[BLOCK_SIZE];
+        for (size_t i = 0; i < BLOCKS; i++) {
+            memset(buffer, 'a' + i, BLOCK_SIZE);
+            kAssert(fs.write(inodeA, buffer, BLOCK_SIZE, i * BLOCK_SIZE) == BLOCK_SIZE, "[SIMPLE_FS] Write failed");
+            kAssert(fs.write(inodeB, buffer, BLOCK_SIZE, i * BLOCK_SIZE) == BLOCK_SIZE, "[SIMPLE_FS] Write failed");
+        }
+
+        vfs::frag_stat st{};
+        kAssert(fs.fragmentation(inodeA, st), "[SIMPLE_FS] Failed to compute fragmentation");
+        kAssert(st.extents == BLOCKS && st.fragments == BLOCKS && st.score == 100,
+                "[SIMPLE_FS] Interleaved file should be fully fragmented");
+
+        kAssert(fs.defrag(inodeA), "[SIMPLE_FS] Failed to defragment file");
+        kAssert(fs.fragmentation(inodeA, st), "[SIMPLE_FS] Failed to compute fragmentation");
+        kAssert(st.fragments == 1 && st.score == 0, "[SIMPLE_FS] Defragmented file should be a single run");
+
+        for (size_t i = 0; i < BLOCKS; i++) {
+            auto bytes_read = fs.read(inodeA, buffer, BLOCK_SIZE, i * BLOCK_SIZE);
+            kAssert(bytes_read == BLOCK_SIZE && buffer[0] == 'a' + i && buffer[BLOCK_SIZE - 1] == 'a' + i,
+                    "[SIMPLE_FS] Data mismatch after defragmentation");
+        }
+
+        kAssert(fs.rm("frag_a") && fs.rm("frag_b"), "[SIMPLE_FS] Failed to remove files");
+    }
+
+    void test_inline_file(SimpleFS &fs) {
+        bool touchSucceeded = fs.touch("inline_file");
+        kAssert(touchSucceeded, "[SIMPLE_FS] Failed to create file!");
+
+        auto fileOffset = fs.dir_lookup(fs.curr_dir, "inline_file");
+        auto inodeNumber = fs.curr_dir.Table[fileOffset].inum;
+
+        // Small enough to need a continuation slot, but not a data block
+        constexpr const size_t SMALL = INLINE_SIZE + 40;
+        uint8_t buffer[2 * INLINE_MAX_SIZE];
+        for (size_t i = 0; i < sizeof(buffer); i++)
+            buffer[i] = 'a' + i % 23;
+        kAssert(fs.write(inodeNumber, buffer, SMALL, 0) == SMALL, "[SIMPLE_FS] Failed to write inline file");
+
+        vfs::file_stat st{};
+        kAssert(fs.stat(inodeNumber, st), "[SIMPLE_FS] Failed to stat inline file");
+        kAssert(st.size == SMALL && st.blocks == 0, "[SIMPLE_FS] Tiny file should not take data blocks");
+
+        uint8_t readBuffer[2 * INLINE_MAX_SIZE];
+        auto bytes_read = fs.read(inodeNumber, readBuffer, SMALL, 0);
+        kAssert(bytes_read == SMALL && memcmp(buffer, readBuffer, SMALL) == 0,
+                "[SIMPLE_FS] Data mismatch in inline file");
+
+        // The continuation slot is in use but is not a file, defragmenting everything has to skip it
+        kAssert(fs.defrag(), "[SIMPLE_FS] Failed to defragment with an inline file");
+        bytes_read = fs.read(inodeNumber, readBuffer, SMALL, 0);
+        kAssert(bytes_read == SMALL && memcmp(buffer, readBuffer, SMALL) == 0,
+                "[SIMPLE_FS] Data mismatch in inline file after defragmentation");
+
+        // Growing past the inline area moves the data to a regular block
+        auto bytes_written = fs.write(inodeNumber, buffer + SMALL, sizeof(buffer) - SMALL, SMALL);
+        kAssert(bytes_written == (ssize_t) (sizeof(buffer) - SMALL), "[SIMPLE_FS] Failed to grow inline file");
+        kAssert(fs.stat(inodeNumber, st) && st.size == sizeof(buffer) && st.blocks == 1,
+                "[SIMPLE_FS] Grown file should be stored in a block");
+
+        bytes_read = fs.read(inodeNumber, readBuffer, sizeof(buffer), 0);
+        kAssert(bytes_read == sizeof(buffer) && memcmp(buffer, readBuffer, sizeof(buffer)) == 0,
+                "[SIMPLE_FS] Data mismatch after leaving the inline area");
+
+        bool removed = fs.rm("inline_file");
+        kAssert(removed, "[SIMPLE_FS] Failed to remove inline file");
+    }
+
+    void test_fallocate(SimpleFS &fs) {
+        bool touchSucceeded = fs.touch("prealloc_file");
+        kAssert(touchSucceeded, "[SIMPLE_FS] Failed to create file!");
+
+        auto fileOffset = fs.dir_lookup(fs.curr_dir, "prealloc_file");
+        auto inodeNumber = fs.curr_dir.Table[fileOffset].inum;
+
+        // Enough blocks to need the indirect block too
+        constexpr const size_t BLOCKS = POINTERS_PER_INODE + 5;
+        kAssert(fs.fallocate(inodeNumber, 0, BLOCKS * BLOCK_SIZE, false), "[SIMPLE_FS] Failed to preallocate file");
+
+        vfs::file_stat st{};
+        kAssert(fs.stat(inodeNumber, st) && st.size == BLOCKS * BLOCK_SIZE && st.blocks == BLOCKS + 1,
+                "[SIMPLE_FS] Preallocated blocks should be counted");
+
+        vfs::frag_stat frag{};
+        kAssert(fs.fragmentation(inodeNumber, frag) && frag.fragments == 1,
+                "[SIMPLE_FS] Preallocated file should be a single run");
+
+        // Only the written part of a preallocated block has data, the rest of it still reads as zeroes
+        uint8_t buffer[BLOCK_SIZE];
+        memset(buffer, 'p', 100);
+        kAssert(fs.write(inodeNumber, buffer, 100, 3 * BLOCK_SIZE + 10) == 100, "[SIMPLE_FS] Write failed");
+
+        for (size_t i = 0; i < BLOCKS; i++) {
+            auto bytes_read = fs.read(inodeNumber, buffer, BLOCK_SIZE, i * BLOCK_SIZE);
+            kAssert(bytes_read == BLOCK_SIZE, "[SIMPLE_FS] Failed to read preallocated file");
+            for (size_t j = 0; j < BLOCK_SIZE; j++) {
+                bool written = i == 3 && j >= 10 && j < 110;
+                kAssert(buffer[j] == (written ? 'p' : 0), "[SIMPLE_FS] Data mismatch in preallocated file");
+            }
+        }
+
+        kAssert(fs.stat(inodeNumber, st) && st.blocks == BLOCKS + 1, "[SIMPLE_FS] Writes should not allocate");
+
+        bool removed = fs.rm("prealloc_file");
+        kAssert(removed, "[SIMPLE_FS] Failed to remove preallocated file");
+    }
+
+    void test_inode_reuse(SimpleFS &fs) {
+        bool touchSucceeded = fs.touch("reused_file");
+        kAssert(touchSucceeded, "[SIMPLE_FS] Failed to create file!");
+
+        auto fileOffset = fs.dir_lookup(fs.curr_dir, "reused_file");
+        auto inodeNumber = fs.curr_dir.Table[fileOffset].inum;
+
+        bool removed = fs.rm("reused_file");
+        kAssert(removed, "[SIMPLE_FS] Failed to remove file!");
+
+        // The freed inode is the lowest free one, so it should be handed out again
+        touchSucceeded = fs.touch("reused_file2");
+        kAssert(touchSucceeded, "[SIMPLE_FS] Failed to create file!");
+
+        fileOffset = fs.dir_lookup(fs.curr_dir, "reused_file2");
+        kAssert(fs.curr_dir.Table[fileOffset].inum == inodeNumber, "[SIMPLE_FS] Freed inode was not reused");
+    }
+
     void test_create_directory(SimpleFS &fs) {
         bool created = fs.mkdir("new_directory");
         kAssert(created, "[SIMPLE_FS] Failed to create directory");
@@ -110,6 +313,24 @@ namespace simple_fs {
         Logger::instance().println("[SIMPLE_FS] Testing writing to file...");
         test_write_to_file(*this);
 
+        Logger::instance().println("[SIMPLE_FS] Testing sparse files...");
+        test_sparse_file(*this);
+
+        Logger::instance().println("[SIMPLE_FS] Testing compressed files...");
+        test_compressed_file(*this);
+
+        Logger::instance().println("[SIMPLE_FS] Testing defragmentation...");
+        test_defrag(*this);
+
+        Logger::instance().println("[SIMPLE_FS] Testing inline files...");
+        test_inline_file(*this);
+
+        Logger::instance().println("[SIMPLE_FS] Testing preallocation...");
+        test_fallocate(*this);
+
+        Logger::instance().println("[SIMPLE_FS] Testing inode reuse...");
+        test_inode_reuse(*this);
+
         Logger::instance().println("[SIMPLE_FS] Testing directory creation...");
         test_create_directory(*this);
 
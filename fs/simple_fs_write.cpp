@@ -23,170 +23,261 @@ namespace simple_fs {
         return (size_t) ret;
     }
 
-    void SimpleFS::read_buffer(int offset, int *read, int length, const uint8_t *data, uint32_t blockNum) {
-        checkFsMounted();
+    int SimpleFS::write_blocks(Inode &node, const uint8_t *data, int length, size_t offset,
+                               IndirectBlock &indirect) {
+        /// Only the blocks covered by [offset, offset + length) are allocated, anything skipped stays a hole
+        int written = 0;
+        while (written < length) {
+            uint32_t index = (offset + written) / BLOCK_SIZE;
+            uint32_t in_block = (offset + written) % BLOCK_SIZE;
+            int chunk = std::min((int) (BLOCK_SIZE - in_block), length - written);
+
+            bool allocated;
+            BlockPointer blockNum = map_block(node, index, indirect, allocated);
+            if (!blockNum) {
+                Logger::instance().println("[SIMPLE_FS] Disk is full!");
+                break;
+            }
 
-        Block block;
+            /// A partially overwritten block keeps the rest of its old contents, a new one starts zeroed
+            Block block;
+            if (chunk != (int) BLOCK_SIZE && !allocated)
+                disk_->read(blockNum, block.data);
+            memcpy(block.data + in_block, data + written, chunk);
+            disk_->write(blockNum, block.data);
 
-        /// Read data into ptr and change pointers accordingly
-        for (int i = offset; i < (int) BLOCK_SIZE && *read < length; i++) {
-            block.data[i] = data[*read];
-            *read = *read + 1;
+            written += chunk;
         }
-        disk_->write(blockNum, block.data);
-    }
 
+        return written;
+    }
 
     ssize_t SimpleFS::write(size_t inumber, const uint8_t *data, int length, size_t offset) {
         checkFsMounted();
 
         Inode node{};
-        Block indirect;
-        int read = 0;
-        int orig_offset = offset;
+        Block inode_block;
+        size_t i = inumber / INODES_PER_BLOCK;
+        size_t j = inumber % INODES_PER_BLOCK;
 
-        /// Insufficient size
-        if (length + offset > (POINTERS_PER_BLOCK + POINTERS_PER_INODE) * BLOCK_SIZE) {
+        /**- if the inode is invalid, allocate inode.
+         *  need not write to disk right now; the inode block is written back at the end
+         */
+        bool exists = load_inode(inumber, &node, &inode_block);
+        if (!exists && inode_in_use(inumber)) {
+            /// A continuation slot holds inline data of the inode before it
             return -1;
         }
+        if (!exists) {
+            node.clear();
+            node.Valid = INODE_VALID | (compress_new_files ? INODE_COMPRESSED : 0);
+            if (inode_counter[i])
+                disk_->read(i + 1, inode_block.data);
+            else
+                inode_block.clear();
+        }
 
-        /**- if the inode is invalid, allocate inode.
-         *  need not write to disk right now; will be taken care of in write_ret()
-         */
-        if (!load_inode(inumber, &node)) {
-            node.Valid = true;
-            node.Size = length + offset;
-            for (uint32_t ii = 0; ii < POINTERS_PER_INODE; ii++) {
-                node.Direct[ii] = 0;
+        /// Insufficient size, compressed files map a whole cluster with each pointer
+        size_t unit = (node.Valid & INODE_COMPRESSED) ? CLUSTER_SIZE : BLOCK_SIZE;
+        if (length + offset > (POINTERS_PER_BLOCK + POINTERS_PER_INODE) * unit) {
+            return -1;
+        }
+
+        if (!exists) {
+            inode_counter[i]++;
+            occupied_block[i + 1] = true;
+            mark_inode(inumber, true);
+        }
+
+        IndirectBlock indirect;
+        auto write_data = [&](const uint8_t *buffer, int count, size_t start) {
+            int done = (node.Valid & INODE_COMPRESSED) ? write_clusters(node, buffer, count, start, indirect)
+                                                       : write_blocks(node, buffer, count, start, indirect);
+            if (done)
+                node.Size = std::max((size_t) node.Size, start + done);
+            return done;
+        };
+
+        ssize_t written = 0;
+        size_t size = std::max((size_t) node.Size, offset + length);
+        bool is_inline = node.Valid & INODE_INLINE;
+        /// Blocks preallocated past the end of a file keep it out of the inode block
+        bool no_blocks = !node.Indirect && std::all_of(node.Direct.begin(), node.Direct.end(),
+                                                       [](BlockPointer ptr) { return ptr == 0; });
+
+        if (length > 0 && (is_inline || (!node.Size && no_blocks)) && inline_fits(node, inumber, size)) {
+            /// Tiny files stay in the inode block, so this write is its only disk access
+            resize_inline(node, inode_block, inumber, size);
+            node.Valid |= INODE_INLINE;
+
+            for (int done = 0; done < length;) {
+                size_t available;
+                uint8_t *dest = inline_segment(node, inode_block, inumber, offset + done, available);
+                int chunk = std::min((int) available, length - done);
+                memcpy(dest, data + done, chunk);
+                done += chunk;
             }
-            node.Indirect = 0;
-            inode_counter[inumber / INODES_PER_BLOCK]++;
-            occupied_block[inumber / INODES_PER_BLOCK + 1] = true;
+
+            node.Size = size;
+            written = length;
         } else {
-            /// Set size of the node
-            node.Size = std::max((int) node.Size, length + (int) offset);
+            /// The file outgrew the inline area, its data moves to regular blocks first
+            if (is_inline && !spill_inline(node, inode_block, inumber, indirect))
+                written = -1;
+
+            if (written != -1)
+                written = write_data(data, length, offset);
         }
 
-        /// Check if the offset is within direct pointers
-        if (offset < POINTERS_PER_INODE * BLOCK_SIZE) {
-            /// Find the first node to start writing at and change offset accordingly
-            int direct_node = offset / BLOCK_SIZE;
-            offset %= BLOCK_SIZE;
+        if (indirect.dirty)
+            disk_->write(node.Indirect, indirect.block.data);
 
-            /// Check if the node is valid; if invalid; allocates a block and if no block is available, returns false
-            if (!check_allocation(&node, read, orig_offset, node.Direct[direct_node], false, indirect)) {
-                return write_ret(inumber, &node, read);
-            }
-            /// Read from data buffer
-            read_buffer(offset, &read, length, data, node.Direct[direct_node++]);
-
-            /// Enough data has been read from data buffer
-            if (read == length)
-                return write_ret(inumber, &node, length);
-
-            /**- store in direct pointers till either one of the two things happen:
-            * 1. all the data is stored in the direct pointers
-            * 2. the data is stored in indirect pointers
-            */
-            /// Start writing into direct nodes
-            for (int i = direct_node; i < (int) POINTERS_PER_INODE; i++) {
-                /// Check if the node is valid; if invalid; allocates a block and if no block is available, returns false
-                if (!check_allocation(&node, read, orig_offset, node.Direct[direct_node], false, indirect)) {
-                    return write_ret(inumber, &node, read);
-                }
-                read_buffer(0, &read, length, data, node.Direct[direct_node++]);
+        /// Store the node into the inode block read above
+        inode_block.inodes[j] = node;
+        disk_->write(i + 1, inode_block.data);
 
-                /// Enough data has been read from data buffer
-                if (read == length)
-                    return write_ret(inumber, &node, length);
-            }
+        return written;
+    }
 
-            /// Check if the indirect node is valid
-            if (node.Indirect)
-                disk_->read(node.Indirect, indirect.data);
-            else {
-                /// Check if the node is valid; if invalid; allocates a block and if no block is available, returns false
-                if (!check_allocation(&node, read, orig_offset, node.Indirect, false, indirect)) {
-                    return write_ret(inumber, &node, read);
-                }
-                disk_->read(node.Indirect, indirect.data);
+    bool SimpleFS::fallocate(size_t inumber, size_t offset, size_t length, bool keep_size) {
+        checkFsMounted();
 
-                /// Initialise the indirect nodes
-                for (auto &indirectPtr: indirect.pointers)
-                    indirectPtr = 0;
-            }
+        Inode node{};
+        Block inode_block;
+        if (!load_inode(inumber, &node, &inode_block))
+            return false;
 
-            /// Write into indirect nodes
-            for (unsigned int &indirectPtr: indirect.pointers) {
-                /// Check if the node is valid; if invalid; allocates a block and if no block is available, returns false
-                if (!check_allocation(&node, read, orig_offset, indirectPtr, true, indirect)) {
-                    return write_ret(inumber, &node, read);
-                }
-                read_buffer(0, &read, length, data, indirectPtr);
+        if (node.Valid & INODE_COMPRESSED) {
+            Logger::instance().println("[SIMPLE_FS] Compressed files can't be preallocated!");
+            return false;
+        }
+        if (offset + length > (POINTERS_PER_BLOCK + POINTERS_PER_INODE) * BLOCK_SIZE)
+            return false;
+        if (!length)
+            return true;
 
-                /// Enough data has been read from data buffer
-                if (read == length) {
-                    disk_->write(node.Indirect, indirect.data);
-                    return write_ret(inumber, &node, length);
-                }
+        IndirectBlock indirect;
+        bool success = !(node.Valid & INODE_INLINE) || spill_inline(node, inode_block, inumber, indirect);
+
+        uint32_t first = offset / BLOCK_SIZE;
+        uint32_t last = (offset + length - 1) / BLOCK_SIZE;
+
+        /// Count the holes first, so they can be reserved as one run, with the indirect block right before the data
+        uint32_t holes = 0;
+        for (uint32_t i = first; i <= last; i++) {
+            if (!get_block(node, i, indirect))
+                holes++;
+        }
+        bool needs_indirect = last >= POINTERS_PER_INODE && !node.Indirect;
+        BlockPointer run = (success && holes) ? allocate_run(holes + needs_indirect) : 0;
+        if (run && needs_indirect) {
+            node.Indirect = run++;
+            indirect.block.clear();
+            indirect.loaded = indirect.dirty = true;
+        }
+
+        /// Without a long enough run the blocks are taken one by one; no data is written either way
+        for (uint32_t i = first; i <= last && success; i++) {
+            if (get_block(node, i, indirect))
+                continue;
+
+            BlockPointer ptr = run ? run++ : allocate_block();
+            if (!ptr || !set_block(node, i, ptr | POINTER_UNWRITTEN, indirect)) {
+                if (ptr)
+                    occupied_block[ptr] = false;
+                Logger::instance().println("[SIMPLE_FS] Disk is full!");
+                success = false;
             }
+        }
 
-            /// Space exhausted
-            disk_->write(node.Indirect, indirect.data);
-            return write_ret(inumber, &node, read);
-        } else {
-            /// Offset begins in indirect blocks
-            /// Find the first indirect node to write into and change offset accordingly
-            offset -= (BLOCK_SIZE * POINTERS_PER_INODE);
-            int indirect_node = offset / BLOCK_SIZE;
-            offset %= BLOCK_SIZE;
-
-            /// Check if the indirect node is valid
-            if (node.Indirect)
-                disk_->read(node.Indirect, indirect.data);
-            else {
-                /// Check if the node is valid; if invalid; allocates a block and if no block is available, returns false
-                if (!check_allocation(&node, read, orig_offset, node.Indirect, false, indirect)) {
-                    return write_ret(inumber, &node, read);
-                }
-                disk_->read(node.Indirect, indirect.data);
+        if (success && !keep_size)
+            node.Size = std::max((size_t) node.Size, offset + length);
+
+        if (indirect.dirty)
+            disk_->write(node.Indirect, indirect.block.data);
+
+        inode_block.inodes[inumber % INODES_PER_BLOCK] = node;
+        disk_->write(inumber / INODES_PER_BLOCK + 1, inode_block.data);
 
-                /// Initialise the indirect nodes
-                for (auto &indirectPtr: indirect.pointers) {
-                    indirectPtr = 0;
+        return success;
+    }
+
+    ssize_t SimpleFS::copyRange(size_t src_inumber, size_t src_offset, size_t dst_inumber, size_t dst_offset,
+                                size_t length) {
+        checkFsMounted();
+
+        Inode src{}, dst{};
+        Block inode_block;
+        if (src_inumber == dst_inumber || !load_inode(src_inumber, &src) ||
+            !load_inode(dst_inumber, &dst, &inode_block))
+            return -1;
+
+        /// Only whole blocks of plain files are copied here, the VFS copies anything else through the page cache
+        constexpr const uint32_t SPECIAL = INODE_COMPRESSED | INODE_INLINE;
+        if ((src.Valid & SPECIAL) || (dst.Valid & SPECIAL) || src_offset % BLOCK_SIZE || dst_offset % BLOCK_SIZE)
+            return -1;
+
+        if (src_offset >= src.Size)
+            return 0;
+        length = std::min(length, src.Size - src_offset);
+        if (dst_offset + length > (POINTERS_PER_BLOCK + POINTERS_PER_INODE) * BLOCK_SIZE)
+            return -1;
+
+        IndirectBlock src_indirect, dst_indirect;
+        size_t copied = 0;
+        while (copied < length) {
+            uint32_t chunk = std::min((size_t) BLOCK_SIZE, length - copied);
+            uint32_t index = (dst_offset + copied) / BLOCK_SIZE;
+            BlockPointer from = get_block(src, (src_offset + copied) / BLOCK_SIZE, src_indirect);
+            BlockPointer to = get_block(dst, index, dst_indirect);
+
+            /// Holes and preallocated blocks stay holes, unless they land on data that has to be cleared
+            Block block;
+            if (!from || (from & POINTER_UNWRITTEN)) {
+                if (to && !(to & POINTER_UNWRITTEN)) {
+                    if (chunk == BLOCK_SIZE)
+                        block.clear();
+                    else
+                        disk_->read(to, block.data);
+                    std::fill(block.data, block.data + chunk, 0);
+                    disk_->write(to, block.data);
                 }
+                copied += chunk;
+                continue;
             }
 
-            /// Check if the node is valid; if invalid; allocates a block and if no block is available, returns false
-            if (!check_allocation(&node, read, orig_offset, indirect.pointers[indirect_node], true, indirect)) {
-                return write_ret(inumber, &node, read);
+            bool allocated;
+            to = map_block(dst, index, dst_indirect, allocated);
+            if (!to) {
+                Logger::instance().println("[SIMPLE_FS] Disk is full!");
+                break;
             }
-            read_buffer(offset, &read, length, data, indirect.pointers[indirect_node++]);
 
-            /// Enough data has been read from data buffer
-            if (read == length) {
-                disk_->write(node.Indirect, indirect.data);
-                return write_ret(inumber, &node, length);
+            /// A partial last block keeps the rest of the destination block, or zeroes if it is new
+            if (chunk == BLOCK_SIZE) {
+                disk_->read(from, block.data);
+            } else {
+                Block source;
+                disk_->read(from, source.data);
+                if (allocated)
+                    block.clear();
+                else
+                    disk_->read(to, block.data);
+                memcpy(block.data, source.data, chunk);
             }
+            disk_->write(to, block.data);
+            copied += chunk;
+        }
 
-            /// Write into indirect nodes
-            for (int j = indirect_node; j < (int) POINTERS_PER_BLOCK; j++) {
-                /// Check if the node is valid; if invalid; allocates a block and if no block is available, returns false
-                if (!check_allocation(&node, read, orig_offset, indirect.pointers[j], true, indirect)) {
-                    return write_ret(inumber, &node, read);
-                }
-                read_buffer(0, &read, length, data, indirect.pointers[j]);
+        if (copied)
+            dst.Size = std::max((size_t) dst.Size, dst_offset + copied);
 
-                /// Enough data has been read from data buffer
-                if (read == length) {
-                    disk_->write(node.Indirect, indirect.data);
-                    return write_ret(inumber, &node, length);
-                }
-            }
+        if (dst_indirect.dirty)
+            disk_->write(dst.Indirect, dst_indirect.block.data);
 
-            /// space exhausted
-            disk_->write(node.Indirect, indirect.data);
-            return write_ret(inumber, &node, read);
-        }
+        inode_block.inodes[dst_inumber % INODES_PER_BLOCK] = dst;
+        disk_->write(dst_inumber / INODES_PER_BLOCK + 1, inode_block.data);
+
+        return (ssize_t) copied;
     }
-}
\ No newline at end of file
+}
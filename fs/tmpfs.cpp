@@ -0,0 +1,429 @@
+/*
+ * tmpfs.cpp
+ *
+ *  Created on: 10/19/26.
+ */
+
+#include "fs/tmpfs.h"
+#include "arch/x86_64/logging.h"
+#include "std/cstring.h"
+
+namespace tmpfs {
+    namespace {
+        /// Lengths are given, the constructor that counts them is not constexpr and globals are not constructed
+        constexpr std::string_view CURRENT{".", 1}, PARENT{"..", 2};
+
+        /// FNV-1a
+        size_t hashOf(std::string_view text) {
+            size_t hash = 0xcbf29ce484222325;
+            for (char c: text)
+                hash = (hash ^ (uint8_t) c) * 0x100000001b3;
+            return hash;
+        }
+    }
+
+    TmpFS::TmpFS() : FileSystem(nullptr) {
+        root = allocate(false, nullptr);
+        root->parent = root;
+        current = root;
+    }
+
+    TmpFS::~TmpFS() {
+        release(root);
+    }
+
+    void TmpFS::mount() {
+        Logger::instance().println("[TMPFS] Mounted, there is nothing to read");
+    }
+
+    TmpFS::Node *TmpFS::allocate(bool isFile, Node *parent) {
+        size_t inum;
+        if (!freeInums.empty()) {
+            inum = freeInums.back();
+            freeInums.pop_back();
+        } else {
+            inum = nodes.size();
+            nodes.push_back(nullptr);
+        }
+
+        auto node = new Node;
+        node->inum = inum;
+        node->isFile = isFile;
+        node->parent = parent;
+        if (!isFile)
+            node->buckets.resize(MIN_BUCKETS);
+        nodes[inum] = node;
+        return node;
+    }
+
+    void TmpFS::release(Node *node) {
+        for (auto data: node->chunks)
+            delete[] data;
+
+        for (Entry *entry = node->first; entry;) {
+            Entry *next = entry->next;
+            release(entry->node);
+            delete entry;
+            entry = next;
+        }
+
+        nodes[node->inum] = nullptr;
+        freeInums.push_back(node->inum);
+        delete node;
+    }
+
+    TmpFS::Node *TmpFS::get(size_t inum, bool isFile) const {
+        if (inum >= nodes.size() || !nodes[inum] || nodes[inum]->isFile != isFile)
+            return nullptr;
+        return nodes[inum];
+    }
+
+    TmpFS::Entry *TmpFS::lookup(const Node *dir, std::string_view name, size_t hash) {
+        for (Entry *entry = dir->buckets[hash % dir->buckets.size()]; entry; entry = entry->chain) {
+            if (entry->hash == hash && std::string_view(entry->name) == name)
+                return entry;
+        }
+        return nullptr;
+    }
+
+    void TmpFS::grow(Node *dir) {
+        std::vector<Entry *> buckets;
+        buckets.resize(dir->buckets.size() * 2);
+        for (Entry *entry = dir->first; entry; entry = entry->next) {
+            Entry *&bucket = buckets[entry->hash % buckets.size()];
+            entry->chain = bucket;
+            bucket = entry;
+        }
+        dir->buckets = std::move(buckets);
+    }
+
+    void TmpFS::link(Node *dir, std::string_view name, Node *node) {
+        if (dir->entries >= dir->buckets.size())
+            grow(dir);
+
+        auto entry = new Entry;
+        entry->name = std::string(name.begin(), name.end());
+        entry->hash = hashOf(name);
+        entry->serial = dir->nextSerial++;
+        entry->node = node;
+
+        Entry *&bucket = dir->buckets[entry->hash % dir->buckets.size()];
+        entry->chain = bucket;
+        bucket = entry;
+
+        entry->prev = dir->last;
+        (dir->last ? dir->last->next : dir->first) = entry;
+        dir->last = entry;
+        dir->entries++;
+
+        node->parent = dir;
+        node->entry = entry;
+    }
+
+    void TmpFS::unlink(Node *dir, Entry *entry) {
+        Entry **link = &dir->buckets[entry->hash % dir->buckets.size()];
+        while (*link != entry)
+            link = &(*link)->chain;
+        *link = entry->chain;
+
+        (entry->prev ? entry->prev->next : dir->first) = entry->next;
+        (entry->next ? entry->next->prev : dir->last) = entry->prev;
+        if (dir->resume == entry)
+            dir->resume = entry->next;
+        dir->entries--;
+        delete entry;
+    }
+
+    TmpFS::Node *TmpFS::walk(std::string_view path) const {
+        Node *node = current;
+        for (auto component: PathView(path)) {
+            if (node->isFile)
+                return nullptr;
+            if (component == PARENT) {
+                node = node->parent;
+                continue;
+            }
+
+            Entry *entry = lookup(node, component, hashOf(component));
+            if (!entry)
+                return nullptr;
+            node = entry->node;
+        }
+        return node;
+    }
+
+    TmpFS::Node *TmpFS::parentOf(const char *path, std::string_view &name) const {
+        std::string_view view(path);
+        while (!view.empty() && view[view.size() - 1] == '/')
+            view = view.substr(0, view.size() - 1);
+
+        /// "." and ".." always exist and can't be made or removed
+        name = PathView(view).file_name();
+        if (name.empty() || name == CURRENT || name == PARENT || name.size() >= vfs::DIRENT_NAME_MAX)
+            return nullptr;
+
+        Node *dir = walk(PathView(view).directory());
+        return dir && !dir->isFile ? dir : nullptr;
+    }
+
+    bool TmpFS::create(const char *path, bool isFile) {
+        std::string_view name;
+        Node *dir = parentOf(path, name);
+        if (!dir || lookup(dir, name, hashOf(name)))
+            return false;
+
+        link(dir, name, allocate(isFile, dir));
+        return true;
+    }
+
+    bool TmpFS::remove(const char *path, bool isFile) {
+        std::string_view name;
+        Node *dir = parentOf(path, name);
+        Entry *entry = dir ? lookup(dir, name, hashOf(name)) : nullptr;
+        if (!entry || entry->node->isFile != isFile)
+            return false;
+
+        Node *node = entry->node;
+        if (!isFile) {
+            /// The current directory moves out of the removed one
+            for (Node *up = current; up != root; up = up->parent) {
+                if (up == node) {
+                    current = dir;
+                    break;
+                }
+            }
+        }
+
+        unlink(dir, entry);
+        release(node);
+        return true;
+    }
+
+    uint8_t *TmpFS::chunk(Node *file, size_t offset) {
+        size_t index = offset / CHUNK_SIZE;
+        if (index >= file->chunks.size())
+            file->chunks.resize(index + 1);
+        if (!file->chunks[index])
+            file->chunks[index] = new uint8_t[CHUNK_SIZE]{};
+        return file->chunks[index];
+    }
+
+    ssize_t TmpFS::read(size_t inum, uint8_t *buffer, int length, size_t offset) {
+        Node *file = get(inum, true);
+        if (!file || length < 0)
+            return -1;
+        if (offset >= file->size)
+            return 0;
+
+        size_t count = std::min((size_t) length, file->size - offset);
+        for (size_t done = 0; done < count;) {
+            size_t position = offset + done;
+            size_t index = position / CHUNK_SIZE, within = position % CHUNK_SIZE;
+            size_t piece = std::min(count - done, CHUNK_SIZE - within);
+            if (index < file->chunks.size() && file->chunks[index])
+                memcpy(buffer + done, file->chunks[index] + within, piece);
+            else
+                memset(buffer + done, 0, piece);
+            done += piece;
+        }
+        return (ssize_t) count;
+    }
+
+    ssize_t TmpFS::write(size_t inum, const uint8_t *data, int length, size_t offset) {
+        Node *file = get(inum, true);
+        if (!file || length < 0)
+            return -1;
+
+        for (size_t done = 0; done < (size_t) length;) {
+            size_t position = offset + done;
+            size_t within = position % CHUNK_SIZE;
+            size_t piece = std::min((size_t) length - done, CHUNK_SIZE - within);
+            memcpy(chunk(file, position) + within, data + done, piece);
+            done += piece;
+        }
+        file->size = std::max(file->size, offset + length);
+        return length;
+    }
+
+    bool TmpFS::fallocate(size_t inum, size_t offset, size_t length, bool keep_size) {
+        Node *file = get(inum, true);
+        if (!file)
+            return false;
+
+        for (size_t position = offset / CHUNK_SIZE * CHUNK_SIZE; position < offset + length; position += CHUNK_SIZE)
+            chunk(file, position);
+        if (!keep_size)
+            file->size = std::max(file->size, offset + length);
+        return true;
+    }
+
+    ssize_t TmpFS::stat(size_t inum) {
+        Node *file = get(inum, true);
+        return file ? (ssize_t) file->size : -1;
+    }
+
+    bool TmpFS::stat(size_t inum, vfs::file_stat &st) {
+        Node *file = get(inum, true);
+        if (!file)
+            return false;
+
+        st.size = file->size;
+        st.blocks = 0;
+        for (auto data: file->chunks)
+            st.blocks += data != nullptr;
+        st.blockSize = CHUNK_SIZE;
+        return true;
+    }
+
+    bool TmpFS::ls(std::vector<vfs::file> &contents) {
+        contents.clear();
+        contents.emplace_back(".", false, current->inum);
+        contents.emplace_back("..", false, current->parent->inum);
+        for (Entry *entry = current->first; entry; entry = entry->next)
+            contents.emplace_back(std::string(entry->name), entry->node->isFile, entry->node->inum);
+        return true;
+    }
+
+    bool TmpFS::touch(const char *name) {
+        return create(name, true);
+    }
+
+    bool TmpFS::mkdir(const char name[]) {
+        return create(name, false);
+    }
+
+    bool TmpFS::rm(const char name[]) {
+        return remove(name, true);
+    }
+
+    bool TmpFS::rmdir(const char name[]) {
+        return remove(name, false);
+    }
+
+    bool TmpFS::cd(const char name[]) {
+        Node *node = walk(name);
+        if (!node || node->isFile)
+            return false;
+
+        current = node;
+        return true;
+    }
+
+    std::expected<size_t> TmpFS::getInode(const char *name) {
+        Node *node = walk(name);
+        if (!node)
+            return std::make_unexpected<size_t>(std::ERROR_NOT_EXISTS);
+        if (!node->isFile)
+            return std::make_unexpected<size_t>(std::ERROR_DIRECTORY);
+        return node->inum;
+    }
+
+    std::expected<size_t> TmpFS::openDir(const char *name) {
+        /// An empty name is the root of the mount
+        Node *node = name[0] ? walk(name) : root;
+        if (!node || node->isFile)
+            return std::make_unexpected<size_t>(std::ERROR_NOT_EXISTS);
+        return node->inum;
+    }
+
+    ssize_t TmpFS::readDir(size_t dir, size_t cookie, vfs::dir_entry *entries, size_t count) {
+        Node *node = get(dir, false);
+        if (!node)
+            return -1;
+
+        size_t filled = 0;
+        auto fill = [&](size_t inum, size_t next, bool isFile, std::string_view name) {
+            vfs::dir_entry &entry = entries[filled++];
+            entry.inum = inum;
+            entry.cookie = next;
+            entry.isFile = isFile;
+            size_t length = std::min(name.size(), vfs::DIRENT_NAME_MAX - 1);
+            memcpy(entry.name, name.data(), length);
+            entry.name[length] = '\0';
+        };
+
+        for (; cookie < FIRST_SERIAL && filled < count; cookie++) {
+            if (cookie == 0)
+                fill(node->inum, 1, false, CURRENT);
+            else
+                fill(node->parent->inum, FIRST_SERIAL, false, PARENT);
+        }
+
+        /// A listing read in several calls goes on from where the previous call stopped
+        Entry *entry = node->resume;
+        if (!entry || entry->serial < cookie || (entry->prev && entry->prev->serial >= cookie)) {
+            entry = node->first;
+            while (entry && entry->serial < cookie)
+                entry = entry->next;
+        }
+
+        for (; entry && filled < count; entry = entry->next)
+            fill(entry->node->inum, entry->serial + 1, entry->node->isFile, entry->name);
+        node->resume = entry;
+        return (ssize_t) filled;
+    }
+
+    std::string TmpFS::pwd() {
+        if (current == root)
+            return "/";
+
+        std::vector<const Entry *> components;
+        for (Node *node = current; node != root; node = node->parent)
+            components.push_back(node->entry);
+
+        std::string path;
+        for (size_t i = components.size(); i > 0; i--) {
+            path += components[i - 1]->name;
+            if (i > 1)
+                path += "/";
+        }
+        return path;
+    }
+
+    void TmpFS::test() {
+        Logger::instance().println("[TMPFS] Starting tests...");
+        size_t used = nodes.size() - freeInums.size();
+
+        kAssert(mkdir("tmpfs_test1") && touch("tmpfs_test1/file") && !touch("tmpfs_test1/file"),
+                "[TMPFS] Failed to create file");
+        auto inum = getInode("tmpfs_test1/file");
+        kAssert(inum && !getInode("tmpfs_test1"), "[TMPFS] Failed to look up file");
+
+        // A write past a hole, the hole reads as zeroes and takes no chunk
+        uint8_t data[16], buffer[16];
+        for (size_t i = 0; i < sizeof(data); i++)
+            data[i] = i + 1;
+        kAssert(write(*inum, data, sizeof(data), 3 * CHUNK_SIZE - 8) == sizeof(data), "[TMPFS] Write failed");
+        vfs::file_stat st;
+        kAssert(stat(*inum, st) && st.size == 3 * CHUNK_SIZE + 8 && st.blocks == 2, "[TMPFS] Wrong stat");
+        kAssert(read(*inum, buffer, sizeof(buffer), 3 * CHUNK_SIZE - 8) == sizeof(buffer) &&
+                std::equal(buffer, buffer + sizeof(buffer), data), "[TMPFS] Read back mismatch");
+        kAssert(read(*inum, buffer, sizeof(buffer), 0) == sizeof(buffer) &&
+                std::all_of(buffer, buffer + sizeof(buffer), [](uint8_t b) { return b == 0; }), "[TMPFS] Hole not zero");
+
+        // Enough files to grow the buckets a few times, half of them removed again
+        char name[] = "tmpfs_test1/f00";
+        constexpr const size_t FILES = 100;
+        for (size_t i = 0; i < FILES; i++) {
+            name[13] = (char) ('0' + i / 10);
+            name[14] = (char) ('0' + i % 10);
+            kAssert(touch(name), "[TMPFS] Failed to create file");
+        }
+        for (size_t i = 0; i < FILES; i += 2) {
+            name[13] = (char) ('0' + i / 10);
+            name[14] = (char) ('0' + i % 10);
+            kAssert(rm(name), "[TMPFS] Failed to remove file");
+        }
+        kAssert(cd("tmpfs_test1") && pwd() == "tmpfs_test1", "[TMPFS] Failed to change directory");
+        std::vector<vfs::file> contents;
+        kAssert(ls(contents) && contents.size() == 2 + 1 + FILES / 2 && getInode("f99") && !getInode("f98"),
+                "[TMPFS] Wrong directory contents");
+        kAssert(!touch("..") && !mkdir("."), "[TMPFS] . and .. are not names of new files");
+
+        // Removing the current directory moves out of it, everything inside is freed
+        kAssert(rmdir("../tmpfs_test1") && pwd() == "/" && !getInode("tmpfs_test1/file"),
+                "[TMPFS] Failed to remove directory");
+        kAssert(nodes.size() - freeInums.size() == used, "[TMPFS] Nodes were leaked");
+        Logger::instance().println("[TMPFS] Tests passed");
+    }
+}
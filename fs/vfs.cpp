@@ -9,12 +9,20 @@
 #include "arch/x86_64/exceptions.h"
 #include "arch/x86_64/logging.h"
 #include "fs/simple_fs.h"
+#include "fs/tmpfs.h"
+#include "fs/page_cache.h"
+#include "fs/mmap.h"
+#include "fs/mount_table.h"
+#include "std/cstring.h"
+#include "std/array.h"
 
 namespace {
     std::string partitionTypeToString(vfs::PartitionType type) {
         switch (type) {
             case vfs::PartitionType::SIMPLE_FS:
                 return "SimpleFS";
+            case vfs::PartitionType::TMPFS:
+                return "TmpFS";
             case vfs::PartitionType::UNKNOWN:
                 return "Unknown";
             default:
@@ -22,80 +30,165 @@ namespace {
         }
     }
 
-    std::vector<vfs::MountedFS> mount_point_list;
+    std::vector<vfs::MountedFS *> mount_point_list;
+    locking::SpinLock mount_lock; ///> Serializes mounts, lookups in the mount table don't take it
+    constinit vfs::MountTable mount_table;
+    vfs::MountedFS *current_mount{}; ///> The mount of the current directory, relative paths stay inside it
+
+    /// cd and mount change the current mount while other calls use it, it is only read and written atomically
+    vfs::MountedFS *currentMount() {
+        return __atomic_load_n(&current_mount, __ATOMIC_ACQUIRE);
+    }
+
+    void setCurrentMount(vfs::MountedFS *mount) {
+        __atomic_store_n(&current_mount, mount, __ATOMIC_RELEASE);
+    }
 
     void mountRoot(Disk *disk) {
         auto success = mount(vfs::PartitionType::SIMPLE_FS, "/", disk);
         kAssert(success, "Error mounting SIMPLE_FS");
     }
 
-    Path getPath(const char *file_path) {
-        Path p(file_path);
-        if (!p.is_valid())
-            return p;
+    /**
+     * @brief Finds the mount of a path and the path inside of it, without building a Path
+     * The file system gets the rest of the path after the mount point, SimpleFS looks it up in its current directory
+     * @param normalized Holds an absolute path with ".." components once they are resolved, keep it with the result
+     * @return a null mount if the path is empty or invalid
+     */
+    vfs::MountTable::Resolved getFs(const char *file_path, std::string &normalized) {
+        if (!file_path || !file_path[0] || std::string_view(file_path) == std::string_view("//"))
+            return {nullptr, nullptr};
+
+        if (file_path[0] != '/')
+            return {currentMount(), file_path};
+        return mount_table.resolve(file_path, normalized);
+    }
 
-        // kAssert(!p.is_relative(), "Can't support relative paths at the moment...");
-        return p;
+    /// The open file or directory behind a descriptor of the current process; nullptr if the descriptor is not open
+    handles::OpenFile *getOpen(vfs::fd_t fd) {
+        auto &table = handles::current();
+        return table.has(fd) ? &table.get(fd) : nullptr;
     }
 
-    vfs::MountedFS &getFs(const Path &base_path) {
-        size_t best = 0;
-        size_t best_match = 0;
+    /// Like getOpen, but only for files: the inode of a directory descriptor is a directory number, not a file
+    handles::OpenFile *getFile(vfs::fd_t fd) {
+        auto file = getOpen(fd);
+        return file && !(file->flags & vfs::OPEN_DIRECTORY) ? file : nullptr;
+    }
 
-        if (base_path.is_root()) {
-            for (auto &mp: mount_point_list) {
-                if (mp.mount_point.is_root()) {
-                    kAssert(mp.fs_type == vfs::PartitionType::SIMPLE_FS,
-                            "[VFS] Only SimpleFS is supported at the moment!");
-                    return mp;
-                }
-            }
+    vfs::FileSystem *getNewFs(vfs::PartitionType type, Disk *disk, size_t flags) {
+        switch (type) {
+            case vfs::PartitionType::SIMPLE_FS:
+                return new simple_fs::SimpleFS(disk, flags & vfs::MOUNT_COMPRESS);
+            case vfs::PartitionType::TMPFS:
+                return new tmpfs::TmpFS();
+            default:
+                kPanic("Unknown FS type");
+                return nullptr;
         }
+    }
 
-        for (size_t i = 0; i < mount_point_list.size(); ++i) {
-            auto &mp = mount_point_list[i];
+    /**
+     * @brief Inodes share a fixed set of locks, picked by a hash of the file system and the inode
+     * Reads of the same file run together, writes exclude everything else on the file. Two inodes may share a lock,
+     * that only costs some concurrency.
+     */
+    std::array<locking::RwLock, 64> inode_locks;
 
-            bool match = true;
-            for (size_t j = 0; j < mp.mount_point.size() && j < base_path.size(); ++j) {
-                if (mp.mount_point[j] != base_path[j]) {
-                    match = false;
-                    break;
-                }
-            }
+    locking::RwLock &inodeLock(const handles::OpenFile *file) {
+        size_t key = reinterpret_cast<size_t>(file->file_system) ^ file->inode;
+        return inode_locks[(key * 0x9E3779B97F4A7C15ULL) >> 58];
+    }
 
-            if (match && mp.mount_point.size() > best) {
-                best = mp.mount_point.size();
-                best_match = i;
-            }
-        }
+    /// pread with the inode already locked
+    std::expected<size_t> readAt(handles::OpenFile *file, uint8_t *buffer, size_t count, size_t offset) {
+        ssize_t result = vfs::PageCache::instance().read(file->file_system, file->inode, buffer, count, offset);
 
-        kAssert(mount_point_list[best].fs_type == vfs::PartitionType::SIMPLE_FS,
-                "[VFS] Only SimpleFS is supported at the moment!");
-        return mount_point_list[best_match];
+        if (result < 0) {
+            Logger::instance().println("[VFS] Error read, result is %X", result);
+            return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
+        }
+        return result;
     }
 
-    vfs::FileSystem *getNewFs(vfs::PartitionType type, Disk *disk) {
-        switch (type) {
-            case vfs::PartitionType::SIMPLE_FS:
-                return new simple_fs::SimpleFS(disk);
-            default:
-                kPanic("Unknown FS type");
-                return nullptr;
+    /// pwrite with the inode already locked exclusively
+    std::expected<size_t> writeAt(handles::OpenFile *file, const uint8_t *buffer, size_t count, size_t offset) {
+        ssize_t result = vfs::PageCache::instance().write(file->file_system, file->inode, buffer, count, offset);
+
+        if (result < 0) {
+            Logger::instance().println("[VFS] Error write, result is %X", result);
+            return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
         }
+
+        return result;
     }
 
+    /// copy_range once the inodes are locked
+    std::expected<size_t> copyLocked(handles::OpenFile *src, size_t src_offset, handles::OpenFile *dst,
+                                     size_t dst_offset, size_t length) {
+        bool same_fs = src->file_system == dst->file_system;
+        auto &cache = vfs::PageCache::instance();
+        if (same_fs && !cache.mapped(dst->file_system, dst->inode)) {
+            /// The file system copies what is on disk, so both files are written back and the cached destination is dropped
+            cache.sync(src->file_system, src->inode);
+            cache.sync(dst->file_system, dst->inode);
+            auto fs = dst->file_system;
+            ssize_t copied = fs->exclusive([&] {
+                return fs->copyRange(src->inode, src_offset, dst->inode, dst_offset, length);
+            });
+            if (copied >= 0) {
+                cache.invalidate(dst->file_system, dst->inode);
+                return copied;
+            }
+        }
+
+        /// Anything else is copied through the page cache, a page at a time
+        auto *buffer = new uint8_t[vfs::PageCache::PAGE_SIZE];
+        size_t copied = 0;
+        bool failed = false;
+        while (copied < length) {
+            size_t chunk = std::min(vfs::PageCache::PAGE_SIZE, length - copied);
+            ssize_t read = cache.read(src->file_system, src->inode, buffer, chunk, src_offset + copied);
+            if (read <= 0) {
+                failed = read < 0;
+                break;
+            }
+
+            ssize_t written = cache.write(dst->file_system, dst->inode, buffer, read, dst_offset + copied);
+            if (written < 0) {
+                failed = true;
+                break;
+            }
+            copied += written;
+            if (written < read)
+                break;
+        }
+        delete[] buffer;
+
+        if (failed && !copied) {
+            Logger::instance().println("[VFS] Error copy_range");
+            return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
+        }
+        return copied;
+    }
 }
 
-std::expected<void> vfs::mount(PartitionType type, const char *mount_point, Disk *disk) {
+std::expected<void> vfs::mount(PartitionType type, const char *mount_point, Disk *disk, size_t flags) {
     Path mpPath(mount_point);
 
-    auto fs = getNewFs(type, disk);
+    auto fs = getNewFs(type, disk, flags);
 
     if (!fs) {
         return std::make_unexpected<void>(std::ERROR_INVALID_FILE_SYSTEM);
     }
 
-    mount_point_list.emplace_back(type, mpPath, fs);
+    fs->mount();
+    auto mp = new MountedFS(type, mpPath, fs);
+    locking::Guard<locking::SpinLock> guard(mount_lock);
+    mount_point_list.push_back(mp);
+    mount_table.add(mpPath.string(), mp);
+    if (!currentMount() || mpPath.is_root())
+        setCurrentMount(mp);
 
     Logger::instance().println("[VFS] Mounted file system at %s", mpPath.string());
 
@@ -104,50 +197,103 @@ std::expected<void> vfs::mount(PartitionType type, const char *mount_point, Disk
 
 void vfs::init(Disk *disk) {
     mountRoot(disk);
-
-    // Mount and test all file systems
-    for (auto &mp: mount_point_list) {
-        mp.file_system->mount();
-        // mp.file_system->test();
-    }
+    /// Scratch and lock files don't have to go through the disk
+    auto tmp = mount(PartitionType::TMPFS, "/tmp", nullptr);
+    kAssert(tmp, "Error mounting TMPFS");
+    initMmap();
 }
 
 std::expected<vfs::fd_t> vfs::open(const char *filePath, size_t flags) {
-    const auto base_path = getPath(filePath);
+    std::string normalized;
+    auto [mp, path] = getFs(filePath, normalized);
 
-    if (!base_path.is_valid()) {
+    if (!mp || (!path[0] && !(flags & OPEN_DIRECTORY))) {
         return std::make_unexpected<fd_t>(std::ERROR_INVALID_FILE_PATH);
     }
 
-    auto &fs = getFs(base_path);
+    auto fs = mp->file_system;
+    if (flags & OPEN_DIRECTORY) {
+        if (flags & (OPEN_CREATE | OPEN_COMPRESSED | OPEN_APPEND))
+            return std::make_unexpected<fd_t>(std::ERROR_INVALID_REQUEST);
+
+        auto dir = fs->shared([&] { return fs->openDir(path); });
+        if (!dir)
+            return std::make_unexpected<fd_t>(dir.error());
+
+        ssize_t fd = handles::current().allocate({fs, dir.value(), 0, flags});
+        if (fd == -1)
+            return std::make_unexpected<vfs::fd_t>(std::ERROR_TOO_MANY_FILES);
+        return (fd_t) fd;
+    }
+
     // Touch in case it does not exist
     if (flags & OPEN_CREATE)
-        fs.file_system->touch(filePath);
-
-    auto inodeExpected = fs.file_system->getInode(filePath);
+        fs->exclusive([&] { return fs->touch(path); });
+
+    auto inodeExpected = fs->shared([&] { return fs->getInode(path); });
+
+    if (inodeExpected) {
+        if (flags & OPEN_COMPRESSED) {
+            /// The file system changes how the data is stored, so the cache starts over
+            auto &cache = PageCache::instance();
+            if (cache.mapped(fs, inodeExpected.value()))
+                return std::make_unexpected<vfs::fd_t>(std::ERROR_BUSY);
+            cache.sync(fs, inodeExpected.value());
+            cache.invalidate(fs, inodeExpected.value());
+            if (!fs->exclusive([&] { return fs->setCompressed(inodeExpected.value(), true); }))
+                return std::make_unexpected<vfs::fd_t>(std::ERROR_UNSUPPORTED);
+        }
 
-    if (inodeExpected)
-        return handles::register_new_handle(inodeExpected.value());
+        ssize_t fd = handles::current().allocate({fs, inodeExpected.value(), 0, flags});
+        if (fd == -1)
+            return std::make_unexpected<vfs::fd_t>(std::ERROR_TOO_MANY_FILES);
+        return (fd_t) fd;
+    }
 
     return std::make_unexpected<vfs::fd_t>(std::ERROR_UNKNOWN);
 }
 
 void vfs::close(fd_t fd) {
-    if (handles::has_handle(fd)) {
-        handles::release_handle(fd);
+    /// Data written through a descriptor reaches the disk at the latest when it is closed
+    auto file = getFile(fd);
+    if (file && !PageCache::instance().sync(file->file_system, file->inode))
+        Logger::instance().println("[VFS] Error writing back fd %X on close", fd);
+
+    handles::current().release(fd);
+}
+
+std::expected<void> vfs::sync(fd_t fd) {
+    auto file = getFile(fd);
+    if (!file) {
+        return std::make_unexpected<void>(std::ERROR_INVALID_FILE_DESCRIPTOR);
     }
+
+    if (PageCache::instance().sync(file->file_system, file->inode))
+        return std::make_expected();
+
+    Logger::instance().println("[VFS] Error calling sync");
+    return std::make_unexpected<void>(std::ERROR_FAILED);
+}
+
+std::expected<void> vfs::sync() {
+    if (PageCache::instance().sync())
+        return std::make_expected();
+
+    Logger::instance().println("[VFS] Error calling sync");
+    return std::make_unexpected<void>(std::ERROR_FAILED);
 }
 
 std::expected<void> vfs::mkdir(const char *file_path) {
-    auto base_path = getPath(file_path);
+    std::string normalized;
+    auto [mp, path] = getFs(file_path, normalized);
 
-    if (!base_path.is_valid()) {
+    if (!mp || !path[0]) {
         return std::make_unexpected<void>(std::ERROR_INVALID_FILE_PATH);
     }
 
-    auto &fs = getFs(base_path);
+    auto fs = mp->file_system;
 
-    bool success = fs.file_system->mkdir(file_path);
+    bool success = fs->exclusive([&] { return fs->mkdir(path); });
     if (success)
         return std::make_expected();
 
@@ -156,15 +302,24 @@ std::expected<void> vfs::mkdir(const char *file_path) {
 }
 
 std::expected<void> vfs::rm(const char *file_path) {
-    auto base_path = getPath(file_path);
+    std::string normalized;
+    auto [mp, path] = getFs(file_path, normalized);
 
-    if (!base_path.is_valid()) {
+    if (!mp || !path[0]) {
         return std::make_unexpected<void>(std::ERROR_INVALID_FILE_PATH);
     }
 
-    auto &fs = getFs(base_path);
+    auto fs = mp->file_system;
+
+    /// Cached pages of the file, dirty or not, are dropped with it
+    auto inode = fs->shared([&] { return fs->getInode(path); });
+    if (inode) {
+        if (PageCache::instance().mapped(fs, inode.value()))
+            return std::make_unexpected<void>(std::ERROR_BUSY);
+        PageCache::instance().invalidate(fs, inode.value());
+    }
 
-    bool success = fs.file_system->rm(file_path);
+    bool success = fs->exclusive([&] { return fs->rm(path); });
     if (success)
         return std::make_expected();
 
@@ -173,15 +328,23 @@ std::expected<void> vfs::rm(const char *file_path) {
 }
 
 std::expected<void> vfs::rmDir(const char *file_path) {
-    auto base_path = getPath(file_path);
+    std::string normalized;
+    auto [mp, path] = getFs(file_path, normalized);
 
-    if (!base_path.is_valid()) {
+    if (!mp || !path[0]) {
         return std::make_unexpected<void>(std::ERROR_INVALID_FILE_PATH);
     }
 
-    auto &fs = getFs(base_path);
+    auto fs = mp->file_system;
 
-    bool success = fs.file_system->rmdir(file_path);
+    /// The files inside are removed too, the cache does not know which ones they are
+    auto &cache = PageCache::instance();
+    if (cache.mapped(fs))
+        return std::make_unexpected<void>(std::ERROR_BUSY);
+    cache.sync(fs);
+    cache.invalidate(fs);
+
+    bool success = fs->exclusive([&] { return fs->rmdir(path); });
     if (success)
         return std::make_expected();
 
@@ -190,32 +353,28 @@ std::expected<void> vfs::rmDir(const char *file_path) {
 }
 
 std::expected<void> vfs::cd(const char *dir) {
-    auto base_path = getPath(dir);
+    std::string normalized;
+    auto [mp, path] = getFs(dir, normalized);
 
-    if (!base_path.is_valid()) {
+    if (!mp) {
         return std::make_unexpected<void>(std::ERROR_INVALID_FILE_PATH);
     }
 
-    auto &fs = getFs(base_path);
-
-    bool success = fs.file_system->cd(dir);
-    if (success)
+    /// The root of a mount switches to its file system, in the directory it was left in
+    auto fs = mp->file_system;
+    bool success = !path[0] || fs->exclusive([&] { return fs->cd(path); });
+    if (success) {
+        setCurrentMount(mp);
         return std::make_expected();
+    }
 
     Logger::instance().println("[VFS] Error changing dir");
     return std::make_unexpected<void>(std::ERROR_UNKNOWN);
 }
 
 std::expected<void> vfs::ls(std::vector<file> &contents) {
-    Path base_path{"/"};
-
-    if (!base_path.is_valid()) {
-        return std::make_unexpected<void>(std::ERROR_INVALID_FILE_PATH);
-    }
-
-    auto &fs = getFs(base_path);
-
-    bool success = fs.file_system->ls(contents);
+    auto fs = currentMount()->file_system;
+    bool success = fs->shared([&] { return fs->ls(contents); });
     if (success)
         return std::make_expected();
 
@@ -223,16 +382,55 @@ std::expected<void> vfs::ls(std::vector<file> &contents) {
     return std::make_unexpected<void>(std::ERROR_UNKNOWN);
 }
 
-std::expected<ssize_t> vfs::stat(fd_t fd) {
-    Path base_path{"/"};
+std::expected<size_t> vfs::getdents(fd_t fd, uint8_t *buffer, size_t length) {
+    auto dir = getOpen(fd);
+    if (!dir) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
+    if (!(dir->flags & OPEN_DIRECTORY)) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_REQUEST);
+    }
+
+    constexpr const size_t BATCH = 8;
+    dir_entry entries[BATCH];
+    size_t used = 0;
+    while (true) {
+        auto fs = dir->file_system;
+        ssize_t filled = fs->shared([&] { return fs->readDir(dir->inode, dir->offset, entries, BATCH); });
+        if (filled < 0) {
+            /// The directory was removed while it was open
+            return std::make_unexpected<size_t>(std::ERROR_NOT_EXISTS);
+        }
 
-    if (!base_path.is_valid()) {
-        return std::make_unexpected<ssize_t>(std::ERROR_INVALID_FILE_PATH);
+        for (ssize_t i = 0; i < filled; i++) {
+            size_t nameLength = strlen(entries[i].name);
+            size_t size = direntRecordSize(nameLength);
+            if (used + size > length) {
+                if (!used)
+                    return std::make_unexpected<size_t>(std::ERROR_BUFFER_SMALL);
+                return used;
+            }
+
+            auto *record = reinterpret_cast<dirent_record *>(buffer + used);
+            *record = {entries[i].inum, entries[i].cookie, (uint16_t) size, (uint16_t) nameLength,
+                       entries[i].isFile, {}};
+            memcpy(buffer + used + sizeof(dirent_record), entries[i].name, nameLength + 1);
+            used += size;
+            dir->offset = entries[i].cookie;
+        }
+
+        if ((size_t) filled < BATCH)
+            return used;
     }
+}
 
-    auto &fs = getFs(base_path);
+std::expected<ssize_t> vfs::stat(fd_t fd) {
+    auto file = getFile(fd);
+    if (!file) {
+        return std::make_unexpected<ssize_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
 
-    ssize_t success = fs.file_system->stat(handles::get_handle(fd));
+    ssize_t success = PageCache::instance().size(file->file_system, file->inode);
     if (success != -1)
         return success;
 
@@ -240,49 +438,286 @@ std::expected<ssize_t> vfs::stat(fd_t fd) {
     return std::make_unexpected<ssize_t>(std::ERROR_UNKNOWN);
 }
 
+std::expected<void> vfs::stat(fd_t fd, file_stat &st) {
+    auto file = getFile(fd);
+    if (!file) {
+        return std::make_unexpected<void>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
+
+    /// Blocks are only allocated once the data is written back
+    locking::SharedGuard guard(inodeLock(file));
+    PageCache::instance().sync(file->file_system, file->inode);
+
+    auto fs = file->file_system;
+    bool success = fs->shared([&] { return fs->stat(file->inode, st); });
+    if (success)
+        return std::make_expected();
+
+    Logger::instance().println("[VFS] Error calling stat");
+    return std::make_unexpected<void>(std::ERROR_UNKNOWN);
+}
+
+std::expected<void> vfs::fallocate(fd_t fd, size_t offset, size_t length, size_t flags) {
+    auto file = getFile(fd);
+    if (!file) {
+        return std::make_unexpected<void>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
+
+    /// The size may change behind the cache, so it starts over from what is on disk
+    locking::Guard<locking::RwLock> guard(inodeLock(file));
+    auto &cache = PageCache::instance();
+    if (cache.mapped(file->file_system, file->inode))
+        return std::make_unexpected<void>(std::ERROR_BUSY);
+    cache.sync(file->file_system, file->inode);
+    cache.invalidate(file->file_system, file->inode);
+
+    auto fs = file->file_system;
+    bool success = fs->exclusive([&] {
+        return fs->fallocate(file->inode, offset, length, flags & FALLOCATE_KEEP_SIZE);
+    });
+    if (success)
+        return std::make_expected();
+
+    Logger::instance().println("[VFS] Error calling fallocate");
+    return std::make_unexpected<void>(std::ERROR_UNKNOWN);
+}
+
+std::expected<void> vfs::fragmentation(const char *file_path, frag_stat &st) {
+    std::string normalized;
+    auto [mp, path] = getFs(file_path ? file_path : "/", normalized);
+    if (!mp) {
+        return std::make_unexpected<void>(std::ERROR_INVALID_FILE_PATH);
+    }
+    auto fs = mp->file_system;
+
+    bool success;
+    if (file_path) {
+        auto inode = fs->shared([&] { return fs->getInode(path); });
+        if (!inode)
+            return std::make_unexpected<void>(std::ERROR_NOT_EXISTS);
+        PageCache::instance().sync(fs, inode.value());
+        success = fs->exclusive([&] { return fs->fragmentation(inode.value(), st); });
+    } else {
+        PageCache::instance().sync(fs);
+        success = fs->exclusive([&] { return fs->fragmentation(st); });
+    }
+
+    if (success)
+        return std::make_expected();
+
+    Logger::instance().println("[VFS] Error computing fragmentation");
+    return std::make_unexpected<void>(std::ERROR_UNKNOWN);
+}
+
+std::expected<void> vfs::defrag(const char *file_path) {
+    std::string normalized;
+    auto [mp, path] = getFs(file_path ? file_path : "/", normalized);
+    if (!mp) {
+        return std::make_unexpected<void>(std::ERROR_INVALID_FILE_PATH);
+    }
+    auto fs = mp->file_system;
+
+    bool success;
+    if (file_path) {
+        auto inode = fs->shared([&] { return fs->getInode(path); });
+        if (!inode)
+            return std::make_unexpected<void>(std::ERROR_NOT_EXISTS);
+        PageCache::instance().sync(fs, inode.value());
+        success = fs->exclusive([&] { return fs->defrag(inode.value()); });
+    } else {
+        PageCache::instance().sync(fs);
+        success = fs->exclusive([&] { return fs->defrag(); });
+    }
+
+    if (success)
+        return std::make_expected();
+
+    Logger::instance().println("[VFS] Error defragmenting");
+    return std::make_unexpected<void>(std::ERROR_DISK_FULL);
+}
+
 std::string vfs::pwd() {
-    auto &fs = getFs(Path{"/"});
+    /// The file system only knows the directory inside of it
+    auto mount = currentMount();
+    auto fs = mount->file_system;
+    auto path = fs->shared([&] { return fs->pwd(); });
+    if (mount->mount_point.is_root())
+        return path;
+
+    /// The mount point may end with a separator and the directory may start with one, only one is kept
+    auto mountPoint = mount->mount_point.string();
+    while (mountPoint.size() > 1 && mountPoint[mountPoint.size() - 1] == '/')
+        mountPoint = mountPoint.substr(0, mountPoint.size() - 1);
+
+    std::string result(mountPoint.begin(), mountPoint.end());
+    if (path != "/") {
+        if (path[0] != '/')
+            result += '/';
+        result += path;
+    }
+    return result;
+}
 
-    return fs.file_system->pwd();
+std::expected<size_t> vfs::pread(fd_t fd, uint8_t *buffer, size_t count, size_t offset) {
+    auto file = getFile(fd);
+    if (!file) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
+
+    locking::SharedGuard guard(inodeLock(file));
+    return readAt(file, buffer, count, offset);
 }
 
-std::expected<size_t> vfs::read(fd_t fd, uint8_t *buffer, size_t count, size_t offset) {
-    if (!handles::has_handle(fd)) {
+std::expected<size_t> vfs::pwrite(fd_t fd, const uint8_t *buffer, size_t count, size_t offset) {
+    auto file = getFile(fd);
+    if (!file) {
         return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
     }
 
-    fd_t inode = handles::get_handle(fd);
+    locking::Guard<locking::RwLock> guard(inodeLock(file));
+    return writeAt(file, buffer, count, offset);
+}
 
-    auto &fs = getFs(Path{"/"});
+std::expected<size_t> vfs::read(fd_t fd, uint8_t *buffer, size_t count) {
+    auto file = getFile(fd);
+    if (!file) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
 
-    ssize_t result = fs.file_system->read(inode, buffer, count, offset);
+    /// Exclusive, the offset of the descriptor moves
+    locking::Guard<locking::RwLock> guard(inodeLock(file));
+    auto result = readAt(file, buffer, count, file->offset);
+    if (result)
+        file->offset += result.value();
+    return result;
+}
 
-    if (result < 0) {
-        Logger::instance().println("[VFS] Error read, result is %X", result);
-        return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
+std::expected<size_t> vfs::write(fd_t fd, const uint8_t *buffer, size_t count) {
+    auto file = getFile(fd);
+    if (!file) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
     }
-    if (result != count) {
-        Logger::instance().println("[VFS] Error read 2, result is %X", result);
-        return std::make_unexpected<size_t>((size_t) result);
+
+    locking::Guard<locking::RwLock> guard(inodeLock(file));
+    if (file->flags & OPEN_APPEND) {
+        ssize_t size = PageCache::instance().size(file->file_system, file->inode);
+        if (size < 0)
+            return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
+        file->offset = size;
     }
+
+    auto result = writeAt(file, buffer, count, file->offset);
+    if (result)
+        file->offset += result.value();
     return result;
 }
 
-std::expected<size_t> vfs::write(fd_t fd, const uint8_t *buffer, size_t count, size_t offset) {
-    if (!handles::has_handle(fd)) {
+std::expected<size_t> vfs::readv(fd_t fd, const io_vec *vec, size_t count) {
+    auto file = getFile(fd);
+    if (!file) {
         return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
     }
+    if (count > IOV_MAX) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_COUNT);
+    }
 
-    fd_t inode = handles::get_handle(fd);
+    locking::Guard<locking::RwLock> guard(inodeLock(file));
+    ssize_t result = PageCache::instance().readv(file->file_system, file->inode, vec, count, file->offset);
+
+    if (result < 0) {
+        Logger::instance().println("[VFS] Error readv, result is %X", result);
+        return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
+    }
+
+    file->offset += result;
+    return result;
+}
+
+std::expected<size_t> vfs::writev(fd_t fd, const io_vec *vec, size_t count) {
+    auto file = getFile(fd);
+    if (!file) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
+    if (count > IOV_MAX) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_COUNT);
+    }
 
-    auto &fs = getFs(Path("/"));
+    locking::Guard<locking::RwLock> guard(inodeLock(file));
+    auto &cache = PageCache::instance();
+    if (file->flags & OPEN_APPEND) {
+        ssize_t size = cache.size(file->file_system, file->inode);
+        if (size < 0)
+            return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
+        file->offset = size;
+    }
 
-    ssize_t result = fs.file_system->write(inode, buffer, count, offset);
+    ssize_t result = cache.writev(file->file_system, file->inode, vec, count, file->offset);
 
     if (result < 0) {
-        Logger::instance().println("[VFS] Error write, result is %X", result);
+        Logger::instance().println("[VFS] Error writev, result is %X", result);
         return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
     }
 
+    file->offset += result;
+    return result;
+}
+
+std::expected<size_t> vfs::copy_range(fd_t src_fd, size_t src_offset, fd_t dst_fd, size_t dst_offset,
+                                      size_t length) {
+    auto src = getFile(src_fd), dst = getFile(dst_fd);
+    if (!src || !dst) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
+
+    bool same_fs = src->file_system == dst->file_system;
+    if (same_fs && src->inode == dst->inode && src_offset < dst_offset + length && dst_offset < src_offset + length) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_REQUEST);
+    }
+
+    /// The source is read and the destination written, both locks are taken in address order
+    auto &srcLock = inodeLock(src), &dstLock = inodeLock(dst);
+    if (&srcLock != &dstLock && &srcLock < &dstLock)
+        srcLock.lockShared();
+    dstLock.lock();
+    if (&srcLock != &dstLock && &srcLock > &dstLock)
+        srcLock.lockShared();
+    auto result = copyLocked(src, src_offset, dst, dst_offset, length);
+    if (&srcLock != &dstLock)
+        srcLock.unlockShared();
+    dstLock.unlock();
     return result;
-}
\ No newline at end of file
+}
+
+std::expected<size_t> vfs::seek(fd_t fd, ssize_t offset, size_t whence) {
+    /// The offset of a directory is its getdents cookie, it can be saved and restored but has no end
+    auto file = getOpen(fd);
+    if (!file) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_FILE_DESCRIPTOR);
+    }
+
+    ssize_t base;
+    switch (whence) {
+        case SEEK_SET:
+            base = 0;
+            break;
+        case SEEK_CUR:
+            base = (ssize_t) file->offset;
+            break;
+        case SEEK_END:
+            if (file->flags & OPEN_DIRECTORY)
+                return std::make_unexpected<size_t>(std::ERROR_DIRECTORY);
+            base = PageCache::instance().size(file->file_system, file->inode);
+            if (base < 0)
+                return std::make_unexpected<size_t>(std::ERROR_UNKNOWN);
+            break;
+        default:
+            return std::make_unexpected<size_t>(std::ERROR_INVALID_REQUEST);
+    }
+
+    if (base + offset < 0) {
+        return std::make_unexpected<size_t>(std::ERROR_INVALID_OFFSET);
+    }
+
+    file->offset = base + offset;
+    return file->offset;
+}
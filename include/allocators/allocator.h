@@ -107,21 +107,26 @@ namespace physical_allocator {
          *
          * @param memBase The first address of physical memory
          * @param memSize The size of the memory starting at memBase
+         * @param mapped Where memBase is already mapped, for an allocator over a part of memory; nullptr maps the
+         * pages at PHYSICAL_ALLOCATOR_VIRTUAL_START
          */
-        Allocator(size_t memBase, size_t memSize) :
+        Allocator(size_t memBase, size_t memSize, void *mapped = nullptr) :
                 initialMemBase_{memBase}, initialMemSize_{memSize},
                 memBase{memBase}, memSize{memSize},
-                allocatorMemory{reinterpret_cast<void *>(paging::PHYSICAL_ALLOCATOR_VIRTUAL_START)},
+                allocatorMemory{mapped ? mapped
+                                       : reinterpret_cast<void *>(paging::PHYSICAL_ALLOCATOR_VIRTUAL_START)},
                 cntAllocatorPages{Derived::neededMemoryPages(initialMemSize_)} {
             Logger::instance().println("[P_ALLOCATOR] Initializing Allocator...");
 
-            VirtualAddress virtualAddressStart = paging::PHYSICAL_ALLOCATOR_VIRTUAL_START;
-            Logger::instance().println("[P_ALLOCATOR] Mapping allocator, physical %X at virtual %X...",
-                                       this->memBase, virtualAddressStart);
+            if (!mapped) {
+                VirtualAddress virtualAddressStart = paging::PHYSICAL_ALLOCATOR_VIRTUAL_START;
+                Logger::instance().println("[P_ALLOCATOR] Mapping allocator, physical %X at virtual %X...",
+                                           this->memBase, virtualAddressStart);
 
-            paging::mapPages(virtualAddressStart, this->memBase, cntAllocatorPages);
+                paging::mapPages(virtualAddressStart, this->memBase, cntAllocatorPages);
 
-            Logger::instance().println("[P_ALLOCATOR] Allocator mapped successfully");
+                Logger::instance().println("[P_ALLOCATOR] Allocator mapped successfully");
+            }
 
             this->memBase += cntAllocatorPages * PAGE_SIZE;
             this->memSize -= cntAllocatorPages * PAGE_SIZE;
@@ -21,6 +21,7 @@ namespace physical_allocator {
     private:
         bool *isFree_;
         size_t cntPages_;
+        size_t cntFree_;
     public:
         BitmapAllocator(size_t memBase, size_t memSize);
 
@@ -38,6 +39,13 @@ namespace physical_allocator {
          */
         void freeImplementation(size_t base, size_t cntPages);
 
+        [[nodiscard]] size_t freePages() const {
+            return cntFree_;
+        }
+
+        /// The most pages one allocation can get right now; for tests, the bitmap allocators walk every page
+        [[nodiscard]] size_t largestFreeBlock() const;
+
         /*!
          * @return The number of pages of memory that should be mapped for the allocator
          */
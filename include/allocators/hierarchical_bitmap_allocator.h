@@ -0,0 +1,93 @@
+/*
+ * hierarchical_bitmap_allocator.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "allocator.h"
+
+namespace physical_allocator {
+    /*!
+     * A bitmap allocator that doesn't walk the pages one by one
+     *
+     * Level 0 keeps one bit for each page frame, packed in 64-bit words, a set bit is an allocated page.
+     * Every level above keeps one bit for each word of the level below, set when that word is full, up to a
+     * level of a single word. A free page is found by going down from the top word with a count trailing zeros
+     * at each level, so it takes the same time however full memory is.
+     *
+     * Consecutive pages are found by walking the words of level 0, skipping the words (and the groups of 64
+     * words) that level 1 marks as full. For each order a hint caches where the walk can start:
+     * no free run of at least 2^order pages starts before it.
+     */
+    class HierarchicalBitmapAllocator : public Allocator<HierarchicalBitmapAllocator> {
+    private:
+        static constexpr const size_t BITS = 64;
+        static constexpr const size_t FULL = ~0ULL;
+        /// 64^6 pages are 256 TiB of memory
+        static constexpr const size_t MAX_LEVELS = 6;
+        static constexpr const size_t ORDERS = 64;
+
+        uint64_t *bits_[MAX_LEVELS]{};
+        size_t words_[MAX_LEVELS]{}; ///> Words of each level
+        size_t levels_;
+        size_t cntPages_;
+        size_t cntFree_;
+        size_t hints_[ORDERS]{}; ///> A page index for each order, 0 is not used as it goes through the levels
+
+        static constexpr uint64_t bit(size_t index) {
+            return 1ULL << (index % BITS);
+        }
+
+        /// The page index of a free page
+        size_t findPage();
+
+        /// The page index of the first of cntPages free pages
+        size_t findRun(size_t cntPages);
+
+        /// Marks pages as allocated or free, they have to be in the other state
+        void markRange(size_t first, size_t cntPages, bool used);
+
+        /// Propagates the full state of a word of level 0 to the levels above
+        void updateSummary(size_t index);
+
+    public:
+        /// With mapped, the allocator keeps its bitmap in memory that is already mapped there, see Allocator
+        HierarchicalBitmapAllocator(size_t memBase, size_t memSize, void *mapped = nullptr);
+
+        /*!
+         * Allocated cntPages pages, consecutive in physical memory
+         * @param cntPages The number of cntPages to allocate
+         * @return The physical address of the first page
+         */
+        size_t allocateImplementation(size_t cntPages);
+
+        /*!
+         * Free cntPages, starting from base
+         * @param base The address of the first page to free
+         * @param cntPages The number of pages to free
+         */
+        void freeImplementation(size_t base, size_t cntPages);
+
+        [[nodiscard]] size_t freePages() const {
+            return cntFree_;
+        }
+
+        /// The most pages one allocation can get right now; for tests, the bitmap allocators walk every page
+        [[nodiscard]] size_t largestFreeBlock() const;
+
+        /*!
+         * @return The number of pages of memory that should be mapped for the allocator
+         */
+        [[nodiscard]] constexpr static size_t neededMemoryPages(size_t memSize) {
+            size_t words = (memSize / PAGE_SIZE + BITS - 1) / BITS;
+            size_t total = words;
+            while (words > 1) {
+                words = (words + BITS - 1) / BITS;
+                total += words;
+            }
+            return toPages(total * sizeof(uint64_t));
+        }
+    };
+}
@@ -11,15 +11,34 @@
 #include "arch/x86_64/paging_constants.h"
 
 namespace kalloc {
-    struct MmapedRegion {
-        void *ptr = nullptr; /// The virtual address of the mmaped region
-        size_t cntPages = 0; /// The number of pages of the region, 0 if free
+    class Tlsf;
 
-        [[nodiscard]] bool isEmpty() const {
-            return ptr == nullptr && cntPages == 0;
+    enum class Owner : uint8_t {
+        NONE = 0, ///< Not allocated by kAlloc
+        SLAB = 1,
+        HEAP = 2, ///< A chunk of the TLSF heap
+        MMAPED = 3, ///< Data is the number of pages, only set on the first page of the region
+    };
+
+    /**
+     * @brief What a page of the kernel heap belongs to, one word per page
+     * Every page vAlloc can return has one, so kFree finds the owner of a pointer with an index.
+     */
+    struct PageOwner {
+        uint64_t owner: 2;
+        uint64_t data: 62;
+
+        [[nodiscard]] Owner kind() const {
+            return static_cast<Owner>(owner);
         }
     };
 
+    /// Records the owner of pages given out by the VirtualAllocator
+    void setOwner(void *start, size_t pages, Owner owner, size_t data = 0);
+
+    /// The owner of the page holding ptr, NONE outside of the kernel heap
+    PageOwner ownerOf(const void *ptr);
+
     /*!
      * Allocates consecutive virtual pages for big allocations
      * @param size The size of the memory to be allocated with whole pages
@@ -27,37 +46,26 @@ namespace kalloc {
      */
     void *allocMmaped(size_t size);
 
-    struct MemoryChunk {
-        MemoryChunk *next, *prev;
-        bool allocated;
-        size_t size;
-    };
-
-    struct Arena {
-        MemoryChunk *first;
-        size_t totalSize;
-
-        Arena(void *start, size_t size);
-
-        [[nodiscard]] void *malloc(size_t size) const;
-
-        void free(void *ptr);
-    };
-
     void init();
 
+    /// The TLSF heap behind the sizes between the slab classes and whole pages
+    const Tlsf &generalHeap();
+
     /*!
      * A basic form of malloc that allocates memory for the kernel
      * If size if bigger than a certain threshold, we mmap
-     * Otherwise, we have a buddy allocator that allocated within the same page
+     * Sizes up to SLAB_MAX_OBJECT come from slabs of their size class, the rest from the TLSF heap
      * 16 bytes minimum,
+     * Not for interrupt handlers: the magazines of a CPU take no lock and the heap and page allocators take spin
+     * locks, an interrupt that allocates could find either half updated or deadlock on the lock. Faults raised by
+     * the running code are fine, they don't interrupt the allocator.
      * @param size The size of the chunk to be allocated
      * @return A pointer to the allocated memory chunk
      */
     void *kAlloc(size_t size);
 
     /*!
-     * Frees a chunk allocated through kAlloc
+     * Frees a chunk allocated through kAlloc, not from interrupt handlers either
      * @param ptr The virtual address of the memory to free
      */
     void kFree(void *ptr);
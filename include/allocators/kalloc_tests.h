@@ -24,5 +24,17 @@ namespace kalloc::tests {
     /// Test edge case where allocator has to wrap around to find free space
     void testEdgeWraparound();
 
+    /// Test the size classes and that emptied slabs are given back
+    void testSlabClasses();
+
+    /// Test that pointers resolve to the allocator that owns them
+    void testOwnerMap();
+
+    /// Test that medium blocks are coalesced and the chunks they needed are given back
+    void testGeneralHeap();
+
+    /// Test that objects are cached per CPU, exchanged through the depot and reclaimed
+    void testMagazines();
+
     void runAllTests();
 }
\ No newline at end of file
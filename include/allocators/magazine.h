@@ -0,0 +1,59 @@
+/*
+ * magazine.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "util/types.h"
+
+namespace kalloc {
+    constexpr const size_t MAX_CPUS = 8;
+    constexpr const size_t MAGAZINE_ROUNDS = 14; ///< A magazine is 128 bytes, a slab object itself
+    constexpr const size_t DEPOT_FULL_LIMIT = 16; ///< Full magazines kept per class, more go back to the slabs
+
+    /// A stack of free objects of one size class
+    struct Magazine {
+        size_t rounds;
+        Magazine *next; ///> In the lists of the depot
+        void *objects[MAGAZINE_ROUNDS];
+    };
+
+    /**
+     * @brief The magazines of one CPU for one size class
+     * Only its CPU touches it, and kAlloc is never called from interrupt handlers, so it takes no lock. Allocations
+     * pop from loaded and frees push to it; when it is empty or full it is swapped with previous, and only when both
+     * are is the depot visited. This way a CPU that keeps allocating and freeing around the edge of a magazine
+     * doesn't go to the depot every time.
+     */
+    struct CpuCache {
+        Magazine *loaded, *previous;
+        size_t hits; ///> Served by the magazines of the CPU
+        size_t depotHits; ///> Served after a magazine was exchanged with the depot
+        size_t misses; ///> Went to the slabs
+    };
+
+    struct MagazineStats {
+        size_t hits, depotHits, misses;
+    };
+
+    /**
+     * @brief Allocates an object of a slab class through the magazines of the running CPU
+     * The magazines sit in front of the slab caches: the depot of each class trades full and empty magazines
+     * between CPUs, and the slabs are only reached, under their lock, when neither has objects.
+     */
+    void *magazineAlloc(size_t index);
+
+    void magazineFree(size_t index, void *ptr);
+
+    /**
+     * @brief Gives every object cached in magazines back to the slabs, then the spare slabs to the VirtualAllocator
+     * Run when free memory gets low. The caches of other CPUs are left to them.
+     * @return the number of objects given back
+     */
+    size_t reclaim();
+
+    /// The counters of a CPU, summed over the size classes
+    MagazineStats magazineStats(size_t cpu);
+}
@@ -10,6 +10,7 @@
 
 #include "bitmap_allocator.h"
 #include "buddy_allocator.h"
+#include "hierarchical_bitmap_allocator.h"
 #include "../arch/x86_64/exceptions.h"
 
 namespace physical_allocator::tests {
@@ -18,6 +19,15 @@ namespace physical_allocator::tests {
     private:
         size_t kMemBase_, kMemSize_;
         Allocator &alloc;
+
+        /// Where an allocation lands is up to the allocator, it only has to be in its memory
+        [[nodiscard]] bool inMemory(size_t addr, size_t pages) const {
+            return paging::pageAligned(addr) && addr >= kMemBase_ && addr + pages * PAGE_SIZE <= kMemBase_ + kMemSize_;
+        }
+
+        [[nodiscard]] static bool overlap(size_t addr1, size_t pages1, size_t addr2, size_t pages2) {
+            return addr1 < addr2 + pages2 * PAGE_SIZE && addr2 < addr1 + pages1 * PAGE_SIZE;
+        }
     public:
 
         explicit PhysicalAllocatorTester(Allocator &allocator) : kMemBase_(allocator.memBase),
@@ -28,7 +38,7 @@ namespace physical_allocator::tests {
         void testAllocateSinglePage() {
             Logger::instance().println("[P_ALLOCATOR] Allocating 1");
             size_t addr = alloc.allocate(1);
-            kAssert(addr == kMemBase_, "[P_ALLOC] Allocated address does not match expected start address");
+            kAssert(inMemory(addr, 1), "[P_ALLOC] Allocated address is outside of the memory");
 
 
             Logger::instance().println("[P_ALLOCATOR] Freeing 1");
@@ -40,16 +50,15 @@ namespace physical_allocator::tests {
             alloc.free(addr2, 1);  // Cleanup
         }
 
-        /// Test allocating multiple pages and check if they are consecutive
+        /// Test allocating multiple pages and check that they don't overlap
         void testAllocateMultiplePages() {
             size_t addr = alloc.allocate(4);
-            kAssert(addr == kMemBase_, "[P_ALLOCATOR] First allocated address incorrect");
+            kAssert(inMemory(addr, 4), "[P_ALLOCATOR] First allocated address incorrect");
 
-            // Verify that allocations are consecutive
             size_t addrNext = alloc.allocate(4);
             Logger::instance().println("[P_ALLOCATOR] addr: %X, addrNext: %X", addr, addrNext);
-            Logger::instance().println("[P_ALLOCATOR] Expected addrNext: %X", addr + 4 * PAGE_SIZE);
-            kAssert(addrNext == addr + 4 * PAGE_SIZE, "[P_ALLOCATOR] Subsequent allocation is not consecutive");
+            kAssert(inMemory(addrNext, 4), "[P_ALLOCATOR] Second allocated address incorrect");
+            kAssert(!overlap(addr, 4, addrNext, 4), "[P_ALLOCATOR] Allocations overlap");
 
             alloc.free(addr, 4);
             alloc.free(addrNext, 4);  // Cleanup
@@ -80,6 +89,37 @@ namespace physical_allocator::tests {
             alloc.free(addr3, 2);  // Cleanup
         }
 
+        /// Test runs that are not a power of two and that pages freed inside a run are found again
+        void testLongRuns() {
+            size_t freeBefore = alloc.freePages();
+            size_t largestBefore = alloc.largestFreeBlock();
+            size_t first = alloc.allocate(3);
+            size_t run = alloc.allocate(130);
+            kAssert(inMemory(run, 130) && !overlap(first, 3, run, 130), "[P_ALLOCATOR] Long run overlaps");
+            kAssert(alloc.freePages() == freeBefore - 133, "[P_ALLOCATOR] Wrong number of free pages");
+
+            alloc.free(run + 10 * PAGE_SIZE, 1);
+            size_t single = alloc.allocate(1);
+            kAssert(inMemory(single, 1), "[P_ALLOCATOR] Page is outside of the memory");
+
+            alloc.free(first, 3);
+            size_t small = alloc.allocate(2);
+            kAssert(!overlap(small, 2, run, 130), "[P_ALLOCATOR] Run was handed out twice");
+
+            alloc.free(small, 2);
+            alloc.free(run, 10);
+            alloc.free(single, 1);
+            alloc.free(run + 11 * PAGE_SIZE, 119);
+            kAssert(alloc.freePages() == freeBefore, "[P_ALLOCATOR] Pages were lost");
+
+            // Everything was given back, so the largest block has to be whole again
+            kAssert(alloc.largestFreeBlock() == largestBefore, "[P_ALLOCATOR] Freed runs were not merged");
+            size_t whole = alloc.allocate(largestBefore);
+            kAssert(inMemory(whole, largestBefore) && alloc.freePages() == freeBefore - largestBefore,
+                    "[P_ALLOCATOR] The largest block can't be allocated");
+            alloc.free(whole, largestBefore);  // Cleanup
+            kAssert(alloc.freePages() == freeBefore, "[P_ALLOCATOR] Pages were lost");
+        }
 
         void runAllTests() {
             Logger::instance().println("[P_ALLOCATOR] Running testAllocateSingle...");
@@ -97,6 +137,10 @@ namespace physical_allocator::tests {
             Logger::instance().println("[P_ALLOCATOR] Running testEdgeWraparound...");
             testEdgeWraparound();
             Logger::instance().println("[P_ALLOCATOR] Success!");
+
+            Logger::instance().println("[P_ALLOCATOR] Running testLongRuns...");
+            testLongRuns();
+            Logger::instance().println("[P_ALLOCATOR] Success!");
         }
     };
 }
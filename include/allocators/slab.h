@@ -0,0 +1,77 @@
+/*
+ * slab.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "util/types.h"
+#include "arch/x86_64/paging_constants.h"
+#include "util/locks.h"
+
+namespace kalloc {
+    constexpr const size_t SLAB_SIZE = paging::PAGE_SIZE; ///< Every slab is one page, its header at the start
+    constexpr const size_t SLAB_MIN_OBJECT = 16;
+    constexpr const size_t SLAB_MAX_OBJECT = 1024; ///< Bigger objects would leave too much of a page unused
+    constexpr const size_t SLAB_CLASSES = 13; ///< 16, 24, 32, 48, ..., 768, 1024
+
+    struct SlabCache;
+
+    /**
+     * @brief A page of objects of the same size
+     * The header is at the start of the page, so the slab of an object is found by rounding it down to the page.
+     * Free objects hold the link of the free list, objects that were never used are handed out from the end of
+     * the used part of the page, so a new slab is not walked to build its free list.
+     */
+    struct Slab {
+        uint64_t magic;
+        SlabCache *cache;
+        Slab *prev, *next; ///> Neighbours in the partial list of the cache
+        void *free; ///> Objects that were freed, each one points to the next
+        uint32_t used; ///> Objects handed out
+        uint32_t fresh; ///> Objects from the start that were handed out at least once
+        uint32_t capacity;
+    };
+
+    /**
+     * @brief The slabs of one size class
+     * Only slabs with free objects are kept in a list, full slabs are found through their objects.
+     * One empty slab is kept as a spare, so a loop of new and delete doesn't allocate a page every time.
+     */
+    struct SlabCache {
+        size_t objectSize;
+        Slab *partial{};
+        Slab *spare{};
+        size_t slabs{}; ///> Slabs owned, the spare included
+        size_t objects{}; ///> Objects handed out
+        locking::SpinLock lock{};
+
+        void *alloc();
+
+        void free(Slab *slab, void *ptr);
+
+        /// Gives the spare slab back to the VirtualAllocator
+        void releaseSpare();
+    };
+
+    /// The class of a size, sizes are rounded up to a power of two or to 1.5 times one
+    size_t slabClass(size_t size);
+
+    /// Whether the size is served by a slab
+    constexpr bool slabSize(size_t size) {
+        return size <= SLAB_MAX_OBJECT;
+    }
+
+    void *slabAlloc(size_t size);
+
+    /// The slab an object was allocated from; nullptr if ptr is not a slab object
+    Slab *slabOf(void *ptr);
+
+    void slabFree(Slab *slab, void *ptr);
+
+    /// The size class of the objects of a slab
+    size_t slabIndex(const Slab *slab);
+
+    SlabCache &slabCache(size_t index);
+}
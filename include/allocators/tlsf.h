@@ -0,0 +1,90 @@
+/*
+ * tlsf.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "util/types.h"
+#include "arch/x86_64/paging_constants.h"
+
+namespace kalloc {
+    /**
+     * @brief Two-Level Segregated Fit heap, for sizes between the slab classes and whole pages
+     *
+     * Free blocks are kept in lists by size: the first level is the power of two of the size, the second splits
+     * every power of two in SL_COUNT ranges. A bitmap per level tells which lists have blocks, so the list to take
+     * a block from is found with two bit scans and malloc and free take the same time whatever the heap looks
+     * like. A request is rounded up to the start of the next range, so any block of the list found is big enough.
+     *
+     * Blocks are coalesced with their free neighbours as soon as they are freed. The heap grows a chunk of
+     * CHUNK_PAGES pages at a time, a chunk that becomes entirely free goes back to the VirtualAllocator unless it
+     * is the last one.
+     */
+    class Tlsf {
+    public:
+        static constexpr const size_t CHUNK_PAGES = 64;
+        static constexpr const size_t CHUNK_SIZE = CHUNK_PAGES * paging::PAGE_SIZE;
+        static constexpr const size_t ALIGN = 16;
+
+        /// Biggest request, a chunk has to hold it next to its sentinel
+        static constexpr const size_t MAX_SIZE = CHUNK_SIZE / 2;
+
+        /// @return nullptr if size is 0 or bigger than MAX_SIZE
+        void *malloc(size_t size);
+
+        void free(void *ptr);
+
+        [[nodiscard]] size_t chunks() const { return chunkCount; }
+
+        [[nodiscard]] size_t freeBytes() const { return freeSize; }
+
+    private:
+        static constexpr const size_t SL_LOG2 = 4;
+        static constexpr const size_t SL_COUNT = 1 << SL_LOG2;
+        static constexpr const size_t ALIGN_LOG2 = 4;
+        static constexpr const size_t FL_SHIFT = SL_LOG2 + ALIGN_LOG2; ///> Sizes below 2^FL_SHIFT are in list 0
+        static constexpr const size_t SMALL_BLOCK = 1 << FL_SHIFT;
+        static constexpr const size_t FL_MAX = 32;
+        static constexpr const size_t FL_COUNT = FL_MAX - FL_SHIFT + 1;
+
+        struct Block {
+            Block *prevPhysical; ///> The block before this one in its chunk, nullptr for the first
+            size_t size; ///> Of the payload, the low bit is set while the block is free
+            /// Only in free blocks, where the payload starts
+            Block *nextFree, *prevFree;
+
+            [[nodiscard]] bool isFree() const { return size & 1; }
+
+            [[nodiscard]] size_t payload() const { return size & ~(size_t) 1; }
+        };
+
+        static constexpr const size_t HEADER = 2 * sizeof(size_t); ///> What a used block keeps before its payload
+        static constexpr const size_t MIN_BLOCK = sizeof(Block) - HEADER; ///> A free block holds its links
+
+        uint32_t flBitmap{};
+        uint32_t slBitmap[FL_COUNT]{};
+        Block *heads[FL_COUNT][SL_COUNT]{};
+        size_t chunkCount{};
+        size_t freeSize{};
+
+        static void mapping(size_t size, size_t &fl, size_t &sl);
+
+        static Block *next(Block *block);
+
+        static Block *fromPayload(void *ptr);
+
+        void insert(Block *block);
+
+        void remove(Block *block);
+
+        /// A free block of at least size bytes, taken out of its list; nullptr if there is none
+        Block *find(size_t size);
+
+        /// Splits the end of a block off as a new free block if it is big enough to be one
+        void split(Block *block, size_t size);
+
+        bool grow();
+    };
+}
@@ -8,12 +8,17 @@
 #pragma once
 
 #include "p_allocator_tests.h"
+#include "util/locks.h"
 
 namespace virtual_allocator {
+    /// The page frame allocator behind vAlloc, any allocator of physical_allocator can be put here
+    using PageFrameAllocator = physical_allocator::BuddyAllocator;
+
     class VirtualAllocator {
     private:
-        physical_allocator::BitmapAllocator physicalAllocator;
+        PageFrameAllocator physicalAllocator;
         uint64_t KERNEL_VIRTUAL_START;
+        locking::SpinLock lock;
         static VirtualAllocator *instance_;
 
     public:
@@ -34,6 +39,15 @@ namespace virtual_allocator {
         void *vAlloc(size_t pages);
 
         void vFree(void *virtualAddress, size_t pages);
+
+        /// Pages of physical memory that are not allocated
+        [[nodiscard]] size_t freePages() const;
+
+        /// The first virtual address vAlloc can return
+        [[nodiscard]] size_t virtualStart() const;
+
+        /// The end of the virtual addresses vAlloc can return, the rest of the kernel space is free for other uses
+        [[nodiscard]] size_t virtualEnd() const;
     };
 
     // Not to self: One shouldn't split templates into .h & .cpp
@@ -39,5 +39,9 @@ static_assert(AssertSize<RegistersState, 176>());
 
 typedef void (*InterruptHandler)();
 
+/// Handles a CPU exception, returns false if it can't be recovered from
+typedef bool (*ExceptionHandler)(RegistersState *state);
+
 void setupInterrupts();
-void setInterruptHandler(Byte num, InterruptHandler handler);
\ No newline at end of file
+void setInterruptHandler(Byte num, InterruptHandler handler);
+void setExceptionHandler(Byte num, ExceptionHandler handler);
\ No newline at end of file
@@ -46,12 +46,22 @@ namespace paging {
 
     void map(VirtualAddress virt, size_t physical, uint8_t flags = PRESENT | WRITE);
 
+    /// Every 2 MiB of the range that is aligned on both addresses is mapped as a huge page, the rest page by page
     void mapPages(VirtualAddress virt, size_t physical, size_t pages, uint8_t flags = PRESENT | WRITE);
 
     void unmap(VirtualAddress virt);
 
+    /// Huge pages in the range are unmapped whole, the range can't end inside one
     void unmapPages(VirtualAddress virt, size_t pages);
 
+    /// Maps a 2 MiB page with a single PD entry, both addresses have to be 2 MiB aligned
+    void mapHuge(VirtualAddress virt, size_t physical, uint8_t flags = PRESENT | WRITE);
+
+    void unmapHuge(VirtualAddress virt);
+
+    /// Whether virt is inside a huge page
+    bool hugePagePresent(VirtualAddress virt);
+
     /*!
      * Computes the number of entries necessary to map a certain size of memory
      *
@@ -72,6 +82,10 @@ namespace paging {
         return (addr / paging::PAGE_SIZE) * paging::PAGE_SIZE;
     }
 
+    constexpr bool hugeAligned(size_t addr) {
+        return !(addr & (paging::HUGE_PAGE_SIZE - 1));
+    }
+
     inline constexpr std::pair<uint64_t, uint64_t> physicalExcludingEarly(const std::pair<uint64_t, uint64_t> &memory) {
         if (memory.first < IDENTITY_MAPPED_EARLY) {
             uint64_t dif = IDENTITY_MAPPED_EARLY - memory.first;
@@ -83,6 +97,9 @@ namespace paging {
     // Initialize paging
     void init();
 
+    /// The address that caused the last page fault, from CR2
+    size_t faultAddress();
+
     // Clear all the bytes given the virtual address of a page
     void clearVirtual(size_t page);
 
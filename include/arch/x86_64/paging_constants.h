@@ -33,12 +33,19 @@ namespace paging {
     constexpr const size_t pde_allocations = 2_MiB;   ///> The physical memory that a PD Entry can map
     constexpr const size_t pte_allocations = 4_KiB;   ///> The physical memory that a PD Entry can map
 
+    constexpr const size_t HUGE_PAGE_SIZE = pde_allocations; ///> A huge page takes a whole PD Entry
+    constexpr const size_t HUGE_PAGE_PAGES = HUGE_PAGE_SIZE / PAGE_SIZE;
+
     constexpr const uint8_t PRESENT = 0x1;  ///> Paging flag for present page
     constexpr const uint8_t WRITE = 0x2;  ///> Paging flag for writable page
     constexpr const uint8_t USER = 0x4;  ///> Paging flag for user page
     constexpr const uint8_t WRITE_THROUGH = 0x8;  ///> Paging flag for write-through page
     constexpr const uint8_t CACHE_DISABLED = 0x10; ///> Paging flag for cache disabled page
     constexpr const uint8_t ACCESSED = 0x20; ///> Paging flag for accessed page
+    constexpr const uint8_t HUGE_PAGE = 0x80; ///> Paging flag (PS) for a PD Entry that maps a huge page, not a PT
+
+    constexpr const size_t FAULT_PRESENT = 0x1; ///> Page fault error code bit, the page was present
+    constexpr const size_t FAULT_WRITE = 0x2; ///> Page fault error code bit, the access was a write
 }
 
 #endif //BOSS_PAGING_CONSTANTS_H
@@ -43,6 +43,18 @@ namespace sys_calls {
 
     void sc_write(SystemCallRegisters *regs);
 
+    void sc_pread(SystemCallRegisters *regs);
+
+    void sc_pwrite(SystemCallRegisters *regs);
+
+    void sc_readv(SystemCallRegisters *regs);
+
+    void sc_writev(SystemCallRegisters *regs);
+
+    void sc_seek(SystemCallRegisters *regs);
+
+    void sc_fstat(SystemCallRegisters *regs);
+
     void sc_cwd(SystemCallRegisters *regs);
 
     void sc_mkdir(SystemCallRegisters *regs);
@@ -53,6 +65,28 @@ namespace sys_calls {
 
     void sc_ls(SystemCallRegisters *regs);
 
+    void sc_defrag(SystemCallRegisters *regs);
+
+    void sc_fallocate(SystemCallRegisters *regs);
+
+    void sc_sync(SystemCallRegisters *regs);
+
+    void sc_copy_range(SystemCallRegisters *regs);
+
+    void sc_getdents(SystemCallRegisters *regs);
+
+    void sc_ring_setup(SystemCallRegisters *regs);
+
+    void sc_ring_enter(SystemCallRegisters *regs);
+
+    void sc_ring_destroy(SystemCallRegisters *regs);
+
+    void sc_mmap(SystemCallRegisters *regs);
+
+    void sc_munmap(SystemCallRegisters *regs);
+
+    void sc_msync(SystemCallRegisters *regs);
+
     typedef void (*SyscallHandlerType)(SystemCallRegisters *);
 
     static std::array<SyscallHandlerType, 256> sysCallArray{};
@@ -62,16 +96,35 @@ namespace sys_calls {
         sysCallArray[0x01] = sc_write;
         sysCallArray[0x02] = sc_open;
         sysCallArray[0x03] = sc_close;
+        sysCallArray[0x05] = sc_fstat;
+        sysCallArray[0x08] = sc_seek;
+        sysCallArray[0x09] = sc_mmap; // fd in rdi, length in rsi, PROT_* | MAP_* flags in rdx, offset in r10
+        sysCallArray[0x0B] = sc_munmap;
+        sysCallArray[0x11] = sc_pread;
+        sysCallArray[0x12] = sc_pwrite;
+        sysCallArray[0x13] = sc_readv; // fd in rdi, vfs::io_vec array in rsi, number of buffers in rdx
+        sysCallArray[0x14] = sc_writev;
+        sysCallArray[0x1A] = sc_msync;
 
         sysCallArray[0x4A] = sc_pwd;
         sysCallArray[0x4B] = sc_cwd;
         sysCallArray[0x4E] = sc_mkdir;
         sysCallArray[0x4F] = sc_rmdir;
 
+        sysCallArray[0xA2] = sc_sync; // fd in rdi, vfs::SYNC_ALL to write back every file
+
         sysCallArray[0xAA] = sc_rm;
 
         // usually ls calls other system calls
         sysCallArray[0xAB] = sc_ls; // custom, simplifies stuff
+        sysCallArray[0xAC] = sc_fallocate; // custom, fd in rdi, offset in rsi, length in rdx, flags in r10
+        sysCallArray[0xAD] = sc_defrag; // custom, path in rdi (0 for the whole fs), frag_stat* in rsi
+        sysCallArray[0xAE] = sc_copy_range; // custom, src fd in rdi, src offset in rsi, dst fd in rdx, dst offset in r10, length in r8
+        sysCallArray[0xAF] = sc_getdents; // custom, directory fd in rdi, buffer in rsi, length in rdx
+
+        sysCallArray[0xB0] = sc_ring_setup; // custom, entries in rdi, returns the vfs::io_ring
+        sysCallArray[0xB1] = sc_ring_enter; // custom, ring in rdi, number of submissions in rsi
+        sysCallArray[0xB2] = sc_ring_destroy;
     }
 
     inline void doSystemCall(SystemCallRegisters *regState) {
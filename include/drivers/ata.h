@@ -12,6 +12,8 @@
 #include "arch/x86_64/logging.h"
 #include "arch/x86_64/exceptions.h"
 #include "disk_driver.h"
+#include "std/algorithm.h"
+#include "util/locks.h"
 
 /*
  * ATA - Advanced Technology Attachment
@@ -72,6 +74,7 @@ namespace ata {
     constexpr const uint32_t CONTROLLER_TIMEOUT = 1'000'000'000;
 
     static constexpr const uint32_t SECTOR_SIZE = 512;
+    static constexpr const uint32_t MAX_SECTORS_PER_COMMAND = 256; ///> Limit of the 8-bit sector count in 28-bit PIO
 
 
     class Ata final : public Disk {
@@ -86,12 +89,20 @@ namespace ata {
         Port8Bit commandPort; ///> instruction - read, write
         Port8Bit controlPort;
 
-        static volatile bool primary_invoked;
+        /// Per channel, the primary is 0 and the secondary 1
+        static volatile bool invoked[2];
+        /// A channel runs one command at a time, whichever drive it is for
+        static locking::SpinLock channel_locks[2];
 
+        size_t channel;
         bool detailedLoggingEnabled{false};
 
         static void primary_controller_handler() {
-            Ata::primary_invoked = true;
+            Ata::invoked[0] = true;
+        }
+
+        static void secondary_controller_handler() {
+            Ata::invoked[1] = true;
         }
 
     public:
@@ -104,11 +115,17 @@ namespace ata {
                                                 lbaMidPort(portBase + ATA_LCYL), lbaHiPort(portBase + ATA_HCYL),
                                                 devicePort(portBase + ATA_DRV_HEAD),
                                                 commandPort(portBase + ATA_COMMAND),
-                                                controlPort(portBase + ATA_DEV_CTL) {
+                                                controlPort(portBase + ATA_DEV_CTL),
+                                                channel(portBase == ATA_SECONDARY) {
             kAssert(isMaster, "[ATA] Only master is supported at the moment!");
             this->isMaster = isMaster;
-            setInterruptHandler(0x2E, primary_controller_handler);
-            setInterruptHandler(0xE, primary_controller_handler);
+            if (channel) {
+                setInterruptHandler(0x2F, secondary_controller_handler);
+                setInterruptHandler(0xF, secondary_controller_handler);
+            } else {
+                setInterruptHandler(0x2E, primary_controller_handler);
+                setInterruptHandler(0xE, primary_controller_handler);
+            }
         }
 
         void enableDetailedLogging() {
@@ -130,9 +147,9 @@ namespace ata {
             return true;
         }
 
-        static void ata_wait_irq_primary() {
+        void ata_wait_irq() {
             volatile int x = 0;
-            for (int i = 0;!primary_invoked && i < 10000; i++) {
+            for (int i = 0;!invoked[channel] && i < 10000; i++) {
                 x += 1;
                 asm volatile ("nop");
                 asm volatile ("nop");
@@ -142,7 +159,7 @@ namespace ata {
                 asm volatile ("nop");
             }
 
-            primary_invoked = false;
+            invoked[channel] = false;
         }
 
         inline void ata_400ns_delay() {
@@ -180,7 +197,15 @@ namespace ata {
             CLEAR
         };
 
-        void read_write_sector(uint64_t start, void *data, sector_operation operation) {
+        /**
+         * Transfers count consecutive sectors with a single command, the drive interrupts once per sector
+         * @param start LBA of the first sector
+         * @param count number of sectors, at most MAX_SECTORS_PER_COMMAND
+         */
+        void read_write_sectors(uint64_t start, uint32_t count, void *data, sector_operation operation) {
+            kAssert(count > 0 && count <= MAX_SECTORS_PER_COMMAND, "[ATA] Invalid sector count!");
+            locking::Guard<locking::SpinLock> guard(channel_locks[channel]);
+
             //Select the device
             kAssert(select_device(), "[ATA] Could not select device!");
 
@@ -191,54 +216,62 @@ namespace ata {
 
             auto command = operation == sector_operation::READ ? ATA_READ_BLOCK : ATA_WRITE_BLOCK;
 
-            // Process the command
-            sectorCountPort.write(1);
+            // Process the command, a sector count of 0 means 256 sectors
+            sectorCountPort.write(count & 0xFF);
             lbaLowPort.write(sc);
             lbaMidPort.write(cl);
             lbaHiPort.write(ch);
             devicePort.write((1 << 6) | hd);
             commandPort.write(command);
 
-            /**- Wait at most 30 seconds for BSY flag to be cleared */
-            if (detailedLoggingEnabled)
-                Logger::instance().println("[ATA] Waiting for controller...");
-            kAssert(wait_for_controller(ATA_STATUS_BSY, 0, CONTROLLER_TIMEOUT), "[ATA] Error wait");
-            if (detailedLoggingEnabled)
-                Logger::instance().println("[ATA] Finished waiting!");
-            // Verify if there are errors
-            kAssert(!(commandPort.read() & ATA_STATUS_ERR), "[ATA] Error status");
-
             auto *buffer = reinterpret_cast<uint16_t *>(data);
 
+            for (uint32_t sector = 0; sector < count; sector++) {
+                /**- Wait at most 30 seconds for BSY flag to be cleared */
+                if (detailedLoggingEnabled)
+                    Logger::instance().println("[ATA] Waiting for controller...");
+                kAssert(wait_for_controller(ATA_STATUS_BSY, 0, CONTROLLER_TIMEOUT), "[ATA] Error wait");
+                if (detailedLoggingEnabled)
+                    Logger::instance().println("[ATA] Finished waiting!");
+                // Verify if there are errors
+                kAssert(!(commandPort.read() & ATA_STATUS_ERR), "[ATA] Error status");
+
+                if (operation == sector_operation::WRITE) {
+                    for (int i = 0; i < 256; ++i)
+                        dataPort.write(*buffer++);
+                } else if (operation == sector_operation::CLEAR) {
+                    for (int i = 0; i < 256; ++i)
+                        dataPort.write(0);
+                }
 
-            if (operation == sector_operation::WRITE) {
-                for (int i = 0; i < 256; ++i)
-                    dataPort.write(*buffer++);
-            } else if (operation == sector_operation::CLEAR) {
-                for (int i = 0; i < 256; ++i)
-                    dataPort.write(0);
-            }
-
-            // Wait the IRQ to happen
-            if (detailedLoggingEnabled)
-                Logger::instance().println("[ATA] Waiting for IRQ primary...");
-            ata_wait_irq_primary();
-            if (detailedLoggingEnabled)
-                Logger::instance().println("[ATA] Finished waiting!");
-
-            // The device can report an error after the IRQ
-            kAssert(!(commandPort.read() & ATA_STATUS_ERR), "[ATA] Error after IRQ");
-
-            if (operation == sector_operation::READ) {
-                // Read the disk sectors
-                for (int i = 0; i < 256; ++i) {
-                    *buffer++ = dataPort.read();
+                // Wait the IRQ to happen
+                if (detailedLoggingEnabled)
+                    Logger::instance().println("[ATA] Waiting for IRQ on channel %X...", channel);
+                ata_wait_irq();
+                if (detailedLoggingEnabled)
+                    Logger::instance().println("[ATA] Finished waiting!");
+
+                // The device can report an error after the IRQ
+                kAssert(!(commandPort.read() & ATA_STATUS_ERR), "[ATA] Error after IRQ");
+
+                if (operation == sector_operation::READ) {
+                    // The data of this sector is ready once DRQ is set
+                    kAssert(wait_for_controller(ATA_STATUS_BSY | ATA_STATUS_DRQ, ATA_STATUS_DRQ,
+                                                CONTROLLER_TIMEOUT), "[ATA] Error wait for data");
+                    // Read the disk sector
+                    for (int i = 0; i < 256; ++i) {
+                        *buffer++ = dataPort.read();
+                    }
                 }
             }
         }
 
-        // Check if there is a hard drive and of what type
-        void identity() {
+        void read_write_sector(uint64_t start, void *data, sector_operation operation) {
+            read_write_sectors(start, 1, data, operation);
+        }
+
+        // Check if there is a hard drive and of what type, false if there is none
+        bool identity() {
             Logger::instance().println("[ATA] Identifying hard drives...");
             // Whether we want to talk to the master or the slave
             devicePort.write(isMaster ? 0xA0 : 0xB0);
@@ -248,8 +281,7 @@ namespace ata {
             uint8_t status = commandPort.read();
             if (status == 0xFF) {
                 Logger::instance().println("[ATA] There is no hard on this bus!");
-                kPanic("[ATA] No hard on this bus!");
-                return;
+                return false;
             }
 
             devicePort.write(isMaster ? 0xA0 : 0xB0);
@@ -263,8 +295,7 @@ namespace ata {
             if (status == 0x00) {
                 // no device
                 Logger::instance().println("[ATA] There is no device here!");
-                kPanic("[ATA] No device!");
-                return;
+                return false;
             }
 
             while (((status & 0x80) == 0x80)
@@ -272,8 +303,7 @@ namespace ata {
                 status = commandPort.read();
             if ((status & 0x01)) {
                 Logger::instance().println("[ATA] Error...");
-                kPanic("[ATA] Error");
-                return;
+                return false;
             }
 
             // Data is ready, read the information
@@ -290,6 +320,7 @@ namespace ata {
 
             Logger::instance().println("[ATA] We have a disk with %X sectors of size %X:\n",
                                        this->cntBlocks_, this->totalSize_);
+            return true;
         }
 
         void read(size_t blockIndex, uint8_t *data) override {
@@ -304,6 +335,24 @@ namespace ata {
             cntWrites_++;
         }
 
+        void readBlocks(size_t blockIndex, size_t count, uint8_t *data) override {
+            for (size_t done = 0; done < count; done += MAX_SECTORS_PER_COMMAND) {
+                size_t sectors = std::min(count - done, (size_t) MAX_SECTORS_PER_COMMAND);
+                sanityCheck(blockIndex + done + sectors - 1, data);
+                read_write_sectors(blockIndex + done, sectors, data + done * SECTOR_SIZE, sector_operation::READ);
+                cntReads_++;
+            }
+        }
+
+        void writeBlocks(size_t blockIndex, size_t count, uint8_t *data) override {
+            for (size_t done = 0; done < count; done += MAX_SECTORS_PER_COMMAND) {
+                size_t sectors = std::min(count - done, (size_t) MAX_SECTORS_PER_COMMAND);
+                sanityCheck(blockIndex + done + sectors - 1, data);
+                read_write_sectors(blockIndex + done, sectors, data + done * SECTOR_SIZE, sector_operation::WRITE);
+                cntWrites_++;
+            }
+        }
+
 /*        void flush()  {
             devicePort.write(isMaster ? 0xE0 : 0xF0);
             commandPort.write(0xE7); // flush command
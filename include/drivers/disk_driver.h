@@ -76,6 +76,28 @@ public:
      */
     virtual void write(size_t blockIndex, uint8_t *data) = 0;
 
+    /**
+     * Read consecutive blocks from disk, drivers override it to use a single transfer
+     * @param blockIndex first block to read from
+     * @param count number of blocks to read
+     * @param data data buffer of count blocks to write into
+     */
+    virtual void readBlocks(size_t blockIndex, size_t count, uint8_t *data) {
+        for (size_t i = 0; i < count; i++)
+            read(blockIndex + i, data + i * 512);
+    }
+
+    /**
+     * Write consecutive blocks to disk, drivers override it to use a single transfer
+     * @param blockIndex first block to write into
+     * @param count number of blocks to write
+     * @param data data buffer of count blocks to read from
+     */
+    virtual void writeBlocks(size_t blockIndex, size_t count, uint8_t *data) {
+        for (size_t i = 0; i < count; i++)
+            write(blockIndex + i, data + i * 512);
+    }
+
     void test() {
         uint32_t maxTests = cntBlocks_ / 100;
         Logger::instance().println("[DISK DRIVER] Running %d tests for %X blocks...", maxTests, cntBlocks_);
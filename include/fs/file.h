@@ -30,4 +30,67 @@ namespace vfs {
             this->isValid = false;
         }
     };
-}
\ No newline at end of file
+
+    /**
+     * @brief Metadata of a file, as returned by stat
+     */
+    struct file_stat {
+        uint64_t size{}; ///> Logical size of the file in bytes, holes included
+        uint64_t blocks{}; ///> Number of blocks actually allocated on disk, metadata blocks included
+        uint32_t blockSize{}; ///> Size of a block in bytes
+    };
+
+    /**
+     * @brief Fragmentation of a file or of a whole file system
+     */
+    struct frag_stat {
+        uint64_t files{}; ///> Files with at least one data block
+        uint64_t extents{}; ///> Allocation units (blocks, or clusters of compressed files)
+        uint64_t fragments{}; ///> Contiguous runs the extents form on disk
+        uint64_t blocks{}; ///> Data blocks
+        uint32_t score{}; ///> 0 if every file is a single run, 100 if no two extents are adjacent
+
+        void update_score() {
+            score = extents > files ? (fragments - files) * 100 / (extents - files) : 0;
+        }
+    };
+
+    /**
+     * @brief A buffer of a vectored read or write
+     */
+    struct io_vec {
+        uint8_t *base{};
+        size_t length{};
+    };
+
+    constexpr const size_t DIRENT_NAME_MAX = 64; ///< Longest name getdents reports, including the terminator
+
+    /**
+     * @brief An entry of a directory, as a file system hands it to getdents
+     */
+    struct dir_entry {
+        uint64_t inum{};
+        uint64_t cookie{}; ///> Where the listing goes on after this entry
+        bool isFile{};
+        char name[DIRENT_NAME_MAX]{};
+    };
+
+    /**
+     * @brief Header of a record written by getdents, the null-terminated name follows it
+     *
+     * Records are packed one after the other, each one starts 8-byte aligned at the end of the previous one.
+     */
+    struct dirent_record {
+        uint64_t inum;
+        uint64_t cookie; ///> Seek the directory here to list the entries after this one
+        uint16_t length; ///> Size of the whole record, name and padding included
+        uint16_t nameLength; ///> Without the terminator
+        uint8_t isFile;
+        uint8_t reserved[3];
+    };
+
+    /// Size of the record of a name of nameLength characters
+    constexpr size_t direntRecordSize(size_t nameLength) {
+        return (sizeof(dirent_record) + nameLength + 1 + 7) / 8 * 8;
+    }
+}
@@ -12,14 +12,36 @@
 #include "file.h"
 #include "drivers/disk_driver.h"
 #include "std/expected.h"
+#include "fs_errors.h"
+#include "util/locks.h"
 
 namespace vfs {
     class FileSystem {
     protected:
         Disk *disk_;
     public:
+        /**
+         * The lock of the mount. Calls that only look things up (getInode, stat, openDir, readDir, ls, pwd) may run
+         * together, every other call runs alone. Take it through shared() and exclusive().
+         */
+        locking::RwLock lock;
+
         explicit FileSystem(Disk *disk) : disk_(disk) {}
 
+        /// Runs fn with the lock held for a lookup
+        template<typename Fn>
+        auto shared(Fn fn) {
+            locking::SharedGuard guard(lock);
+            return fn();
+        }
+
+        /// Runs fn with the lock held for a change, or for a call that uses the buffers of the file system
+        template<typename Fn>
+        auto exclusive(Fn fn) {
+            locking::Guard<locking::RwLock> guard(lock);
+            return fn();
+        }
+
         virtual ~FileSystem() = default;
 
         virtual void mount() = 0;
@@ -44,6 +66,35 @@ namespace vfs {
 
         virtual ssize_t stat(size_t inumber) = 0;
 
+        virtual bool stat(size_t inumber, vfs::file_stat &st) = 0;
+
+        /// Optional, file systems without compression refuse it
+        virtual bool setCompressed(size_t, bool) { return false; }
+
+        virtual bool fragmentation(size_t, vfs::frag_stat &) { return false; }
+
+        virtual bool fragmentation(vfs::frag_stat &) { return false; }
+
+        virtual bool defrag(size_t) { return false; }
+
+        virtual bool defrag() { return false; }
+
+        virtual bool fallocate(size_t, size_t, size_t, bool) { return false; }
+
+        /// Optional fast path of vfs::copy_range, -1 if the file system can't copy these ranges itself
+        virtual ssize_t copyRange(size_t, size_t, size_t, size_t, size_t) { return -1; }
+
+        /// Number of the directory at name, for vfs::open with OPEN_DIRECTORY; an empty name is the root
+        virtual std::expected<size_t> openDir(const char *) {
+            return std::make_unexpected<size_t>(std::ERROR_UNSUPPORTED);
+        }
+
+        /**
+         * Fills up to count entries of a directory, starting at cookie (0 is the first entry)
+         * @return the number of entries filled, fewer than count at the end; -1 if dir is not a directory
+         */
+        virtual ssize_t readDir(size_t, size_t, vfs::dir_entry *, size_t) { return -1; }
+
         virtual std::string pwd() = 0;
 
         virtual void test() = 0;
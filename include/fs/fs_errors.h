@@ -31,6 +31,8 @@ namespace std {
     constexpr const size_t ERROR_INVALID_DEVICE = 18;
     constexpr const size_t ERROR_ALREADY_MOUNTED = 19;
     constexpr const size_t ERROR_UNKNOWN = 20;
+    constexpr const size_t ERROR_TOO_MANY_FILES = 21;
+    constexpr const size_t ERROR_BUSY = 22;
 
     inline const char *error_message(size_t error) {
         switch (error) {
@@ -74,6 +76,10 @@ namespace std {
                 return "Something is already mounted";
             case ERROR_UNKNOWN:
                 return "Unknown error occurred";
+            case ERROR_TOO_MANY_FILES:
+                return "Too many open files";
+            case ERROR_BUSY:
+                return "The file is in use";
             default:
                 return "Unknown error";
         }
@@ -8,15 +8,74 @@
 #pragma once
 
 #include "util/types.h"
+#include "std/array.h"
+#include "util/locks.h"
+
+namespace vfs {
+    class FileSystem;
+}
 
 namespace handles {
     using fd_t = size_t;
 
-    size_t register_new_handle(const fd_t &p);
+    /**
+     * @brief An open file, what a file descriptor refers to
+     */
+    struct OpenFile {
+        vfs::FileSystem *file_system{}; ///> The file system the file was opened on, so it is not looked up again
+        size_t inode{};
+        size_t offset{}; ///> Where the next read or write without an explicit offset starts
+        size_t flags{}; ///> The vfs::OPEN_* flags the file was opened with
+    };
+
+    /**
+     * @brief The file descriptors of a process
+     *
+     * Descriptors are always the lowest free number, found in constant time with a two-level bitmap:
+     * a bit per descriptor and a summary bit per word of descriptors that is set when the word is full.
+     * The open files are stored by descriptor in blocks of 64 allocated on first use, so the table only grows up to
+     * the most files open at once. Blocks never move, a reference from get() stays valid while other descriptors
+     * are opened; allocate and release are serialized by a lock.
+     */
+    class FdTable {
+    public:
+        static constexpr const size_t MAX_FDS = 64 * 64; ///> One summary word of 64 bits, each covering 64 fds
+
+        FdTable() = default;
+
+        ~FdTable();
+
+        FdTable(const FdTable &) = delete;
+
+        FdTable &operator=(const FdTable &) = delete;
+
+        /**
+         * @brief Stores file under the lowest free descriptor
+         * @return the descriptor; -1 if the table is full
+         */
+        ssize_t allocate(const OpenFile &file);
+
+        void release(fd_t fd);
+
+        [[nodiscard]] bool has(fd_t fd) const;
+
+        /// The fd has to be valid, check it with has()
+        OpenFile &get(fd_t fd);
 
-    void release_handle(size_t fd);
+        /// Number of open descriptors
+        [[nodiscard]] size_t count() const;
 
-    bool has_handle(size_t fd);
+    private:
+        uint64_t summary{};
+        std::array<uint64_t, MAX_FDS / 64> used{};
+        std::array<OpenFile *, MAX_FDS / 64> files{}; ///> A block per word of used
+        size_t open{};
+        locking::SpinLock lock;
+    };
 
-    const fd_t &get_handle(size_t fd);
-}
\ No newline at end of file
+    /**
+     * @brief The descriptor table of the running process
+     * There is no scheduler yet, so this is always the table of the kernel
+     */
+    FdTable &current();
+}
@@ -0,0 +1,81 @@
+/*
+ * io_ring.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "util/types.h"
+#include "std/expected.h"
+
+namespace vfs {
+    constexpr const uint8_t RING_NOP = 0;
+    constexpr const uint8_t RING_READ = 1; ///< Reads length bytes into address
+    constexpr const uint8_t RING_WRITE = 2; ///< Writes length bytes from address
+    constexpr const uint8_t RING_OPEN = 3; ///< Opens the path at address with the OPEN_* flags in length, the result is the fd
+    constexpr const uint8_t RING_CLOSE = 4;
+
+    constexpr const uint64_t RING_CURRENT_OFFSET = ~0ULL; ///< Reads and writes at the offset of the file, and move it
+
+    constexpr const size_t RING_MAX_ENTRIES = 4096;
+
+    /**
+     * @brief An operation queued by the user
+     */
+    struct ring_submission {
+        uint8_t opcode;
+        uint8_t reserved[7];
+        uint64_t fd;
+        uint64_t address;
+        uint64_t length;
+        uint64_t offset; ///> Offset of a read or write, or RING_CURRENT_OFFSET
+        uint64_t user_data; ///> Copied into the completion, to tell operations apart
+    };
+
+    /**
+     * @brief The result of an operation, posted by the kernel
+     */
+    struct ring_completion {
+        uint64_t user_data;
+        int64_t result; ///> What the system call would return, a negative error on failure
+    };
+
+    /**
+     * @brief A pair of rings shared by the kernel and the user, laid out in one allocation
+     *
+     * The user writes submissions at sq_tail and moves it, the kernel consumes them from sq_head on ring_enter.
+     * The kernel posts completions at cq_tail, the user reads them from cq_head and moves it. Indexes only grow,
+     * the slot is the index modulo the size of the ring. There are twice as many completion slots as submission
+     * slots; while the completion ring is full, submissions stay queued.
+     *
+     * entries and the pointers are only there for the user: the kernel keeps its own copy of them, and of the
+     * indexes it moves, and only reads sq_tail and cq_head back.
+     */
+    struct io_ring {
+        uint32_t sq_head;
+        uint32_t sq_tail;
+        uint32_t cq_head;
+        uint32_t cq_tail;
+        uint32_t entries; ///> Submission slots, a power of two
+        uint32_t reserved;
+        ring_submission *submissions;
+        ring_completion *completions;
+    };
+
+    /**
+     * @brief Allocates a ring with at least entries submission slots, at most RING_MAX_ENTRIES
+     */
+    std::expected<io_ring *> ring_setup(size_t entries);
+
+    /**
+     * @brief Runs up to to_submit queued submissions, in order
+     *
+     * There is no asynchronous block layer yet, so every operation completes during the call: its completion is
+     * posted before ring_enter returns. The gain is one system call for a whole batch of operations.
+     * @return the number of submissions consumed
+     */
+    std::expected<size_t> ring_enter(io_ring *ring, size_t to_submit);
+
+    std::expected<void> ring_destroy(io_ring *ring);
+}
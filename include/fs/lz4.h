@@ -0,0 +1,43 @@
+/*
+ * lz4.h
+ *
+ *  Created on: 10/18/26.
+ */
+
+
+#pragma once
+
+#include "util/types.h"
+
+/*
+ * Codec for the LZ4 block format, see https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+ * A block is a list of sequences: a token (literal length, match length), the literals,
+ * a 2-byte little endian offset and the rest of the match length.
+ * The last 5 bytes are always literals and the last match starts at least 12 bytes before the end.
+ */
+namespace lz4 {
+    constexpr const size_t HASH_LOG = 10;
+    constexpr const size_t HASH_TABLE_SIZE = 1 << HASH_LOG; ///> Entries in the table passed to compress()
+    constexpr const size_t MAX_INPUT_SIZE = 0xFFFF; ///> The hash table stores 16-bit positions
+
+    /**
+     * @brief Compresses src into dst
+     * @param src data to compress, at most MAX_INPUT_SIZE bytes
+     * @param srcSize number of bytes in src
+     * @param dst output buffer
+     * @param dstCapacity size of dst
+     * @param hashTable scratch space of HASH_TABLE_SIZE entries, kept by the caller so it is not on the stack
+     * @return size of the compressed data; 0 if it does not fit into dstCapacity
+     */
+    size_t compress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity, uint16_t *hashTable);
+
+    /**
+     * @brief Decompresses src into dst, never reading or writing out of bounds
+     * @param src compressed data
+     * @param srcSize number of bytes in src
+     * @param dst output buffer
+     * @param dstCapacity size of dst
+     * @return size of the decompressed data; -1 if src is malformed or does not fit into dst
+     */
+    ssize_t decompress(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t dstCapacity);
+}
@@ -0,0 +1,25 @@
+/*
+ * mmap.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "util/types.h"
+
+namespace vfs {
+    /**
+     * @brief Places mappings after the memory of the virtual allocator and takes over page faults
+     * Paging and the virtual allocator have to be set up
+     */
+    void initMmap();
+
+    /**
+     * @brief Brings in the page of a mapping that faulted, the mmap system call is in vfs.h
+     * @param address The address that faulted
+     * @param error The error code of the page fault
+     * @return false if the address is not mapped or the access is not allowed
+     */
+    bool handlePageFault(size_t address, size_t error);
+}
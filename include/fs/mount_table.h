@@ -0,0 +1,111 @@
+/*
+ * mount_table.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "util/types.h"
+#include "std/array.h"
+#include "std/string.h"
+#include "std/vector.h"
+#include "util/locks.h"
+
+namespace vfs {
+    struct MountedFS;
+
+    /**
+     * @brief Finds the mount an absolute path belongs to
+     *
+     * Mount points are kept in a trie with one node per path component, the walk goes down as long as the
+     * components match and remembers the deepest mount on the way. The result of a walk is memoized per directory
+     * (the dentry part of the path, everything before the last component), so paths in the same directory
+     * only hash their directory and check the last component. Mounting clears the memo.
+     * "." components are skipped, ".." components are resolved on the text of the path before the walk.
+     *
+     * Lookups take no lock. Mounting copies the trie, changes the copy and publishes it as the new root, so a walk
+     * always sees a whole trie; replaced tries are kept until the table is destroyed, mounts are rare. Memo entries
+     * are guarded by a sequence lock each, a lookup that races with an update of its entry just walks the trie.
+     *
+     * The table is constant initialized, as the kernel doesn't run global constructors: the trie is created by
+     * the first mount.
+     */
+    class MountTable {
+    public:
+        struct Resolved {
+            MountedFS *mount; ///> nullptr if nothing is mounted at "/"
+            const char *path; ///> The rest of the path inside the mount, without a leading '/'; empty for its root
+        };
+
+        constexpr MountTable() = default;
+
+        ~MountTable();
+
+        MountTable(const MountTable &) = delete;
+
+        MountTable &operator=(const MountTable &) = delete;
+
+        /// Adds a mount, it hides a mount at the same path
+        void add(std::string_view mountPoint, MountedFS *mount);
+
+        /**
+         * @param path Has to be absolute and null-terminated
+         * @param normalized Holds the path without ".." components if it had any, the rest of the path points into it
+         */
+        Resolved resolve(const char *path, std::string &normalized);
+
+        [[nodiscard]] size_t memoHits() const { return __atomic_load_n(&hits, __ATOMIC_RELAXED); }
+
+    private:
+        static constexpr const size_t MEMO_SIZE = 64;
+        static constexpr const size_t MEMO_DIRECTORY = 64; ///> Longer directories are walked every time
+
+        struct Node {
+            std::string name;
+            MountedFS *mount{};
+            std::vector<Node *> children;
+
+            Node *child(std::string_view component) const;
+        };
+
+        /// A walk of the directory part of a path
+        struct Walk {
+            Node *node; ///> The trie node of the directory, nullptr once the walk left the trie
+            MountedFS *mount;
+            size_t skip; ///> Length of the mount point prefix, the rest of the path starts there
+        };
+
+        struct MemoEntry {
+            locking::SeqLock lock;
+            size_t generation{}; ///> 0 is never a valid generation, so entries start out empty
+            size_t hash{};
+            size_t length{};
+            char directory[MEMO_DIRECTORY]{};
+            Walk walk{};
+        };
+
+        Node *root{}; ///> Replaced as a whole by add, read it with an atomic load
+        std::vector<Node *> retired; ///> Tries replaced by add, walks may still be inside of them
+        locking::SpinLock writer;
+        std::array<MemoEntry, MEMO_SIZE> memo{};
+        size_t generation{1};
+        size_t hits{};
+
+        static Node *clone(const Node *node);
+
+        static void destroy(Node *node);
+
+        /// Looks the directory up in its memo entry; false on a miss or if a writer got in the way
+        static bool memoized(MemoEntry &entry, size_t generation, size_t hash, std::string_view directory,
+                             Walk &result);
+
+        static void memoize(MemoEntry &entry, size_t generation, size_t hash, std::string_view directory,
+                            const Walk &result);
+
+        /// The absolute path with its ".." components applied, a ".." at the root stays there
+        static std::string normalize(std::string_view path);
+
+        static Walk walk(Node *root, std::string_view directory);
+    };
+}
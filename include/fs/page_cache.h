@@ -0,0 +1,212 @@
+/*
+ * page_cache.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "util/types.h"
+#include "std/array.h"
+#include "arch/x86_64/paging_constants.h"
+#include "fs/file.h"
+#include "util/locks.h"
+
+namespace vfs {
+    class FileSystem;
+
+    /**
+     * @brief File data cached in pages, shared by every mounted file system
+     *
+     * Files are found by (file system, inode), and the pages of a file by a radix tree over the page index.
+     * Writes only dirty the cached page; it reaches the file system when it is written back, on sync, when the
+     * file is closed or when the page is reclaimed. The number of pages is bounded by a global budget, reclaim
+     * takes the least recently used page.
+     * One lock guards the files, their trees and the LRU list, it is only held while they are looked at. It is
+     * dropped while a page is read from or written back to the file system: the page is marked busy, operations
+     * that need it wait for that to end and look it up again. It is dropped while data is copied to or from the
+     * user too: the page is pinned instead, a buffer that is mapped from the cache faults and maps its page then.
+     * Operations on the same file are ordered by the inode locks of the VFS, the cache only keeps its own state
+     * consistent. The file systems are never called with the lock held, so their locks and the cache lock are
+     * independent.
+     */
+    class PageCache {
+    public:
+        static constexpr const size_t PAGE_SIZE = paging::PAGE_SIZE;
+        static constexpr const size_t DEFAULT_BUDGET = 256; ///> In pages, 1 MiB of file data
+
+        struct Stats {
+            size_t hits{}, misses{};
+            size_t pages{}, dirty{};
+            size_t evictions{}, writebacks{};
+        };
+
+        static PageCache &instance();
+
+        /**
+         * @brief Reads through the cache, misses fill whole pages from the file system
+         * @return the number of bytes read, less than count at the end of the file; -1 on error
+         */
+        ssize_t read(FileSystem *fs, size_t inode, uint8_t *buffer, size_t count, size_t offset);
+
+        /**
+         * @brief Copies the data into cached pages and marks them dirty, the file system is only read for pages
+         * that are partially overwritten
+         * @return count; -1 on error
+         */
+        ssize_t write(FileSystem *fs, size_t inode, const uint8_t *buffer, size_t count, size_t offset);
+
+        /**
+         * @brief Reads into several buffers from consecutive offsets, the file is looked up once
+         * @return the number of bytes read, less than the total length at the end of the file; -1 on error
+         */
+        ssize_t readv(FileSystem *fs, size_t inode, const io_vec *vec, size_t count, size_t offset);
+
+        /// Writes several buffers at consecutive offsets; the number of bytes written, -1 on error
+        ssize_t writev(FileSystem *fs, size_t inode, const io_vec *vec, size_t count, size_t offset);
+
+        /// The size of the file including data that was not written back yet; -1 on error
+        ssize_t size(FileSystem *fs, size_t inode);
+
+        /**
+         * @brief Writes back the dirty pages of a file, the pages stay cached
+         * @return false if any write back of the file failed since the last sync
+         */
+        bool sync(FileSystem *fs, size_t inode);
+
+        /// Writes back every dirty page of a file system, or of all of them if fs is nullptr
+        bool sync(FileSystem *fs = nullptr);
+
+        /// Drops the pages of a file, dirty ones are discarded, for files changed or removed behind the cache
+        void invalidate(FileSystem *fs, size_t inode);
+
+        /// Drops every page of a file system
+        void invalidate(FileSystem *fs);
+
+        /**
+         * @brief Pins a page of the file for a memory mapping, it is not reclaimed until unmapPage
+         * @return the data of the page; nullptr if the page is past the end of the file or can't be read
+         */
+        uint8_t *mapPage(FileSystem *fs, size_t inode, size_t index);
+
+        void unmapPage(FileSystem *fs, size_t inode, size_t index);
+
+        /// Marks the part of a mapped page that lies inside the file as dirty, after a write through a mapping
+        void dirtyPage(FileSystem *fs, size_t inode, size_t index);
+
+        /// Whether pages of the file, or of any file of fs if inode is omitted, are mapped
+        bool mapped(FileSystem *fs, size_t inode);
+
+        bool mapped(FileSystem *fs);
+
+        /// Changes the budget, reclaiming pages if the cache is over it
+        void setBudget(size_t pages);
+
+        [[nodiscard]] Stats stats() const;
+
+    private:
+        static constexpr const size_t RADIX_BITS = 6;
+        static constexpr const size_t RADIX_FANOUT = 1 << RADIX_BITS;
+        static constexpr const size_t FILE_BUCKETS = 64;
+
+        struct CachedFile;
+
+        struct Page {
+            CachedFile *file;
+            size_t index;
+            uint8_t *data;
+            uint32_t dirtyFrom{}, dirtyTo{}; ///> Byte range written since the last write back, empty if clean
+            size_t maps{}; ///> Memory mappings of the page, mapped pages are taken out of the LRU list
+            size_t pins{}; ///> Copies in progress, pinned pages are taken out of the LRU list too
+            bool busy{}; ///> Read from or written to the file system without the lock, its data can't be used
+            Page *prev{}, *next{}; ///> Neighbours in the LRU list, the most recently used page is first
+
+            [[nodiscard]] bool dirty() const { return dirtyFrom < dirtyTo; }
+
+            /// Whether the page has to stay cached
+            [[nodiscard]] bool held() const { return maps || pins; }
+        };
+
+        /// Inner nodes point to nodes, the nodes of the last level point to pages
+        struct RadixNode {
+            std::array<void *, RADIX_FANOUT> slots{};
+            size_t count{};
+        };
+
+        struct CachedFile {
+            FileSystem *fs;
+            size_t inode;
+            size_t size; ///> Grows with writes, before they are written back
+            RadixNode *root{};
+            size_t height{}; ///> Levels of the tree, it covers the page indexes below 64^height
+            size_t pages{};
+            size_t maps{}; ///> Sum of the mappings of its pages
+            size_t users{}; ///> Operations in progress, the file is not freed under them
+            bool error{}; ///> A write back failed since the last sync
+            CachedFile *next{}; ///> Next file in the same bucket
+        };
+
+        std::array<CachedFile *, FILE_BUCKETS> files{};
+        Page *lruFirst{}, *lruLast{};
+        size_t budget{DEFAULT_BUDGET};
+        Stats counters;
+        mutable locking::SpinLock lock;
+
+        static size_t bucket(FileSystem *fs, size_t inode);
+
+        CachedFile *find(FileSystem *fs, size_t inode);
+
+        /// Finds the file, or starts caching it with the size from the file system; nullptr on error
+        CachedFile *acquire(FileSystem *fs, size_t inode);
+
+        void release(CachedFile *file);
+
+        /// Drops the pages of a file the caller acquired, once the other operations on it are done
+        void drop(CachedFile *file);
+
+        /// Lets the operation that holds the lock finish, the caller looks up again what it was waiting for
+        void wait();
+
+        void destroy(CachedFile *file);
+
+        Page *lookup(CachedFile *file, size_t index);
+
+        void insert(CachedFile *file, Page *page);
+
+        void remove(Page *page);
+
+        /// Clears the slot of the page under node; true if node is left empty
+        bool removeFrom(RadixNode *node, size_t level, size_t index);
+
+        /// Frees a subtree together with its pages
+        void dropTree(RadixNode *node, size_t level);
+
+        /// Calls fn on every page of the subtree, in increasing page index
+        template<typename Fn>
+        void forEach(RadixNode *node, size_t level, Fn fn);
+
+        /// The pinned cached page, or a new one read from the file system if fill is set and zeroed otherwise
+        Page *getPage(CachedFile *file, size_t index, bool fill);
+
+        void unpin(Page *page);
+
+        /// Copies out of the cached pages of an acquired file; the number of bytes read, -1 on error
+        ssize_t readFrom(CachedFile *file, uint8_t *buffer, size_t count, size_t offset);
+
+        /// Copies into the pages of an acquired file and marks them dirty; the number of bytes written
+        size_t writeTo(CachedFile *file, const uint8_t *buffer, size_t count, size_t offset);
+
+        /// Moves the page to the front of the LRU list, unless it is held
+        void touch(Page *page);
+
+        void unlink(Page *page);
+
+        /// Writes back a dirty page that is not busy, the lock is dropped for the write
+        bool writeBack(Page *page);
+
+        /// Evicts least recently used pages, writing back dirty ones, until at most target pages are cached
+        void reclaim(size_t target);
+
+        bool syncFile(CachedFile *file);
+    };
+}
@@ -9,11 +9,101 @@
 
 #include "std/string.h"
 
+/**
+ * @brief A path that is only looked at, nothing is copied or allocated
+ *
+ * Iterating yields the components lazily, as views into the path. Empty components (from repeated '/') and "."
+ * are skipped; ".." is left to the caller, what it means depends on where the walk is.
+ */
+class PathView {
+public:
+    class iterator {
+    public:
+        iterator(std::string_view path, size_t position) : path(path), position(position) {
+            skip();
+        }
+
+        std::string_view operator*() const { return path.substr(position, length); }
+
+        iterator &operator++() {
+            position += length;
+            skip();
+            return *this;
+        }
+
+        bool operator==(const iterator &other) const { return position == other.position; }
+
+        bool operator!=(const iterator &other) const { return position != other.position; }
+
+        /// Offset in the path just past the current component
+        [[nodiscard]] size_t end_offset() const { return position + length; }
+
+    private:
+        std::string_view path;
+        size_t position;
+        size_t length{};
+
+        /// Moves to the next component that is not empty or ".", or to the end
+        void skip() {
+            while (position < path.size()) {
+                if (path[position] == '/') {
+                    position++;
+                    continue;
+                }
+
+                length = 0;
+                while (position + length < path.size() && path[position + length] != '/')
+                    length++;
+                if (length != 1 || path[position] != '.')
+                    return;
+                position += length;
+            }
+            length = 0;
+        }
+    };
+
+    PathView() = default;
+
+    PathView(std::string_view path) : path(path) {}
+
+    [[nodiscard]] iterator begin() const { return {path, 0}; }
+
+    [[nodiscard]] iterator end() const { return {path, path.size()}; }
+
+    [[nodiscard]] std::string_view string() const { return path; }
+
+    [[nodiscard]] bool empty() const { return path.empty(); }
+
+    [[nodiscard]] bool is_absolute() const { return !path.empty() && path[0] == '/'; }
+
+    /**
+     * @brief Returns everything up to the last '/', included; the directory of the last component
+     */
+    [[nodiscard]] std::string_view directory() const { return path.substr(0, last_separator()); }
+
+    /**
+     * @brief Returns the part after the last '/', empty if the path ends with one
+     */
+    [[nodiscard]] std::string_view file_name() const { return path.substr(last_separator()); }
+
+private:
+    std::string_view path;
+
+    [[nodiscard]] size_t last_separator() const {
+        size_t position = path.size();
+        while (position > 0 && path[position - 1] != '/')
+            position--;
+        return position;
+    }
+};
+
 /**
  * @brief Structure to represent a path on the file system
+ *
+ * The path is kept normalized: runs of '/' are collapsed and it ends with a '/'. Short paths are stored inline,
+ * only paths longer than INLINE_CAPACITY allocate.
  */
 struct Path {
-    using position_t = uint16_t; ///< The position type
 
     /**
      * @brief Construct an empty path.
@@ -27,13 +117,15 @@ struct Path {
 
     Path(const Path &base_path, const Path &p);
 
-    Path(const Path &) = default;
+    Path(const Path &other);
+
+    Path(Path &&other) noexcept;
 
-    Path(Path &&) = default;
+    ~Path();
 
-    Path &operator=(const Path &) = default;
+    Path &operator=(const Path &other);
 
-    Path &operator=(Path &&) = default;
+    Path &operator=(Path &&other) noexcept;
 
     Path &operator=(std::string_view rhs);
 
@@ -121,9 +213,22 @@ struct Path {
 
     bool operator!=(std::string_view p) const;
 
+    static constexpr const size_t INLINE_CAPACITY = 64; ///< Paths shorter than this are not allocated
+
 private:
-    std::string base;
-    std::vector<position_t> positions;
+    char small[INLINE_CAPACITY]{};
+    char *data{small}; ///> small, or an allocation for long paths; always null-terminated
+    size_t length{};
+    size_t capacity{INLINE_CAPACITY};
+
+    /// Replaces the path with the normalized concatenation of the two parts, in a single pass
+    void assign(std::string_view first, std::string_view second = {});
+
+    /// Replaces the path with one that is already normalized
+    void copy(std::string_view normalized);
+
+    /// Index of the separator that ends component i
+    [[nodiscard]] size_t separator(size_t i) const;
 };
 
 Path operator/(const Path &lhs, const Path &rhs);
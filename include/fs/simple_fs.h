@@ -15,6 +15,8 @@
 #include "simple_fs_structures.h"
 
 namespace simple_fs {
+    static_assert(BLOCK_SIZE == ata::SECTOR_SIZE, "A block has to be exactly one sector");
+
     /**
      * @brief A class representing the SimpleFS file system
      */
@@ -31,6 +33,24 @@ namespace simple_fs {
         */
         ssize_t create();
 
+        /**
+         * @brief Marks an inode as used or free in the inode bitmap and moves the free cursor accordingly
+         * @param inumber index into inode table
+         * @param used true if the inode is now in use
+        */
+        void mark_inode(size_t inumber, bool used);
+
+        /**
+         * @brief Checks the inode bitmap, without touching the disk
+        */
+        [[nodiscard]] bool inode_in_use(size_t inumber) const;
+
+        /**
+         * @brief Finds the lowest free inode using the inode bitmap, without touching the disk
+         * @return the inumber of a free inode; -1 if the inode table is full
+        */
+        ssize_t find_free_inode();
+
         /**
          * @brief Allocates the first free block from free block bitmap
          * @return block number of the block allocated; 0 if no block is available
@@ -47,40 +67,114 @@ namespace simple_fs {
         ssize_t write_ret(size_t inumber, Inode *node, int ret);
 
         /**
-         * @brief Reads from buffer and writes to a block in the disk
-         * @param offset starts writing at index = offset
-         * @param read bytes read from buffer so far
-         * @param length bytes to be written to the disk
-         * @param data data buffer
-         * @param blocknum index of block in free block bitmap
-         * @return  void function; returns nothing
+         * @brief The indirect block of an inode, read on first use and written back once if modified
         */
-        void read_buffer(int offset, int *read, int length, const uint8_t *data, uint32_t blockNum);
+        struct IndirectBlock {
+            Block block;
+            bool loaded{}; ///> block holds the indirect block of the inode
+            bool dirty{}; ///> block changed and has to be written back
+        };
 
         /**
-         * @brief Allocates a block if required; if no block is available in the disk; returns false
-         * @param node used to set the size of inode in case allocation fails
-         * @param read bytes read from buffer so far
-         * @param orig_offset offset passed to write() function call
-         * @param blockNum index of block in the free block bitmap
-         * @param write_indirect true if the block is an indirect node
-         * @param indirect the indirect node if required
-         * @return true if allocation is successful; false otherwise
+         * @brief Translates a logical block index of a file into the data pointer stored for it
+         * @param node the inode of the file
+         * @param index logical block index inside the file (cluster index for compressed files)
+         * @param indirect caches the indirect block of the node
+         * @return the data pointer; 0 if the block is a hole
         */
-        bool check_allocation(Inode *node, int read, int orig_offset, uint32_t &blockNum, bool write_indirect,
-                              Block indirect);
+        BlockPointer get_block(const Inode &node, uint32_t index, IndirectBlock &indirect);
 
         /**
-         * @brief Reads the block from disk and changes the pointers accordingly
-         * @param blockNum index into the free block bitmap
-         * @param offset start reading from index = offset
-         * @param length number of bytes to be read
-         * @param data data buffer
-         * @param ptr buffer to store the read data
-         * @return void function; returns nothing
+         * @brief Stores a data pointer for a logical block index, allocating the indirect block if needed
+         * @return true on success; false if the indirect block could not be allocated
+        */
+        bool set_block(Inode &node, uint32_t index, BlockPointer ptr, IndirectBlock &indirect);
+
+        /**
+         * @brief Same as get_block(), but fills a hole by allocating the data block
+         * @param allocated set to true if a new data block was allocated
+         * @return block number of the data block; 0 if no block is available
         */
-        void read_helper(uint32_t blockNum, int offset, int *length, uint8_t **data, uint8_t **ptr);
+        BlockPointer map_block(Inode &node, uint32_t index, IndirectBlock &indirect, bool &allocated);
 
+        /**
+         * @brief Allocates the first run of count contiguous free blocks from free block bitmap
+         * @return block number of the first block of the run; 0 if no such run is available
+        */
+        BlockPointer allocate_run(uint32_t count);
+
+        /**
+         * @brief Marks the blocks behind a data pointer in the free block bitmap
+         * @param node the inode owning the pointer, a cluster pointer covers several blocks
+         * @param ptr the data pointer, must not be 0
+         * @param used true if the blocks are now in use
+        */
+        void mark_pointer(const Inode &node, BlockPointer ptr, bool used);
+
+        /**
+         * @brief Allocates the scratch buffers used by compressed files, if not done yet
+        */
+        void alloc_cluster_buffers();
+
+        /**
+         * @brief Reads a cluster from disk and decompresses it if needed
+         * @param ptr the cluster pointer, must not be 0
+         * @param out receives CLUSTER_SIZE bytes
+         * @return false if the compressed data is corrupted
+        */
+        bool load_cluster(BlockPointer ptr, uint8_t *out);
+
+        /**
+         * @brief Compresses a cluster and writes it to disk, in place if it does not grow
+         * @param node the compressed inode owning the cluster
+         * @param old the current cluster pointer; 0 if the cluster is a hole
+         * @param cluster CLUSTER_SIZE bytes of data
+         * @return the new cluster pointer; 0 if no blocks are available
+        */
+        BlockPointer store_cluster(const Inode &node, BlockPointer old, uint8_t *cluster);
+
+        /**
+         * @brief Adds the data extents of an inode to the fragmentation statistics
+        */
+        void count_fragments(const Inode &node, vfs::frag_stat &st);
+
+        /**
+         * @brief Defragments the file whose inode was already loaded into node
+        */
+        bool defrag(size_t inumber, const Inode &node);
+
+        ssize_t read_clusters(const Inode &node, uint8_t *data, int length, size_t offset);
+
+        int write_blocks(Inode &node, const uint8_t *data, int length, size_t offset, IndirectBlock &indirect);
+
+        /**
+         * @brief Locates a byte of inline data, in the inode or in one of its continuation slots
+         * @param node the inline inode, holds the first INLINE_SIZE bytes
+         * @param block the inode block, holds the continuation slots
+         * @param inumber index into the inode table of node
+         * @param offset offset inside the file
+         * @param available receives the number of bytes stored contiguously from there
+         * @return pointer to the byte at offset
+        */
+        uint8_t *inline_segment(Inode &node, Block &block, size_t inumber, size_t offset, size_t &available);
+
+        /**
+         * @brief Checks whether a file of size bytes can be stored inline, with the slots it needs still free
+        */
+        bool inline_fits(const Inode &node, size_t inumber, size_t size);
+
+        /**
+         * @brief Claims or releases the continuation slots after an inline inode to hold size bytes
+        */
+        void resize_inline(Inode &node, Block &block, size_t inumber, size_t size);
+
+        /**
+         * @brief Moves the data of an inline file to regular blocks and clears its continuation slots
+         * @return false if the disk is full
+        */
+        bool spill_inline(Inode &node, Block &block, size_t inumber, IndirectBlock &indirect);
+
+        int write_clusters(Inode &node, const uint8_t *data, int length, size_t offset, IndirectBlock &indirect);
 
         /**
          * @brief Helper function to remove directory from parent directory
@@ -95,11 +189,17 @@ namespace simple_fs {
         std::vector<bool> occupied_block; ///> Bitmap for free blocks
         SuperBlock MetaData{}; ///> File system metadata
         std::vector<int> inode_counter; ///> Stores the number of Inode contained in an Inode Block
+        std::vector<uint64_t> inode_bitmap; ///> One bit per inode, set if the inode is in use. Rebuilt on mount
+        size_t next_free_inode{}; ///> Cursor into inode_bitmap, no inode below it is free
         std::vector<uint32_t> dir_counter; ///> Stores the number of Directory contained in a Directory Block
         Directory curr_dir; ///> Caches the current directory to save a disk-read
         bool isMounted{}; ///> Check whether the filesystem has been mounted
+        bool compress_new_files{}; ///> Per-mount mode, new files are created compressed
+        std::vector<uint8_t> cluster_buffer; ///> Holds one decompressed cluster
+        std::vector<uint8_t> compress_buffer; ///> Holds one compressed cluster
+        std::vector<uint16_t> lz4_table; ///> Hash table of the LZ4 compressor, kept off the kernel stack
 
-        explicit SimpleFS(Disk *disk) : FileSystem(disk) {}
+        explicit SimpleFS(Disk *disk, bool compress = false) : FileSystem(disk), compress_new_files(compress) {}
 
         /**
          * @brief prints the basic outline of the disk
@@ -113,13 +213,20 @@ namespace simple_fs {
         */
         void format();
 
+        /**
+         * @brief Checks for a valid superBlock, e.g. on images prepared by tools/simplefs
+         * @return true if the disk can be mounted without formatting it first
+        */
+        bool formatted();
+
         /**
          * @brief loads inode corresponding to inumber into node
          * @param inumber index into inode table
          * @param node pointer to inode
+         * @param block if not null, receives the whole inode block
          * @return boolean value indicative of success of the load operation
         */
-        bool load_inode(size_t inumber, Inode *node);
+        bool load_inode(size_t inumber, Inode *node, Block *block = nullptr);
 
         /**
          * @brief removes the inode
@@ -183,10 +290,66 @@ namespace simple_fs {
 
         bool ls(std::vector<vfs::file> &contents) override;
 
+        /**
+         * @brief Finds a directory of the current directory, "." and ".." included
+         * @return the number of the directory; ERROR_NOT_EXISTS if there is no directory with that name
+        */
+        std::expected<size_t> openDir(const char name[]) override;
+
+        /**
+         * @brief Fills the valid entries of a directory, the cookie is the slot of its table to start from
+         * @return the number of entries filled; -1 if dir is not a valid directory
+        */
+        ssize_t readDir(size_t dir, size_t cookie, vfs::dir_entry *entries, size_t count) override;
+
         bool rm(const char name[]) override;
 
         ssize_t stat(size_t inumber) override;
 
+        bool stat(size_t inumber, vfs::file_stat &st) override;
+
+        /**
+         * @brief Turns compression on or off for a file, only possible while the file has no data blocks
+         * @return true on success; false if the inode is invalid or already holds data
+        */
+        bool setCompressed(size_t inumber, bool compressed) override;
+
+        /**
+         * @brief Reserves the blocks of [offset, offset + length) without writing them, they read as zeroes
+         * @param keep_size don't extend the file to offset + length
+         * @return true on success; false if the inode is invalid, compressed, or the disk is full
+        */
+        bool fallocate(size_t inumber, size_t offset, size_t length, bool keep_size) override;
+
+        /**
+         * @brief Copies [src_offset, src_offset + length) of one file into another block by block, without going
+         * through the page cache; holes of the source stay holes
+         * @return the number of bytes copied, less than length at the end of the source or if the disk is full;
+         * -1 if the files are the same, compressed or inline, or the offsets are not block aligned
+        */
+        ssize_t copyRange(size_t src_inumber, size_t src_offset, size_t dst_inumber, size_t dst_offset,
+                          size_t length) override;
+
+        /**
+         * @brief Computes the fragmentation of a file or, without inumber, of the whole file system
+         * @return false if the inode is invalid
+        */
+        bool fragmentation(size_t inumber, vfs::frag_stat &st) override;
+
+        bool fragmentation(vfs::frag_stat &st) override;
+
+        /**
+         * @brief Moves the data of a file into one contiguous run, copying it before switching the inode over
+         * @return false if the inode is invalid or there is no free run large enough
+        */
+        bool defrag(size_t inumber) override;
+
+        /**
+         * @brief Defragments every file
+         * @return false if some file could not be defragmented
+        */
+        bool defrag() override;
+
         std::string pwd() override;
 
         void test() override;
@@ -9,10 +9,14 @@
 
 #include "util/types.h"
 #include "std/array.h"
+#include "std/algorithm.h"
+
+/* This header only describes the on-disk format, it is shared with the host tools in tools/simplefs,
+ * so it must not depend on other kernel code */
 
 namespace simple_fs {
     const constexpr uint32_t MAGIC_NUMBER = 0xf0f03410; ///> Magic number helps in checking Validity of the FileSystem on disk
-    const constexpr uint32_t BLOCK_SIZE = ata::SECTOR_SIZE; ///> The size of a block is equal to the size of a sector on disk
+    const constexpr uint32_t BLOCK_SIZE = 512; ///> The size of a block is equal to the size of a sector on disk
     const constexpr uint32_t POINTERS_PER_INODE = 5; ///> Number of Direct block pointers in an Inode Block
 
     using BlockPointer = uint32_t;
@@ -20,6 +24,48 @@ namespace simple_fs {
             BLOCK_SIZE / sizeof(BlockPointer); ///> Number of block pointers in one Indirect pointer
     const constexpr uint32_t NAME_SIZE = 16; /// Max Name size for a dentry
 
+    const constexpr uint32_t INODE_VALID = 0x1; ///> Set in Inode::Valid for every inode in use
+    const constexpr uint32_t INODE_COMPRESSED = 0x2; ///> The data pointers of the inode are cluster pointers
+    const constexpr uint32_t INODE_INLINE = 0x4; ///> The data is stored in the pointer area of the inode, see Inode
+    const constexpr uint32_t INODE_CONTINUATION = 0x8; ///> Slot holding inline data of a previous inode, not a file
+
+    const constexpr BlockPointer POINTER_UNWRITTEN = 1u << 31; ///> Preallocated block, reads as zeroes until written
+
+    const constexpr uint32_t CLUSTER_BLOCKS = 4; ///> Number of data blocks compressed together
+    const constexpr uint32_t CLUSTER_SIZE = CLUSTER_BLOCKS * BLOCK_SIZE; ///> Logical bytes in one cluster
+
+    /**
+     * Cluster pointers
+     *
+     * Compressed files use their Direct and Indirect pointers as a cluster map, one pointer per CLUSTER_SIZE bytes.
+     * Block numbers fit in 28 bits, the two bits above hold the number of blocks the cluster occupies minus one.
+     * The blocks of a cluster are contiguous and start with a 2-byte length followed by the LZ4 data,
+     * unless the cluster occupies all CLUSTER_BLOCKS blocks, in which case it is stored uncompressed.
+    */
+    namespace cluster {
+        const constexpr uint32_t BLOCK_BITS = 28;
+        const constexpr uint32_t BLOCK_MASK = (1u << BLOCK_BITS) - 1;
+        const constexpr uint32_t HEADER_SIZE = sizeof(uint16_t); ///> Compressed length stored before the LZ4 data
+
+        constexpr BlockPointer make(BlockPointer start, uint32_t blocks) {
+            return start | ((blocks - 1) << BLOCK_BITS);
+        }
+
+        constexpr BlockPointer start(BlockPointer ptr) {
+            return ptr & BLOCK_MASK;
+        }
+
+        constexpr uint32_t blocks(BlockPointer ptr) {
+            return ((ptr >> BLOCK_BITS) & 0x3) + 1;
+        }
+
+        constexpr bool is_raw(BlockPointer ptr) {
+            return blocks(ptr) == CLUSTER_BLOCKS;
+        }
+
+        static_assert(CLUSTER_BLOCKS <= 4, "The block count of a cluster has to fit in 2 bits");
+    }
+
 
     /**
      * Inode Structure
@@ -29,7 +75,7 @@ namespace simple_fs {
      * Stores the sectors of the file.
     */
     struct Inode {
-        uint32_t Valid; ///> Whether or not inode is valid
+        uint32_t Valid; ///> INODE_VALID and the INODE_* flags of the inode; 0 if the inode is free
         uint32_t Size; ///> The logical size of the file in bytes
         std::array<BlockPointer, POINTERS_PER_INODE> Direct; ///> 5 direct pointers to data blocks
         BlockPointer Indirect; ///> One indirect pointer
@@ -39,10 +85,57 @@ namespace simple_fs {
             std::fill(Direct.begin(), Direct.end(), 0);
             Indirect = 0;
         }
+
+        /**
+         * @brief Finds the blocks behind a non-null data pointer of this inode
+         * @param start receives the first block
+         * @param count receives the number of blocks, more than one only for clusters of compressed files
+         */
+        void extent(BlockPointer ptr, BlockPointer &start, uint32_t &count) const {
+            start = ptr & ~POINTER_UNWRITTEN;
+            count = 1;
+            if (Valid & INODE_COMPRESSED) {
+                start = cluster::start(ptr);
+                count = cluster::blocks(ptr);
+            }
+        }
+        /**
+         * @brief The Direct and Indirect pointers of an inline file hold its first INLINE_SIZE bytes
+         */
+        uint8_t *inline_data() {
+            return reinterpret_cast<uint8_t *>(Direct.data());
+        }
+
+        /**
+         * @brief The rest of a continuation slot after its Valid field holds CONTINUATION_SIZE bytes
+         */
+        uint8_t *continuation_data() {
+            return reinterpret_cast<uint8_t *>(&Size);
+        }
         // Pointer means the number of the block where the data can be found
         // 0 indicated null block pointer
     };
 
+    /**
+     * Inline data
+     *
+     * Files of at most INLINE_MAX_SIZE bytes keep their data in the inode block, so reading or writing them
+     * costs a single inode block access. The data starts in the pointer area of the inode and continues
+     * in the free inode slots right after it in the same block, which are marked with INODE_CONTINUATION.
+    */
+    const constexpr uint32_t INLINE_SIZE = sizeof(BlockPointer) * (POINTERS_PER_INODE + 1);
+    const constexpr uint32_t CONTINUATION_SIZE = sizeof(Inode) - sizeof(uint32_t);
+    const constexpr uint32_t MAX_CONTINUATION_SLOTS = 3;
+    const constexpr uint32_t INLINE_MAX_SIZE = INLINE_SIZE + MAX_CONTINUATION_SLOTS * CONTINUATION_SIZE;
+    static_assert(__builtin_offsetof(Inode, Indirect) ==
+                  __builtin_offsetof(Inode, Direct) + INLINE_SIZE - sizeof(BlockPointer),
+                  "The inline area has to be contiguous");
+
+    /// Number of continuation slots needed to store size bytes inline
+    constexpr uint32_t inline_slots(size_t size) {
+        return size <= INLINE_SIZE ? 0 : (size - INLINE_SIZE + CONTINUATION_SIZE - 1) / CONTINUATION_SIZE;
+    }
+
     const constexpr uint32_t INODES_PER_BLOCK =
             BLOCK_SIZE / sizeof(Inode); ///> Number of Inodes which can be contained in a block
     static_assert(INODES_PER_BLOCK * sizeof(Inode) == BLOCK_SIZE);
@@ -121,10 +214,6 @@ namespace simple_fs {
             for (auto &it: Name)
                 it = 0;
         }
-
-        vfs::file toFile() {
-            return {Name, isFile, inum};
-        }
     };
 
     static_assert(sizeof(Dirent) == 24); // TODO
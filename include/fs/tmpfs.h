@@ -0,0 +1,143 @@
+/*
+ * tmpfs.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "file_system.h"
+#include "arch/x86_64/paging_constants.h"
+
+namespace tmpfs {
+    constexpr const size_t CHUNK_SIZE = paging::PAGE_SIZE; ///< File data is allocated a page at a time
+
+    /**
+     * @brief A file system that lives in kernel memory only, nothing reaches a disk
+     *
+     * Files keep their data in page sized chunks, chunks that were never written are holes and read as zeroes.
+     * Directories are hash maps from names to nodes, chained and doubled when they get as many entries as buckets.
+     * Nodes are numbered by their index in a table, numbers of removed nodes are reused.
+     * Names are looked up from the current directory and may contain several components, "." and ".." included.
+     */
+    class TmpFS : public vfs::FileSystem {
+    public:
+        TmpFS();
+
+        ~TmpFS() override;
+
+        TmpFS(const TmpFS &) = delete;
+
+        TmpFS &operator=(const TmpFS &) = delete;
+
+        void mount() override;
+
+        /// @return bytes read, less than length at the end of the file; -1 if inum is not a file
+        ssize_t read(size_t inum, uint8_t *buffer, int length, size_t offset) override;
+
+        /// @return bytes written; -1 if inum is not a file
+        ssize_t write(size_t inum, const uint8_t *data, int length, size_t offset) override;
+
+        bool ls(std::vector<vfs::file> &contents) override;
+
+        bool touch(const char *name) override;
+
+        bool mkdir(const char name[]) override;
+
+        bool rm(const char name[]) override;
+
+        std::expected<size_t> getInode(const char *name) override;
+
+        /// Removes a directory together with everything inside of it
+        bool rmdir(const char name[]) override;
+
+        bool cd(const char name[]) override;
+
+        ssize_t stat(size_t inum) override;
+
+        bool stat(size_t inum, vfs::file_stat &st) override;
+
+        /// Allocates the chunks of the range, they read as zeroes
+        bool fallocate(size_t inum, size_t offset, size_t length, bool keep_size) override;
+
+        std::expected<size_t> openDir(const char *name) override;
+
+        /// The cookie is 0 for ".", 1 for ".." and the serial number of an entry after that
+        ssize_t readDir(size_t dir, size_t cookie, vfs::dir_entry *entries, size_t count) override;
+
+        /// The current directory relative to the root, "/" at the root
+        std::string pwd() override;
+
+        void test() override;
+
+    private:
+        static constexpr const size_t FIRST_SERIAL = 2; ///> Cookies below are "." and ".."
+        static constexpr const size_t MIN_BUCKETS = 8;
+
+        struct Entry;
+
+        struct Node {
+            size_t inum{};
+            bool isFile{};
+            Node *parent{}; ///> The directory holding the node, the root is its own parent
+            Entry *entry{}; ///> The entry of the node in its parent, nullptr for the root
+
+            /// Files
+            size_t size{};
+            std::vector<uint8_t *> chunks; ///> nullptr for holes
+
+            /// Directories
+            std::vector<Entry *> buckets;
+            size_t entries{};
+            Entry *first{}, *last{}; ///> Entries in the order they were added, listings follow it
+            size_t nextSerial{FIRST_SERIAL};
+            Entry *resume{}; ///> Where the last readDir stopped, the next one starts there without a walk
+        };
+
+        struct Entry {
+            std::string name;
+            size_t hash{};
+            size_t serial{}; ///> Grows with every entry of the directory, its cookie for readDir
+            Node *node{};
+            Entry *chain{}; ///> Next entry of the bucket
+            Entry *prev{}, *next{}; ///> Neighbours in the order of the directory
+        };
+
+        std::vector<Node *> nodes; ///> Indexed by inum, nullptr for free numbers
+        std::vector<size_t> freeInums;
+        Node *root{};
+        Node *current{};
+
+        Node *allocate(bool isFile, Node *parent);
+
+        /// Frees the node, its data and, for a directory, everything inside of it
+        void release(Node *node);
+
+        /// The node of a valid inum, of the given kind; nullptr otherwise
+        Node *get(size_t inum, bool isFile) const;
+
+        static Entry *lookup(const Node *dir, std::string_view name, size_t hash);
+
+        void link(Node *dir, std::string_view name, Node *node);
+
+        void unlink(Node *dir, Entry *entry);
+
+        /// Doubles the buckets of a directory and rehashes its entries
+        static void grow(Node *dir);
+
+        /// Walks a path from the current directory; nullptr if a component is missing or is not a directory
+        Node *walk(std::string_view path) const;
+
+        /// Splits the last component off a path, returns the directory that holds it
+        Node *parentOf(const char *path, std::string_view &name) const;
+
+        /// Makes a node under a new name; false if the name exists or its directory doesn't
+        bool create(const char *path, bool isFile);
+
+        /// Removes a node of the given kind
+        bool remove(const char *path, bool isFile);
+
+        /// The chunk holding offset, allocated (zeroed) if missing
+        uint8_t *chunk(Node *file, size_t offset);
+    };
+}
@@ -37,7 +37,8 @@
  *
  * ABOUT VIRTUAL FILE SYSTEMS IN GENERAL:
  * https://wiki.osdev.org/VFS
- * We are going to use a Mount Point List
+ * We are going to use a Mount Point List, searched through a trie of the mount points (see mount_table.h)
+ * Relative paths, ls and pwd use the mount of the current directory
  */
 
 
@@ -49,6 +50,7 @@ namespace vfs {
     */
     enum class PartitionType {
         SIMPLE_FS = 1, /// SimpleFS
+        TMPFS = 2, ///< Kept in memory only, it needs no disk
         UNKNOWN = 100 ///< Unknown file system
     };
 
@@ -67,10 +69,33 @@ namespace vfs {
     void init(Disk *disk);
 
     constexpr const size_t OPEN_CREATE = 0x1;
+    constexpr const size_t OPEN_COMPRESSED = 0x2; ///< Store the data of a new file compressed
+    constexpr const size_t OPEN_APPEND = 0x4; ///< Every write without an explicit offset goes to the end of the file
+    constexpr const size_t OPEN_DIRECTORY = 0x8; ///< Open a directory, to be listed with getdents
+
+    /**
+     * @brief Opens a file under the lowest free descriptor of the current process, with its offset at 0
+     */
     std::expected<fd_t> open(const char *filePath, size_t flags);
 
+    /**
+     * @brief Writes back the cached data of the file and releases the descriptor
+     */
     void close(fd_t fd);
 
+    /**
+     * @brief Writes back the data of an open file that is only in the page cache
+     */
+    std::expected<void> sync(fd_t fd);
+
+    /**
+     * @brief Writes back every dirty page of the page cache
+     */
+    std::expected<void> sync();
+
+    constexpr const fd_t SYNC_ALL = ~0ULL; ///< Descriptor for the sync system call that writes back every file
+
+    /// The current directory, with the mount point of its file system in front
     std::string pwd();
 
     std::expected<void> mkdir(const char *file);
@@ -79,16 +104,128 @@ namespace vfs {
 
     std::expected<void> rmDir(const char* file);
 
-    std::expected<size_t> read(fd_t fd, uint8_t *buffer, size_t count, size_t offset = 0);
+    /**
+     * @brief Reads from the offset of the open file and moves it past the bytes read
+     * @return the number of bytes read, less than count at the end of the file
+     */
+    std::expected<size_t> read(fd_t fd, uint8_t *buffer, size_t count);
+
+    /**
+     * @brief Writes at the offset of the open file, or at its end with OPEN_APPEND, and moves the offset past the data
+     */
+    std::expected<size_t> write(fd_t fd, const uint8_t *buffer, size_t count);
 
-    std::expected<size_t> write(fd_t fd, const uint8_t *buffer, size_t count, size_t offset = 0);
+    /**
+     * @brief Reads at an explicit offset, the offset of the open file does not change
+     */
+    std::expected<size_t> pread(fd_t fd, uint8_t *buffer, size_t count, size_t offset);
+
+    /**
+     * @brief Writes at an explicit offset, the offset of the open file does not change
+     */
+    std::expected<size_t> pwrite(fd_t fd, const uint8_t *buffer, size_t count, size_t offset);
+
+    constexpr const size_t IOV_MAX = 1024; ///< The most buffers a vectored read or write takes
+
+    /**
+     * @brief Reads from the offset of the open file into the buffers in order, like one read of their total length
+     * @return the number of bytes read, less than the total length at the end of the file
+     */
+    std::expected<size_t> readv(fd_t fd, const io_vec *vec, size_t count);
+
+    /**
+     * @brief Writes the buffers in order at the offset of the open file, like one write of their total length
+     */
+    std::expected<size_t> writev(fd_t fd, const io_vec *vec, size_t count);
+
+    /**
+     * @brief Copies [src_offset, src_offset + length) of one open file into another without leaving the kernel,
+     * the offsets of the open files don't change
+     *
+     * The file system copies the blocks itself when it can, otherwise the data goes through the page cache.
+     * Overlapping ranges of the same file are refused.
+     * @return the number of bytes copied, less than length at the end of the source
+     */
+    std::expected<size_t> copy_range(fd_t src_fd, size_t src_offset, fd_t dst_fd, size_t dst_offset, size_t length);
+
+    constexpr const size_t SEEK_SET = 0; ///< The offset is relative to the start of the file
+    constexpr const size_t SEEK_CUR = 1; ///< The offset is relative to the current offset
+    constexpr const size_t SEEK_END = 2; ///< The offset is relative to the end of the file
+
+    /**
+     * @brief Moves the offset of an open file, it may go past the end of the file
+     * @return the new offset
+     */
+    std::expected<size_t> seek(fd_t fd, ssize_t offset, size_t whence);
 
     std::expected<void> ls(std::vector<file>& contents);
 
-    std::expected<void> mount(PartitionType type, const char *mount_point, Disk *disk);
+    /**
+     * @brief Packs the entries of a directory opened with OPEN_DIRECTORY into buffer, as dirent_record records
+     *
+     * The listing goes on from the offset of the open file, which is the cookie of the last entry returned; seeking
+     * to the cookie of any record lists again from the entry after it. Entries are gathered in small batches on the
+     * stack, nothing is allocated per entry.
+     * @return the number of bytes used, 0 at the end of the directory; ERROR_BUFFER_SMALL if not even the next
+     * record fits
+     */
+    std::expected<size_t> getdents(fd_t fd, uint8_t *buffer, size_t length);
+
+    constexpr const size_t MOUNT_COMPRESS = 0x1; ///< Files created on this mount are compressed
+    std::expected<void> mount(PartitionType type, const char *mount_point, Disk *disk, size_t flags = 0);
 
     // vfs should not have cd, it should be independent
     std::expected<void> cd(const char* dir);
 
     std::expected<ssize_t> stat(fd_t fd);
+
+    /**
+     * @brief Fills st with the logical size and the number of allocated blocks of the file
+     */
+    std::expected<void> stat(fd_t fd, file_stat &st);
+
+    /**
+     * @brief Computes the fragmentation of a file, or of the root file system if file_path is nullptr
+     */
+    std::expected<void> fragmentation(const char *file_path, frag_stat &st);
+
+    /**
+     * @brief Moves the data of a file, or of every file of the root file system if file_path is nullptr,
+     * into contiguous runs
+     */
+    std::expected<void> defrag(const char *file_path);
+
+    constexpr const size_t DEFRAG_REPORT_ONLY = 0x1; ///< Flag of the defrag system call, only report fragmentation
+
+    /**
+     * @brief Reserves disk space for [offset, offset + length) of a file without writing it, the range reads as zeroes
+     */
+    std::expected<void> fallocate(fd_t fd, size_t offset, size_t length, size_t flags = 0);
+
+    constexpr const size_t FALLOCATE_KEEP_SIZE = 0x1; ///< Don't change the size of the file, only reserve the space
+
+    constexpr const size_t PROT_READ = 0x1; ///< The mapping can be read
+    constexpr const size_t PROT_WRITE = 0x2; ///< The mapping can be written
+    constexpr const size_t MAP_SHARED = 0x10; ///< Writes to the mapping go to the file
+    constexpr const size_t MAP_PRIVATE = 0x20; ///< Writes to the mapping go to private copies of the pages
+
+    /**
+     * @brief Maps [offset, offset + length) of an open file into memory, nothing is read until it is accessed
+     *
+     * Pages are faulted in one at a time and are the pages of the page cache themselves, so mappings of the same
+     * file share memory with each other and with read and write. flags holds PROT_* and one of MAP_SHARED or
+     * MAP_PRIVATE; the offset has to be page aligned. Accessing pages past the end of the file is a fault.
+     * @return the address of the mapping
+     */
+    std::expected<void *> mmap(fd_t fd, size_t length, size_t flags, size_t offset);
+
+    /**
+     * @brief Removes a whole mapping, dirty pages of shared mappings stay in the page cache until written back
+     */
+    std::expected<void> munmap(void *address, size_t length);
+
+    /**
+     * @brief Writes back the file of a shared mapping, pages written from now on are tracked again
+     */
+    std::expected<void> msync(void *address, size_t length);
 }
\ No newline at end of file
@@ -7,6 +7,9 @@
 
 
 #include "fs/vfs.h"
+#include "fs/page_cache.h"
+#include "fs/mount_table.h"
+#include "fs/io_ring.h"
 #include "fs/simple_fs_structures.h"
 
 namespace vfs {
@@ -30,17 +33,497 @@ namespace vfs {
 
         constexpr const size_t SIZE_TO_WRITE = BLOCK_SIZE;
         uint8_t data[SIZE_TO_WRITE] = {1, 2, 3, 4, 5};
-        auto writtenBytes = vfs::write(fd.value(), data, SIZE_TO_WRITE, 0);
+        auto writtenBytes = vfs::write(fd.value(), data, SIZE_TO_WRITE);
         kAssert(writtenBytes && *writtenBytes == SIZE_TO_WRITE, "[VFS] Write operation failed");
 
+        auto offset = vfs::seek(fd.value(), 0, SEEK_SET);
+        kAssert(offset && *offset == 0, "[VFS] Seek failed");
+
         uint8_t buffer[BLOCK_SIZE] = {};
-        auto readBytes = vfs::read(fd.value(), buffer, SIZE_TO_WRITE, 0);
+        auto readBytes = vfs::read(fd.value(), buffer, SIZE_TO_WRITE);
         kAssert(readBytes && *readBytes == SIZE_TO_WRITE && std::equal(data, data + SIZE_TO_WRITE, buffer),
                 "[VFS] Data mismatch on read back");
 
         vfs::close(fd.value());
     }
 
+    void test_file_descriptors() {
+        auto first = vfs::open("fd_file1", OPEN_CREATE);
+        auto second = vfs::open("fd_file1", 0);
+        kAssert(first && second && *first != *second, "[VFS] Failed to open file twice");
+
+        // Each descriptor has its own offset
+        const uint8_t data[] = "0123456789";
+        auto written = vfs::write(*first, data, 10);
+        kAssert(written && *written == 10, "[VFS] Write operation failed");
+
+        uint8_t buffer[10] = {};
+        auto readBytes = vfs::read(*second, buffer, 4);
+        kAssert(readBytes && *readBytes == 4 && buffer[0] == '0', "[VFS] Read at the start failed");
+        readBytes = vfs::read(*second, buffer, 10);
+        kAssert(readBytes && *readBytes == 6 && buffer[0] == '4', "[VFS] Read should continue and stop at the end");
+
+        auto offset = vfs::seek(*second, -2, SEEK_END);
+        kAssert(offset && *offset == 8, "[VFS] Seek from the end failed");
+
+        // The lowest free descriptor is reused
+        vfs::close(*first);
+        auto appender = vfs::open("fd_file1", OPEN_APPEND);
+        kAssert(appender && *appender == *first, "[VFS] Lowest free descriptor was not reused");
+
+        written = vfs::write(*appender, data, 2);
+        kAssert(written && vfs::stat(*appender).value() == 12, "[VFS] Append should write at the end");
+
+        vfs::close(*appender);
+        vfs::close(*second);
+        vfs::rm("fd_file1");
+        kAssert(!vfs::read(*second, buffer, 1), "[VFS] Closed descriptor should be invalid");
+    }
+
+    void test_page_cache() {
+        constexpr const size_t PAGE = PageCache::PAGE_SIZE;
+        constexpr const size_t SIZE = 3 * PAGE + 100;
+        auto &cache = PageCache::instance();
+
+        auto fd = vfs::open("cached_file1", OPEN_CREATE);
+        kAssert(fd, "[VFS] Failed to open file for caching");
+
+        auto *data = new uint8_t[SIZE];
+        auto *buffer = new uint8_t[SIZE];
+        for (size_t i = 0; i < SIZE; i++)
+            data[i] = i * 7 + 3;
+
+        auto written = vfs::pwrite(*fd, data, SIZE, 0);
+        kAssert(written && *written == SIZE, "[VFS] Write operation failed");
+        kAssert(vfs::stat(*fd).value() == SIZE, "[VFS] Size should include data that is not written back");
+
+        // Everything comes from the dirty pages
+        auto before = cache.stats();
+        auto readBytes = vfs::pread(*fd, buffer, SIZE, 0);
+        kAssert(readBytes && *readBytes == SIZE && std::equal(data, data + SIZE, buffer),
+                "[VFS] Data mismatch on cached read");
+        kAssert(cache.stats().misses == before.misses && cache.stats().hits == before.hits + 4,
+                "[VFS] Read should be served from the cache");
+
+        kAssert(vfs::sync(*fd) && cache.stats().dirty == 0, "[VFS] Sync should write back every page");
+
+        // A tiny budget pushes the pages out, they are read back from the disk
+        cache.setBudget(2);
+        kAssert(cache.stats().pages <= 2 && cache.stats().evictions > before.evictions, "[VFS] Reclaim failed");
+        std::fill(buffer, buffer + SIZE, 0);
+        readBytes = vfs::pread(*fd, buffer, SIZE, 0);
+        kAssert(readBytes && *readBytes == SIZE && std::equal(data, data + SIZE, buffer),
+                "[VFS] Data mismatch after reclaim");
+
+        // Dirty pages that are reclaimed are written back first
+        written = vfs::pwrite(*fd, data, 10, PAGE + 5);
+        kAssert(written && *written == 10, "[VFS] Partial write failed");
+        for (size_t i = 0; i < 4; i++)
+            vfs::pread(*fd, buffer, 1, (i % 2) * 2 * PAGE);
+        cache.setBudget(PageCache::DEFAULT_BUDGET);
+
+        readBytes = vfs::pread(*fd, buffer, PAGE, PAGE);
+        kAssert(readBytes && *readBytes == PAGE && std::equal(data, data + 10, buffer + 5) &&
+                std::equal(data + PAGE, data + PAGE + 5, buffer) &&
+                std::equal(data + PAGE + 15, data + 2 * PAGE, buffer + 15), "[VFS] Partial page was not merged");
+
+        vfs::close(*fd);
+        vfs::rm("cached_file1");
+        delete[] data;
+        delete[] buffer;
+    }
+
+    void test_vectored_io() {
+        auto fd = vfs::open("vectored_file1", OPEN_CREATE);
+        kAssert(fd, "[VFS] Failed to open file for vectored io");
+
+        // Records of a header and a payload, each record written with one call
+        uint8_t header[4], payload[300];
+        for (size_t i = 0; i < sizeof(payload); i++)
+            payload[i] = i * 3;
+        for (uint8_t record = 0; record < 20; record++) {
+            std::fill(header, header + sizeof(header), record);
+            io_vec vec[] = {{header, sizeof(header)}, {nullptr, 0}, {payload, sizeof(payload)}};
+            auto written = vfs::writev(*fd, vec, 3);
+            kAssert(written && *written == sizeof(header) + sizeof(payload), "[VFS] writev failed");
+        }
+
+        // Read back with buffers that cut the records at other places, the last read stops at the end of the file
+        vfs::seek(*fd, 0, SEEK_SET);
+        constexpr const size_t RECORD = sizeof(header) + sizeof(payload);
+        uint8_t first[RECORD + 1], second[3 * RECORD];
+        auto *rest = new uint8_t[20 * RECORD];
+        io_vec vec[] = {{first, sizeof(first)}, {second, sizeof(second)}, {rest, 20 * RECORD}};
+        auto read = vfs::readv(*fd, vec, 3);
+        kAssert(read && *read == 20 * RECORD && *vfs::seek(*fd, 0, SEEK_CUR) == 20 * RECORD, "[VFS] readv failed");
+
+        auto byte = [&](size_t position) {
+            if (position < sizeof(first))
+                return first[position];
+            position -= sizeof(first);
+            return position < sizeof(second) ? second[position] : rest[position - sizeof(second)];
+        };
+        for (size_t position = 0; position < 20 * RECORD; position++) {
+            size_t in_record = position % RECORD;
+            uint8_t expected = in_record < sizeof(header) ? position / RECORD : payload[in_record - sizeof(header)];
+            kAssert(byte(position) == expected, "[VFS] Vectored data mismatch");
+        }
+
+        kAssert(!vfs::writev(*fd, vec, IOV_MAX + 1), "[VFS] Too many buffers should be refused");
+        vfs::close(*fd);
+        vfs::rm("vectored_file1");
+        delete[] rest;
+    }
+
+    void test_copy_range() {
+        auto src = vfs::open("copy_source1", OPEN_CREATE);
+        auto dst = vfs::open("copy_target1", OPEN_CREATE);
+        kAssert(src && dst, "[VFS] Failed to open files for copying");
+
+        // Three blocks of data, a hole up to the third page and a last partial block
+        constexpr const size_t PAGE = PageCache::PAGE_SIZE;
+        constexpr const size_t SIZE = 2 * PAGE + 100;
+        auto *data = new uint8_t[SIZE]{};
+        for (size_t i = 0; i < SIZE; i++) {
+            if (i < 3 * BLOCK_SIZE || i >= 2 * PAGE)
+                data[i] = i % 251 + 1;
+        }
+        vfs::pwrite(*src, data, 3 * BLOCK_SIZE, 0);
+        vfs::pwrite(*src, data + 2 * PAGE, 100, 2 * PAGE);
+
+        // Aligned offsets are copied by the file system, the hole stays a hole
+        auto copied = vfs::copy_range(*src, 0, *dst, 0, 2 * SIZE);
+        kAssert(copied && *copied == SIZE, "[VFS] copy_range should stop at the end of the source");
+        auto *buffer = new uint8_t[SIZE];
+        auto read = vfs::pread(*dst, buffer, SIZE, 0);
+        kAssert(read && *read == SIZE && std::equal(data, data + SIZE, buffer), "[VFS] Copied data mismatch");
+        file_stat src_st, dst_st;
+        kAssert(vfs::stat(*src, src_st) && vfs::stat(*dst, dst_st) && dst_st.blocks == src_st.blocks &&
+                dst_st.blocks * dst_st.blockSize < SIZE, "[VFS] The hole should not be copied into blocks");
+
+        // Unaligned offsets go through the page cache
+        copied = vfs::copy_range(*src, 10, *dst, SIZE + 3, SIZE - 10);
+        read = vfs::pread(*dst, buffer, SIZE - 10, SIZE + 3);
+        kAssert(copied && *copied == SIZE - 10 && read && *read == SIZE - 10 &&
+                std::equal(data + 10, data + SIZE, buffer), "[VFS] Unaligned copy mismatch");
+
+        kAssert(!vfs::copy_range(*src, 0, *src, BLOCK_SIZE, 2 * BLOCK_SIZE), "[VFS] Overlapping copy should fail");
+        copied = vfs::copy_range(*src, 0, *src, SIZE, BLOCK_SIZE);
+        kAssert(copied && *copied == BLOCK_SIZE, "[VFS] Copy inside a file failed");
+
+        vfs::close(*src);
+        vfs::close(*dst);
+        vfs::rm("copy_source1");
+        vfs::rm("copy_target1");
+        delete[] data;
+        delete[] buffer;
+    }
+
+    void test_io_ring() {
+        auto ring = vfs::ring_setup(3);
+        kAssert(ring && (*ring)->entries == 4, "[VFS] Ring setup failed");
+        io_ring &r = **ring;
+
+        auto submit = [&r](uint8_t opcode, uint64_t fd, const void *address, uint64_t length, uint64_t offset) {
+            r.submissions[r.sq_tail % r.entries] = {opcode, {}, fd, (uint64_t) address, length, offset, r.sq_tail};
+            r.sq_tail++;
+        };
+        auto complete = [&r](int64_t &result) {
+            if (r.cq_head == r.cq_tail)
+                return false;
+            result = r.completions[r.cq_head % (2 * r.entries)].result;
+            r.cq_head++;
+            return true;
+        };
+
+        int64_t fd;
+        submit(RING_OPEN, 0, "ring_file1", OPEN_CREATE, 0);
+        kAssert(*vfs::ring_enter(*ring, 1) == 1 && complete(fd) && fd >= 0, "[VFS] Open through the ring failed");
+
+        // A batch of writes, one at an explicit offset and two at the offset of the file, and a read
+        const char *text = "0123456789";
+        char buffer[8] = {};
+        submit(RING_WRITE, fd, text, 4, 6);
+        submit(RING_WRITE, fd, text, 3, RING_CURRENT_OFFSET);
+        submit(RING_WRITE, fd, text + 3, 3, RING_CURRENT_OFFSET);
+        submit(RING_READ, fd, buffer, 8, 2);
+        kAssert(*vfs::ring_enter(*ring, 4) == 4, "[VFS] Ring batch was not submitted");
+
+        int64_t results[4];
+        for (auto &result: results)
+            kAssert(complete(result), "[VFS] Missing completion");
+        kAssert(results[0] == 4 && results[1] == 3 && results[2] == 3 && results[3] == 8 &&
+                std::equal(buffer, buffer + 8, "23450123"), "[VFS] Ring results mismatch");
+
+        // Submissions wait while every completion slot is taken
+        int64_t result;
+        for (size_t i = 0; i < 2 * r.entries; i++) {
+            submit(RING_NOP, 0, nullptr, 0, 0);
+            kAssert(*vfs::ring_enter(*ring, 1) == 1, "[VFS] Nop was not submitted");
+        }
+        submit(RING_CLOSE, fd, nullptr, 0, 0);
+        kAssert(*vfs::ring_enter(*ring, 1) == 0, "[VFS] Completion ring overflowed");
+        for (size_t i = 0; i < 2 * r.entries; i++)
+            complete(result);
+        kAssert(*vfs::ring_enter(*ring, 1) == 1 && complete(result) && result == 0, "[VFS] Close failed");
+
+        submit(RING_CLOSE, fd, nullptr, 0, 0);
+        kAssert(*vfs::ring_enter(*ring, 1) == 1 && complete(result) &&
+                result == -(int64_t) std::ERROR_INVALID_FILE_DESCRIPTOR, "[VFS] Second close should fail");
+
+        // Only the indexes are read back from the header, the rest can't send the kernel elsewhere
+        auto submissions = r.submissions;
+        auto completions = r.completions;
+        submit(RING_NOP, 0, nullptr, 0, 0);
+        r.entries = 1 << 20;
+        r.submissions = nullptr;
+        r.completions = nullptr;
+        kAssert(*vfs::ring_enter(*ring, 1) == 1, "[VFS] Nop was not submitted");
+        r.entries = 4;
+        r.submissions = submissions;
+        r.completions = completions;
+        kAssert(complete(result) && result == 0, "[VFS] Nop failed");
+        r.sq_tail += 2 * r.entries;
+        kAssert(!vfs::ring_enter(*ring, 1), "[VFS] Ring took a tail past its entries");
+        r.sq_tail -= 2 * r.entries;
+
+        kAssert(vfs::ring_destroy(*ring) && !vfs::ring_enter(*ring, 1), "[VFS] Ring was not destroyed");
+        vfs::rm("ring_file1");
+    }
+
+    void test_mmap() {
+        constexpr const size_t PAGE = PageCache::PAGE_SIZE;
+
+        auto fd = vfs::open("mapped_file1", OPEN_CREATE);
+        kAssert(fd, "[VFS] Failed to open file for mapping");
+
+        uint8_t data[64];
+        for (size_t i = 0; i < sizeof(data); i++)
+            data[i] = i + 1;
+        vfs::pwrite(*fd, data, sizeof(data), 0);
+        vfs::pwrite(*fd, data, sizeof(data), 2 * PAGE);
+
+        // Pages are faulted in on the first access
+        auto shared = vfs::mmap(*fd, 2 * PAGE + sizeof(data), PROT_READ | MAP_PRIVATE, 0);
+        kAssert(shared, "[VFS] Failed to map file");
+        auto *bytes = (uint8_t *) *shared;
+        kAssert(std::equal(data, data + sizeof(data), bytes) && bytes[PAGE] == 0 &&
+                std::equal(data, data + sizeof(data), bytes + 2 * PAGE), "[VFS] Mapped data mismatch");
+
+        // Writes to a shared mapping go to the page cache, every mapping of the page sees them
+        auto writable = vfs::mmap(*fd, PAGE, PROT_READ | PROT_WRITE | MAP_SHARED, 0);
+        kAssert(writable, "[VFS] Failed to map file for writing");
+        ((uint8_t *) *writable)[10] = 0xAB;
+        uint8_t buffer[16] = {};
+        vfs::pread(*fd, buffer, sizeof(buffer), 0);
+        kAssert(buffer[10] == 0xAB && bytes[10] == 0xAB, "[VFS] Write through the mapping was lost");
+        kAssert(vfs::msync(*writable, PAGE) && PageCache::instance().stats().dirty == 0, "[VFS] msync failed");
+
+        // Private writable mappings get their own copy of a page when they write it
+        auto copy = vfs::mmap(*fd, PAGE, PROT_READ | PROT_WRITE | MAP_PRIVATE, 0);
+        kAssert(copy, "[VFS] Failed to map file privately");
+        ((uint8_t *) *copy)[10] = 0x11;
+        vfs::pread(*fd, buffer, sizeof(buffer), 0);
+        kAssert(buffer[10] == 0xAB && bytes[10] == 0xAB && ((uint8_t *) *copy)[10] == 0x11,
+                "[VFS] Private write should not reach the file");
+
+        kAssert(!vfs::rm("mapped_file1"), "[VFS] A mapped file should not be removed");
+        kAssert(vfs::munmap(*shared, 2 * PAGE + sizeof(data)) && vfs::munmap(*writable, PAGE) &&
+                vfs::munmap(*copy, PAGE), "[VFS] munmap failed");
+        kAssert(!vfs::munmap(*copy, PAGE), "[VFS] Mapping was removed twice");
+
+        vfs::close(*fd);
+        kAssert(vfs::rm("mapped_file1"), "[VFS] Unmapped file should be removed");
+    }
+
+    void test_getdents() {
+        const char *names[] = {"gd_file0", "gd_file1", "gd_file2", "gd_file3", "gd_file4"};
+        kAssert(vfs::mkdir("getdents_dir1") && vfs::cd("getdents_dir1"), "[VFS] Failed to make directory");
+        for (auto name: names) {
+            auto fd = vfs::open(name, OPEN_CREATE);
+            kAssert(fd, "[VFS] Failed to create file");
+            vfs::close(*fd);
+        }
+        kAssert(vfs::cd(".."), "[VFS] Failed to change back to parent directory");
+
+        auto dir = vfs::open("getdents_dir1", OPEN_DIRECTORY);
+        kAssert(dir, "[VFS] Failed to open directory");
+
+        // A buffer of two records at most, the listing goes on from where the last call stopped
+        uint8_t buffer[2 * direntRecordSize(8)];
+        size_t files = 0, entries = 0, calls = 0;
+        while (true) {
+            auto used = vfs::getdents(*dir, buffer, sizeof(buffer));
+            kAssert(used, "[VFS] getdents failed");
+            if (!*used)
+                break;
+            calls++;
+            for (size_t position = 0; position < *used;) {
+                auto *record = reinterpret_cast<dirent_record *>(buffer + position);
+                kAssert(record->length % 8 == 0 && position + record->length <= *used, "[VFS] Bad record length");
+                auto name = reinterpret_cast<const char *>(record + 1);
+                kAssert(strlen(name) == record->nameLength, "[VFS] Bad record name");
+                files += record->isFile && name[0] == 'g';
+                entries++;
+                position += record->length;
+            }
+        }
+        kAssert(files == 5 && entries == 7 && calls >= 4, "[VFS] getdents did not list every entry once");
+        kAssert(vfs::getdents(*dir, buffer, sizeof(buffer)).value() == 0, "[VFS] getdents went past the end");
+
+        // Seeking to the cookie of a record lists again from the entry after it
+        uint8_t all[512];
+        kAssert(*vfs::seek(*dir, 0, SEEK_SET) == 0, "[VFS] Failed to rewind directory");
+        auto used = vfs::getdents(*dir, all, sizeof(all));
+        kAssert(used && *used > 0, "[VFS] getdents failed");
+        auto *first = reinterpret_cast<dirent_record *>(all);
+        auto *second = reinterpret_cast<dirent_record *>(all + first->length);
+        auto *third = reinterpret_cast<dirent_record *>(all + first->length + second->length);
+        kAssert(vfs::seek(*dir, (ssize_t) second->cookie, SEEK_SET), "[VFS] Failed to seek directory");
+        kAssert(vfs::getdents(*dir, buffer, sizeof(buffer)), "[VFS] getdents failed after seek");
+        auto *resumed = reinterpret_cast<dirent_record *>(buffer);
+        kAssert(resumed->inum == third->inum && resumed->cookie == third->cookie, "[VFS] Cookie did not resume");
+
+        // Too small for a single record, and data calls don't take a directory
+        kAssert(vfs::getdents(*dir, buffer, 8).error() == std::ERROR_BUFFER_SMALL, "[VFS] Small buffer accepted");
+        kAssert(!vfs::pread(*dir, buffer, 8, 0) && !vfs::seek(*dir, 0, SEEK_END), "[VFS] Directory read as a file");
+        vfs::close(*dir);
+
+        kAssert(vfs::cd("getdents_dir1"), "[VFS] Failed to change directory");
+        for (auto name: names)
+            vfs::rm(name);
+        kAssert(vfs::cd("..") && vfs::rmDir("getdents_dir1"), "[VFS] Failed to remove directory");
+    }
+
+    void test_tmpfs() {
+        // /tmp is mounted by init, its files never reach the disk
+        auto fd = vfs::open("/tmp/tmp_file1", OPEN_CREATE);
+        kAssert(fd, "[VFS] Failed to create file in /tmp");
+
+        const char *text = "scratch data";
+        char buffer[16] = {};
+        size_t length = strlen(text);
+        kAssert(vfs::pwrite(*fd, (const uint8_t *) text, length, 3 * PageCache::PAGE_SIZE).value() == length,
+                "[VFS] Failed to write to /tmp");
+        kAssert(vfs::sync(*fd), "[VFS] Failed to sync /tmp");
+        file_stat st;
+        kAssert(vfs::stat(*fd, st) && st.size == 3 * PageCache::PAGE_SIZE + length && st.blocks == 1,
+                "[VFS] Wrong stat of a file in /tmp");
+        kAssert(vfs::pread(*fd, (uint8_t *) buffer, length, 3 * PageCache::PAGE_SIZE).value() == length &&
+                std::equal(buffer, buffer + length, text), "[VFS] Read back from /tmp mismatch");
+        vfs::close(*fd);
+
+        // Nested paths are walked by tmpfs itself
+        kAssert(vfs::mkdir("/tmp/tmp_dir1") && vfs::open("/tmp/tmp_dir1/lock", OPEN_CREATE),
+                "[VFS] Failed to create nested file in /tmp");
+        auto dir = vfs::open("/tmp/tmp_dir1", OPEN_DIRECTORY);
+        kAssert(dir, "[VFS] Failed to open directory in /tmp");
+        uint8_t records[128];
+        auto used = vfs::getdents(*dir, records, sizeof(records));
+        auto *last = reinterpret_cast<dirent_record *>(records + direntRecordSize(1) + direntRecordSize(2));
+        kAssert(used && *used == direntRecordSize(1) + direntRecordSize(2) + direntRecordSize(4) && last->isFile &&
+                std::string_view(reinterpret_cast<const char *>(last + 1)) == std::string_view("lock"),
+                "[VFS] Wrong listing of a directory in /tmp");
+        vfs::close(*dir);
+
+        kAssert(vfs::rm("/tmp/tmp_file1") && vfs::rmDir("/tmp/tmp_dir1"), "[VFS] Failed to clean up /tmp");
+        kAssert(!vfs::open("/tmp/tmp_dir1/lock", 0), "[VFS] Removed file still in /tmp");
+    }
+
+    void test_path() {
+        // Components come out lazily, without empty ones or "."
+        const char *expected[] = {"a", "..", "b", "c"};
+        size_t count = 0;
+        for (auto component: PathView("//a/./..//b/c/.")) {
+            kAssert(count < 4 && component == std::string_view(expected[count]), "[VFS] Wrong path component");
+            count++;
+        }
+        kAssert(count == 4, "[VFS] Wrong number of path components");
+        PathView view("/mnt/usb/file");
+        kAssert(view.directory() == std::string_view("/mnt/usb/") && view.file_name() == std::string_view("file"),
+                "[VFS] Wrong split of a path view");
+
+        // Owning paths are normalized, long ones leave the inline buffer
+        Path path("/mnt//usb///data");
+        kAssert(path.string() == std::string_view("/mnt/usb/data/") && path.size() == 4 &&
+                path.base_name() == std::string_view("data") && path[2] == std::string_view("usb"),
+                "[VFS] Wrong normalized path");
+        kAssert(path.branch_path() == Path("/mnt/usb") && path.sub_path(2) == Path("usb/data"),
+                "[VFS] Wrong path decomposition");
+
+        char longName[Path::INLINE_CAPACITY + 1] = {};
+        memset(longName, 'x', Path::INLINE_CAPACITY);
+        Path longPath = path / longName;
+        Path moved = std::move(longPath);
+        kAssert(moved.size() == 5 && moved.base_name() == std::string_view(longName) && longPath.empty(),
+                "[VFS] Wrong long path");
+    }
+
+    void test_mount_table() {
+        MountedFS root{PartitionType::SIMPLE_FS, Path{"/"}, nullptr};
+        MountedFS mnt{PartitionType::SIMPLE_FS, Path{"/mnt"}, nullptr};
+        MountedFS usb{PartitionType::SIMPLE_FS, Path{"/mnt/usb"}, nullptr};
+
+        MountTable table;
+        table.add("/", &root);
+        table.add("/mnt", &mnt);
+        table.add("/mnt/usb/", &usb);
+
+        auto check = [&table](const char *path, MountedFS *mount, const char *rest) {
+            std::string normalized;
+            auto resolved = table.resolve(path, normalized);
+            return resolved.mount == mount && std::string_view(resolved.path) == std::string_view(rest);
+        };
+
+        kAssert(check("/file", &root, "file") && check("/mnt2/file", &root, "mnt2/file"),
+                "[VFS] Path should stay on the root mount");
+        kAssert(check("/mnt", &mnt, "") && check("/mnt/", &mnt, "") && check("/mnt/a/b", &mnt, "a/b"),
+                "[VFS] Path should be routed to /mnt");
+        kAssert(check("/mnt/usb/file", &usb, "file") && check("//mnt/./usb", &usb, ""),
+                "[VFS] Path should be routed to the deepest mount");
+        kAssert(check("/mnt/usb/../file", &mnt, "file") && check("/mnt/usb/../../file", &root, "file") &&
+                check("/../mnt/a/../usb", &usb, ""), "[VFS] .. should be resolved before routing");
+
+        // The second lookup in the same directory comes from the memo
+        size_t hits = table.memoHits();
+        kAssert(check("/mnt/a/c", &mnt, "a/c") && table.memoHits() == hits + 1, "[VFS] Directory was not memoized");
+
+        // A new mount hides what was memoized under it
+        MountedFS deeper{PartitionType::SIMPLE_FS, Path{"/mnt/a"}, nullptr};
+        table.add("/mnt/a", &deeper);
+        kAssert(check("/mnt/a/c", &deeper, "c"), "[VFS] Memo was not cleared by mount");
+    }
+
+    void test_locks() {
+        locking::RwLock rw;
+        kAssert(rw.tryLockShared() && rw.tryLockShared() && !rw.tryLock(), "[VFS] Readers should share the lock");
+        rw.unlockShared();
+        rw.unlockShared();
+        kAssert(rw.tryLock() && !rw.tryLockShared() && !rw.tryLock(), "[VFS] A writer should be alone");
+        rw.unlock();
+
+        locking::SeqLock seq;
+        uint32_t start = seq.readBegin();
+        kAssert(!seq.readRetry(start), "[VFS] A read without writers should not retry");
+        seq.writeLock();
+        kAssert(!seq.tryWriteLock(), "[VFS] Two writers at once");
+        seq.writeUnlock();
+        kAssert(seq.readRetry(start), "[VFS] A read across a write should retry");
+
+        // Files on two mounts are written under their own locks
+        auto root = vfs::open("locks_root", OPEN_CREATE);
+        auto tmp = vfs::open("/tmp/locks_tmp", OPEN_CREATE);
+        kAssert(root && tmp, "[VFS] Failed to open files on both mounts");
+        const uint8_t data[] = "both";
+        kAssert(vfs::write(*root, data, sizeof(data)) && vfs::write(*tmp, data, sizeof(data)),
+                "[VFS] Failed to write to both mounts");
+        kAssert(vfs::stat(*root).value() == (ssize_t) sizeof(data) && vfs::stat(*tmp).value() == (ssize_t) sizeof(data),
+                "[VFS] Wrong sizes on both mounts");
+        vfs::close(*root);
+        vfs::close(*tmp);
+        kAssert(vfs::rm("locks_root") && vfs::rm("/tmp/locks_tmp"), "[VFS] Failed to remove the files");
+    }
+
     void test_create_directory() {
         const char *dirName = "new_directory1";
         auto result = vfs::mkdir(dirName);
@@ -73,6 +556,16 @@ namespace vfs {
         kAssert(cdResult, "[VFS] Failed to change back to parent directory");
     }
 
+    void test_pwd_under_mount() {
+        kAssert(vfs::mkdir("/tmp/pwd_dir") && vfs::cd("/tmp/pwd_dir"), "[VFS] Failed to change directory in /tmp");
+        kAssert(vfs::pwd() == "/tmp/pwd_dir", "[VFS] Wrong working directory under a mount");
+
+        kAssert(vfs::cd("..") && vfs::pwd() == "/tmp", "[VFS] Wrong working directory at the root of a mount");
+
+        // The root mount is back in the directory it was left in
+        kAssert(vfs::cd("/") && vfs::rmDir("/tmp/pwd_dir"), "[VFS] Failed to leave /tmp");
+    }
+
     void test_list_directory() {
         auto created = vfs::mkdir("test_dir3");
 
@@ -106,6 +599,39 @@ namespace vfs {
         Logger::instance().println("[VFS] Testing file write...");
         test_write_to_file();
 
+        Logger::instance().println("[VFS] Testing file descriptors...");
+        test_file_descriptors();
+
+        Logger::instance().println("[VFS] Testing page cache...");
+        test_page_cache();
+
+        Logger::instance().println("[VFS] Testing vectored io...");
+        test_vectored_io();
+
+        Logger::instance().println("[VFS] Testing copy_range...");
+        test_copy_range();
+
+        Logger::instance().println("[VFS] Testing submission rings...");
+        test_io_ring();
+
+        Logger::instance().println("[VFS] Testing memory mapped files...");
+        test_mmap();
+
+        Logger::instance().println("[VFS] Testing directory listing...");
+        test_getdents();
+
+        Logger::instance().println("[VFS] Testing tmpfs...");
+        test_tmpfs();
+
+        Logger::instance().println("[VFS] Testing paths...");
+        test_path();
+
+        Logger::instance().println("[VFS] Testing mount routing...");
+        test_mount_table();
+
+        Logger::instance().println("[VFS] Testing locks...");
+        test_locks();
+
         Logger::instance().println("[VFS] Testing directory creation...");
         test_create_directory();
 
@@ -115,6 +641,9 @@ namespace vfs {
         Logger::instance().println("[VFS] Testing directory change...");
         test_change_directory();
 
+        Logger::instance().println("[VFS] Testing working directory under a mount...");
+        test_pwd_under_mount();
+
         Logger::instance().println("[VFS] Testing directory list...");
         test_list_directory();
 
@@ -40,7 +40,7 @@ namespace std {
 
     public:
         // Default constructor
-        vector() : data_(nullptr), capacity_(0), size_(0) {}
+        constexpr vector() : data_(nullptr), capacity_(0), size_(0) {}
 
         explicit vector(const Allocator &alloc) : data_(nullptr), capacity_(0), size_(0),
                                                                 allocator_(alloc) {}
@@ -0,0 +1,204 @@
+/*
+ * locks.h
+ *
+ *  Created on: 10/19/26.
+ */
+
+#pragma once
+
+#include "util/types.h"
+
+/*
+ * Busy-waiting locks, built on the compiler atomics so they need no library support.
+ * There is only one CPU and no scheduler yet, so every lock is free when it is taken and the waiting loops
+ * never spin; they are there so the structures they guard stay correct once threads or other CPUs run.
+ */
+
+namespace locking {
+    /// Index of the CPU running the caller; only the boot processor runs kernel code for now
+    inline uint32_t cpu() {
+        return 0;
+    }
+
+    inline void relax() {
+        asm volatile("pause");
+    }
+
+    class SpinLock {
+    public:
+        bool tryLock() {
+            return !__atomic_exchange_n(&locked, true, __ATOMIC_ACQUIRE);
+        }
+
+        void lock() {
+            while (!tryLock()) {
+                while (__atomic_load_n(&locked, __ATOMIC_RELAXED))
+                    relax();
+            }
+        }
+
+        void unlock() {
+            __atomic_store_n(&locked, false, __ATOMIC_RELEASE);
+        }
+
+    private:
+        bool locked{};
+    };
+
+    /**
+     * @brief A spin lock the CPU that holds it may take again
+     * For paths that can re-enter themselves, like a page fault raised while the lock is held
+     */
+    class RecursiveSpinLock {
+    public:
+        void lock() {
+            uint32_t self = cpu() + 1;
+            if (__atomic_load_n(&owner, __ATOMIC_RELAXED) != self) {
+                inner.lock();
+                __atomic_store_n(&owner, self, __ATOMIC_RELAXED);
+            }
+            depth++;
+        }
+
+        void unlock() {
+            if (--depth == 0) {
+                __atomic_store_n(&owner, 0, __ATOMIC_RELAXED);
+                inner.unlock();
+            }
+        }
+
+    private:
+        SpinLock inner;
+        uint32_t owner{}; ///> CPU index + 1, 0 while free
+        uint32_t depth{};
+    };
+
+    /**
+     * @brief Any number of readers or a single writer
+     * A waiting writer stops new readers from coming in, so writers are not starved by a stream of readers.
+     */
+    class RwLock {
+    public:
+        bool tryLockShared() {
+            uint32_t current = __atomic_load_n(&state, __ATOMIC_RELAXED);
+            return !(current & (WRITER | WRITER_WAITING)) &&
+                   __atomic_compare_exchange_n(&state, &current, current + 1, false, __ATOMIC_ACQUIRE,
+                                               __ATOMIC_RELAXED);
+        }
+
+        void lockShared() {
+            while (!tryLockShared())
+                relax();
+        }
+
+        void unlockShared() {
+            __atomic_fetch_sub(&state, 1, __ATOMIC_RELEASE);
+        }
+
+        bool tryLock() {
+            uint32_t current = __atomic_load_n(&state, __ATOMIC_RELAXED);
+            return !(current & ~WRITER_WAITING) &&
+                   __atomic_compare_exchange_n(&state, &current, WRITER, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+        }
+
+        void lock() {
+            while (!tryLock()) {
+                __atomic_fetch_or(&state, WRITER_WAITING, __ATOMIC_RELAXED);
+                relax();
+            }
+        }
+
+        void unlock() {
+            __atomic_store_n(&state, 0, __ATOMIC_RELEASE);
+        }
+
+    private:
+        static constexpr const uint32_t WRITER = 1u << 31;
+        static constexpr const uint32_t WRITER_WAITING = 1u << 30;
+
+        uint32_t state{}; ///> Number of readers in the low bits
+    };
+
+    /**
+     * @brief Readers don't write anything, they retry if a writer was active while they read
+     *
+     * The sequence is odd while a write is in progress. A reader notes it with readBegin, copies what it needs and
+     * checks readRetry; the copy is only valid if no write started or ended in between. Readers must not follow
+     * pointers that a writer may free, only copy plain data.
+     */
+    class SeqLock {
+    public:
+        [[nodiscard]] uint32_t readBegin() const {
+            uint32_t sequence;
+            while ((sequence = __atomic_load_n(&this->sequence, __ATOMIC_ACQUIRE)) & 1)
+                relax();
+            return sequence;
+        }
+
+        [[nodiscard]] bool readRetry(uint32_t start) const {
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            return __atomic_load_n(&sequence, __ATOMIC_RELAXED) != start;
+        }
+
+        bool tryWriteLock() {
+            uint32_t current = __atomic_load_n(&sequence, __ATOMIC_RELAXED);
+            if ((current & 1) ||
+                !__atomic_compare_exchange_n(&sequence, &current, current + 1, false, __ATOMIC_ACQUIRE,
+                                             __ATOMIC_RELAXED))
+                return false;
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            return true;
+        }
+
+        void writeLock() {
+            while (!tryWriteLock())
+                relax();
+        }
+
+        void writeUnlock() {
+            __atomic_fetch_add(&sequence, 1, __ATOMIC_RELEASE);
+        }
+
+    private:
+        uint32_t sequence{};
+    };
+
+    /// Holds an exclusive lock for its scope
+    template<typename Lock>
+    class Guard {
+    public:
+        explicit Guard(Lock &lock) : lock(lock) {
+            lock.lock();
+        }
+
+        ~Guard() {
+            lock.unlock();
+        }
+
+        Guard(const Guard &) = delete;
+
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        Lock &lock;
+    };
+
+    /// Holds a reader/writer lock shared for its scope
+    class SharedGuard {
+    public:
+        explicit SharedGuard(RwLock &lock) : lock(lock) {
+            lock.lockShared();
+        }
+
+        ~SharedGuard() {
+            lock.unlockShared();
+        }
+
+        SharedGuard(const SharedGuard &) = delete;
+
+        SharedGuard &operator=(const SharedGuard &) = delete;
+
+    private:
+        RwLock &lock;
+    };
+}
@@ -61,20 +61,35 @@ extern "C" void kernel_main(uint64_t multibootAndMagic) {
     // [ATA] initializing disk
     // Constructor also sets up interrupt handler
     ata::Ata ata0m{ata::ATA_PRIMARY, true};
-    ata0m.identity();
+    kAssert(ata0m.identity(), "[ATA] No disk on the primary channel");
+#ifdef BOSS_DISK_TEST
+    // Writes over the first blocks of the disk, so it is only built in with -DBOSS_DISK_TEST=ON
     ata0m.test();
+#endif
+    // A second disk is optional, the secondary master is often the CD-ROM
+    ata::Ata ata1m{ata::ATA_SECONDARY, true};
+    bool secondDisk = ata1m.identity();
     /* Ata ata0s{ata::ATA_PRIMARY, false};
-     * Ata ata1m{ata::ATA_SECONDARY, true};
      * Ata ata1s{ata::ATA_SECONDARY, false}; */
 
     // [SimpleFS]
     Console::instance().println("Enabling the file system...");
     simple_fs::SimpleFS simpleFs{&ata0m};
-    simpleFs.format();
+    // Images built by tools/simplefs are already formatted and may hold files
+    if (!simpleFs.formatted())
+        simpleFs.format();
     simpleFs.debug();
 
     // [VFS]
     vfs::init(&ata0m);
+    if (secondDisk) {
+        // The second disk may hold anything, it is only mounted if it already has a SimpleFS on it
+        simple_fs::SimpleFS secondFs{&ata1m};
+        if (secondFs.formatted())
+            kAssert(vfs::mount(vfs::PartitionType::SIMPLE_FS, "/mnt", &ata1m), "Error mounting the second disk");
+        else
+            Logger::instance().println("[MAIN] The second disk has no SimpleFS, it is not mounted");
+    }
     vfs::test();
 
     // [SYSCALL]
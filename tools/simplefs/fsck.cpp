@@ -0,0 +1,250 @@
+/*
+ * fsck.cpp
+ *
+ *  Created on: 10/18/26.
+ */
+
+#include "image.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace simple_fs::tool {
+    namespace {
+        constexpr const uint32_t KNOWN_FLAGS = INODE_VALID | INODE_COMPRESSED | INODE_INLINE | INODE_CONTINUATION;
+        constexpr const uint32_t CHUNK_BLOCKS = 64; ///> Inode blocks read with one call
+
+        enum class InodeState : uint8_t {
+            FREE, FILE, CONTINUATION
+        };
+
+        /**
+         * @brief Walks the inode table and then the directory area once, in disk order
+         *
+         * Every data block reached from an inode is marked in a bitmap, which catches blocks shared by two files.
+         * Directory entries are counted per inode, every used inode has to be referenced exactly once.
+         */
+        struct Checker {
+            Image &image;
+            uint8_t *blocks; ///> Data blocks already claimed
+            InodeState *inodes;
+            uint8_t *references; ///> Number of directory entries pointing at each inode
+            bool *dirs; ///> Valid directories
+            uint32_t errors{}, files{}, directories{}, dataBlocks{};
+
+            explicit Checker(Image &image) : image(image) {
+                blocks = new uint8_t[image.super.Blocks]{};
+                inodes = new InodeState[image.super.Inodes]{};
+                references = new uint8_t[image.super.Inodes]{};
+                dirs = new bool[image.super.DirBlocks * DIR_PER_BLOCK]{};
+            }
+
+            ~Checker() {
+                delete[] blocks;
+                delete[] inodes;
+                delete[] references;
+                delete[] dirs;
+            }
+
+            __attribute__((format(printf, 2, 3))) void error(const char *format, ...) {
+                va_list args;
+                va_start(args, format);
+                fprintf(stderr, "[FSCK] ");
+                vfprintf(stderr, format, args);
+                fprintf(stderr, "\n");
+                va_end(args);
+                errors++;
+            }
+
+            void claim(uint32_t inumber, const Inode &node, BlockPointer ptr, uint32_t index) {
+                BlockPointer start;
+                uint32_t count;
+                node.extent(ptr, start, count);
+
+                if ((node.Valid & INODE_COMPRESSED) && (ptr >> cluster::BLOCK_BITS) > 0x3) {
+                    error("Inode %u: invalid cluster pointer %X", inumber, ptr);
+                    return;
+                }
+                if (start < image.super.dataStart || start + count > image.super.dataEnd) {
+                    error("Inode %u: pointer %u is outside of the data area", inumber, start);
+                    return;
+                }
+
+                uint32_t unit = (node.Valid & INODE_COMPRESSED) ? CLUSTER_SIZE : BLOCK_SIZE;
+                /// Only preallocated blocks may lie past the end of the file
+                if ((uint64_t) index * unit >= node.Size && !(ptr & POINTER_UNWRITTEN))
+                    error("Inode %u: block %u is past the end of the file", inumber, start);
+
+                for (uint32_t i = start; i < start + count; i++) {
+                    if (blocks[i])
+                        error("Inode %u: block %u is used twice", inumber, i);
+                    blocks[i] = 1;
+                    dataBlocks++;
+                }
+            }
+
+            void checkInode(uint32_t inumber, const Inode &node) {
+                if (node.Valid & ~KNOWN_FLAGS)
+                    error("Inode %u: unknown flags %X", inumber, node.Valid);
+
+                if (node.Valid & INODE_INLINE) {
+                    if (node.Size > INLINE_MAX_SIZE)
+                        error("Inode %u: inline file of %u bytes", inumber, node.Size);
+                    return;
+                }
+
+                uint32_t unit = (node.Valid & INODE_COMPRESSED) ? CLUSTER_SIZE : BLOCK_SIZE;
+                if (node.Size > MAX_FILE_BLOCKS * unit)
+                    error("Inode %u: size %u is too large", inumber, node.Size);
+
+                for (uint32_t i = 0; i < POINTERS_PER_INODE; i++) {
+                    if (node.Direct[i])
+                        claim(inumber, node, node.Direct[i], i);
+                }
+
+                if (!node.Indirect)
+                    return;
+                if (node.Indirect < image.super.dataStart || node.Indirect >= image.super.dataEnd) {
+                    error("Inode %u: indirect block %u is outside of the data area", inumber, node.Indirect);
+                    return;
+                }
+                if (blocks[node.Indirect])
+                    error("Inode %u: block %u is used twice", inumber, node.Indirect);
+                blocks[node.Indirect] = 1;
+                dataBlocks++;
+
+                Block indirect;
+                if (!image.read(node.Indirect, indirect.data)) {
+                    errors++;
+                    return;
+                }
+                for (uint32_t i = 0; i < POINTERS_PER_BLOCK; i++) {
+                    if (indirect.pointers[i])
+                        claim(inumber, node, indirect.pointers[i], POINTERS_PER_INODE + i);
+                }
+            }
+
+            void checkInodeTable() {
+                Block *chunk = new Block[CHUNK_BLOCKS];
+
+                for (uint32_t first = 0; first < image.super.InodeBlocks; first += CHUNK_BLOCKS) {
+                    uint32_t count = std::min(CHUNK_BLOCKS, image.super.InodeBlocks - first);
+                    if (!image.read(first + 1, chunk, count)) {
+                        errors++;
+                        break;
+                    }
+
+                    for (uint32_t b = 0; b < count; b++) {
+                        /// Continuation slots have to follow their inline inode, inside the same block
+                        uint32_t pending = 0;
+                        for (uint32_t j = 0; j < INODES_PER_BLOCK; j++) {
+                            const Inode &node = chunk[b].inodes[j];
+                            uint32_t inumber = (first + b) * INODES_PER_BLOCK + j;
+
+                            if (pending) {
+                                if (node.Valid != INODE_CONTINUATION)
+                                    error("Inode %u: expected a continuation slot", inumber);
+                                inodes[inumber] = InodeState::CONTINUATION;
+                                pending--;
+                                continue;
+                            }
+
+                            if (!node.Valid)
+                                continue;
+                            if (node.Valid & INODE_CONTINUATION) {
+                                error("Inode %u: continuation slot without an inline inode", inumber);
+                                continue;
+                            }
+
+                            inodes[inumber] = InodeState::FILE;
+                            files++;
+                            checkInode(inumber, node);
+
+                            if ((node.Valid & INODE_INLINE) && node.Size <= INLINE_MAX_SIZE) {
+                                pending = inline_slots(node.Size);
+                                if (j + pending >= INODES_PER_BLOCK)
+                                    error("Inode %u: inline data crosses the inode block", inumber);
+                            }
+                        }
+                    }
+                }
+
+                delete[] chunk;
+            }
+
+            void checkDirectories() {
+                const uint32_t slots = image.super.DirBlocks * DIR_PER_BLOCK;
+
+                /// Parent links are checked once every directory is known
+                uint32_t *links = new uint32_t[slots * ENTRIES_PER_DIR];
+                uint32_t linkCount = 0;
+
+                Block block;
+                for (uint32_t i = 0; i < image.super.DirBlocks; i++) {
+                    if (!image.read(image.super.Blocks - 1 - i, block.data)) {
+                        errors++;
+                        break;
+                    }
+
+                    for (uint32_t k = 0; k < DIR_PER_BLOCK; k++) {
+                        const Directory &dir = block.Directories[k];
+                        uint32_t inum = i * DIR_PER_BLOCK + k;
+                        if (!dir.Valid)
+                            continue;
+
+                        dirs[inum] = true;
+                        directories++;
+                        if (dir.inum != inum)
+                            error("Directory %u: stored with number %u", inum, dir.inum);
+
+                        for (const auto &entry: dir.Table) {
+                            if (!entry.valid)
+                                continue;
+                            if (strnlen(entry.Name, NAME_SIZE) == NAME_SIZE) {
+                                error("Directory %u: name is not terminated", inum);
+                                continue;
+                            }
+
+                            if (!entry.isFile) {
+                                links[linkCount++] = entry.inum;
+                                continue;
+                            }
+
+                            if (entry.inum >= image.super.Inodes || inodes[entry.inum] != InodeState::FILE)
+                                error("Directory %u: %s points to invalid inode %u", inum, entry.Name, entry.inum);
+                            else if (references[entry.inum]++)
+                                error("Directory %u: inode %u of %s is linked twice", inum, entry.inum, entry.Name);
+                        }
+                    }
+                }
+
+                if (!dirs[0])
+                    error("The root directory is missing");
+                for (uint32_t i = 0; i < linkCount; i++) {
+                    if (links[i] >= slots || !dirs[links[i]])
+                        error("Entry points to invalid directory %u", links[i]);
+                }
+                delete[] links;
+
+                for (uint32_t inumber = 0; inumber < image.super.Inodes; inumber++) {
+                    if (inodes[inumber] == InodeState::FILE && !references[inumber])
+                        error("Inode %u is not linked from any directory", inumber);
+                }
+            }
+        };
+    }
+
+    bool fsck(Image &image) {
+        if (!image.loadSuper())
+            return false;
+
+        Checker checker{image};
+        checker.checkInodeTable();
+        checker.checkDirectories();
+
+        printf("[FSCK] %u files, %u directories, %u of %u data blocks used, %u errors\n", checker.files,
+               checker.directories, checker.dataBlocks, image.super.dataEnd - image.super.dataStart, checker.errors);
+        return checker.errors == 0;
+    }
+}
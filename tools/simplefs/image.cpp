@@ -0,0 +1,124 @@
+/*
+ * image.cpp
+ *
+ *  Created on: 10/18/26.
+ */
+
+#include "image.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace simple_fs::tool {
+    bool Image::open(const char *path, bool create) {
+        fd = ::open(path, O_RDWR | (create ? O_CREAT : 0), 0644);
+        if (fd < 0) {
+            fprintf(stderr, "[SIMPLE_FS] Can't open %s: %s\n", path, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    void Image::close() {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+    bool Image::read(uint32_t block, void *data, uint32_t count) {
+        size_t length = (size_t) count * BLOCK_SIZE;
+        if (pread(fd, data, length, (off_t) block * BLOCK_SIZE) != (ssize_t) length) {
+            fprintf(stderr, "[SIMPLE_FS] Failed to read block %u\n", block);
+            return false;
+        }
+        return true;
+    }
+
+    bool Image::write(uint32_t block, const void *data, uint32_t count) {
+        size_t length = (size_t) count * BLOCK_SIZE;
+        if (pwrite(fd, data, length, (off_t) block * BLOCK_SIZE) != (ssize_t) length) {
+            fprintf(stderr, "[SIMPLE_FS] Failed to write block %u\n", block);
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t Image::size() const {
+        struct stat st{};
+        if (fstat(fd, &st))
+            return 0;
+        return st.st_size / BLOCK_SIZE;
+    }
+
+    bool Image::loadSuper() {
+        Block block;
+        if (!read(0, block.data))
+            return false;
+
+        if (block.super.MagicNumber != MAGIC_NUMBER) {
+            fprintf(stderr, "[SIMPLE_FS] Magic number is invalid\n");
+            return false;
+        }
+        if (!(block.super == SuperBlock{block.super.Blocks}) || block.super.Blocks < MIN_BLOCKS) {
+            fprintf(stderr, "[SIMPLE_FS] SuperBlock is invalid\n");
+            return false;
+        }
+        if (block.super.Blocks > size()) {
+            fprintf(stderr, "[SIMPLE_FS] The image is smaller than the file system\n");
+            return false;
+        }
+
+        super = block.super;
+        return true;
+    }
+
+    bool format(Image &image, uint32_t blocks) {
+        if (blocks < MIN_BLOCKS) {
+            fprintf(stderr, "[SIMPLE_FS] An image needs at least %u blocks\n", MIN_BLOCKS);
+            return false;
+        }
+
+        /// Truncating first leaves every block zeroed, without writing the data area
+        if (ftruncate(image.fd, 0) || ftruncate(image.fd, (off_t) blocks * BLOCK_SIZE)) {
+            fprintf(stderr, "[SIMPLE_FS] Failed to resize image: %s\n", strerror(errno));
+            return false;
+        }
+
+        Block block;
+        block.super = SuperBlock(blocks);
+        image.super = block.super;
+        if (!image.write(0, block.data))
+            return false;
+
+        /// Directory blocks hold invalid directories, the last one starts with the root
+        for (uint32_t i = image.super.dirStart; i < image.super.Blocks; i++) {
+            for (auto &dir: block.Directories)
+                dir = Directory{};
+
+            if (i == image.super.Blocks - 1) {
+                Directory &root = block.Directories[0];
+                strcpy(root.Name, "/");
+                root.inum = 0;
+                root.Valid = true;
+
+                /// Both . and .. point to the root
+                const char *names[] = {".", ".."};
+                for (uint32_t k = 0; k < 2; k++) {
+                    root.Table[k].inum = 0;
+                    root.Table[k].isFile = false;
+                    root.Table[k].valid = true;
+                    strcpy(root.Table[k].Name, names[k]);
+                }
+            }
+
+            if (!image.write(i, block.data))
+                return false;
+        }
+
+        return true;
+    }
+}
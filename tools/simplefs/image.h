@@ -0,0 +1,64 @@
+/*
+ * image.h
+ *
+ *  Created on: 10/18/26.
+ */
+
+#pragma once
+
+#include "fs/simple_fs_structures.h"
+
+namespace simple_fs::tool {
+    constexpr const uint32_t MIN_BLOCKS = 100; ///> Smallest image with at least one inode and one directory block
+    constexpr const uint32_t MAX_FILE_BLOCKS = POINTERS_PER_INODE + POINTERS_PER_BLOCK; ///> Limit of uncompressed files
+
+    /**
+     * @brief A SimpleFS disk image on the host, accessed in blocks
+     */
+    struct Image {
+        int fd{-1};
+        SuperBlock super{};
+
+        /**
+         * @brief Opens the image file
+         * @param create create the file if it does not exist
+         */
+        bool open(const char *path, bool create);
+
+        void close();
+
+        /// Reads count consecutive blocks starting at block
+        bool read(uint32_t block, void *data, uint32_t count = 1);
+
+        /// Writes count consecutive blocks starting at block
+        bool write(uint32_t block, const void *data, uint32_t count = 1);
+
+        /// Size of the image file in blocks
+        uint32_t size() const;
+
+        /**
+         * @brief Reads and validates the superblock, the same way SimpleFS::mount does
+         */
+        bool loadSuper();
+    };
+
+    /**
+     * @brief Formats the image exactly like SimpleFS::format: superblock, empty tables and the root directory
+     * @param blocks size of the file system; the image file is resized to it
+     */
+    bool format(Image &image, uint32_t blocks);
+
+    /**
+     * @brief Copies a host directory tree into the root directory of a freshly formatted image
+     *
+     * Every file gets one contiguous run of blocks, with the indirect block right before the data,
+     * files that fit are stored inline in the inode block.
+     */
+    bool import(Image &image, const char *path);
+
+    /**
+     * @brief Checks the consistency of the image, reading every metadata block once
+     * @return true if no errors were found
+     */
+    bool fsck(Image &image);
+}
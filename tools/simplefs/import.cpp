@@ -0,0 +1,262 @@
+/*
+ * import.cpp
+ *
+ *  Created on: 10/18/26.
+ */
+
+#include "image.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace simple_fs::tool {
+    namespace {
+        /**
+         * @brief Builds the tables in memory, only the data is written while importing
+         *
+         * Inodes, data blocks and directories are handed out in order, so every file ends up
+         * in a single run right after the previous one. The tables are written once at the end.
+         */
+        struct Builder {
+            Image &image;
+            Block *inodes; ///> The whole inode table
+            Directory *dirs; ///> Every directory slot, indexed by the inum of the directory
+            uint32_t nextInode{};
+            uint32_t nextBlock;
+            uint32_t nextDir{1}; ///> Directory 0 is the root
+            uint32_t files{}, inlineFiles{};
+
+            explicit Builder(Image &image) : image(image), nextBlock(image.super.dataStart) {
+                inodes = new Block[image.super.InodeBlocks];
+                dirs = new Directory[image.super.DirBlocks * DIR_PER_BLOCK];
+            }
+
+            ~Builder() {
+                delete[] inodes;
+                delete[] dirs;
+            }
+
+            Inode &inode(uint32_t inumber) {
+                return inodes[inumber / INODES_PER_BLOCK].inodes[inumber % INODES_PER_BLOCK];
+            }
+
+            bool addEntry(Directory &dir, uint32_t inum, bool isFile, const char *name) {
+                if (strlen(name) >= NAME_SIZE) {
+                    fprintf(stderr, "[SIMPLE_FS] Name %s is longer than %u characters\n", name, NAME_SIZE - 1);
+                    return false;
+                }
+
+                for (auto &entry: dir.Table) {
+                    if (!entry.valid) {
+                        entry.inum = inum;
+                        entry.isFile = isFile;
+                        entry.valid = true;
+                        strcpy(entry.Name, name);
+                        return true;
+                    }
+                }
+
+                fprintf(stderr, "[SIMPLE_FS] Directory %s has more than %u entries\n", dir.Name, ENTRIES_PER_DIR - 2);
+                return false;
+            }
+
+            /// Same layout as SimpleFS::write produces for a file that fits inline
+            bool storeInline(uint32_t inumber, const uint8_t *data, uint32_t size) {
+                uint32_t slots = inline_slots(size);
+                Inode &node = inode(inumber);
+                node.Valid = INODE_VALID | INODE_INLINE;
+                node.Size = size;
+
+                uint32_t chunk = std::min(size, INLINE_SIZE);
+                memcpy(node.inline_data(), data, chunk);
+                for (uint32_t k = 1; k <= slots; k++) {
+                    Inode &slot = inode(inumber + k);
+                    slot.Valid = INODE_CONTINUATION;
+                    uint32_t rest = std::min(size - chunk, CONTINUATION_SIZE);
+                    memcpy(slot.continuation_data(), data + chunk, rest);
+                    chunk += rest;
+                }
+
+                nextInode += slots;
+                inlineFiles++;
+                return true;
+            }
+
+            bool storeBlocks(uint32_t inumber, uint8_t *data, uint32_t size) {
+                uint32_t blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+                if (blocks > MAX_FILE_BLOCKS) {
+                    fprintf(stderr, "[SIMPLE_FS] Files can have at most %u bytes\n", MAX_FILE_BLOCKS * BLOCK_SIZE);
+                    return false;
+                }
+
+                bool indirect = blocks > POINTERS_PER_INODE;
+                if (nextBlock + blocks + indirect > image.super.dataEnd) {
+                    fprintf(stderr, "[SIMPLE_FS] The image is full\n");
+                    return false;
+                }
+
+                Inode &node = inode(inumber);
+                node.Valid = INODE_VALID;
+                node.Size = size;
+
+                /// The indirect block goes right before the data, in the order a read touches them
+                Block pointers;
+                if (indirect)
+                    node.Indirect = nextBlock++;
+                for (uint32_t i = 0; i < blocks; i++) {
+                    if (i < POINTERS_PER_INODE)
+                        node.Direct[i] = nextBlock + i;
+                    else
+                        pointers.pointers[i - POINTERS_PER_INODE] = nextBlock + i;
+                }
+
+                if (indirect && !image.write(node.Indirect, pointers.data))
+                    return false;
+
+                /// The buffer is padded with zeroes to whole blocks
+                if (!image.write(nextBlock, data, blocks))
+                    return false;
+                nextBlock += blocks;
+                return true;
+            }
+
+            bool importFile(const char *path, const char *name, Directory &parent) {
+                FILE *file = fopen(path, "rb");
+                if (!file) {
+                    fprintf(stderr, "[SIMPLE_FS] Can't read %s\n", path);
+                    return false;
+                }
+
+                uint8_t *data = (uint8_t *) calloc(MAX_FILE_BLOCKS + 1, BLOCK_SIZE);
+                size_t size = fread(data, 1, (MAX_FILE_BLOCKS + 1) * BLOCK_SIZE, file);
+                fclose(file);
+
+                bool success = nextInode < image.super.Inodes;
+                if (!success)
+                    fprintf(stderr, "[SIMPLE_FS] Out of inodes\n");
+
+                uint32_t inumber = nextInode;
+                if (success) {
+                    /// Continuation slots never cross into the next inode block, like in SimpleFS::inline_fits
+                    bool fits = size && size <= INLINE_MAX_SIZE &&
+                                inumber % INODES_PER_BLOCK + inline_slots(size) < INODES_PER_BLOCK;
+                    if (fits)
+                        success = storeInline(inumber, data, size);
+                    else if (size)
+                        success = storeBlocks(inumber, data, size);
+                    else
+                        inode(inumber).Valid = INODE_VALID;
+                }
+                free(data);
+
+                if (!success || !addEntry(parent, inumber, true, name))
+                    return false;
+
+                nextInode++;
+                files++;
+                return true;
+            }
+
+            bool importDir(const char *path, Directory &dir) {
+                DIR *host = opendir(path);
+                if (!host) {
+                    fprintf(stderr, "[SIMPLE_FS] Can't open directory %s\n", path);
+                    return false;
+                }
+
+                /// Entries are sorted, so the same tree always gives the same image
+                char names[ENTRIES_PER_DIR][NAME_SIZE];
+                uint32_t count = 0;
+                bool success = true;
+                while (struct dirent *entry = readdir(host)) {
+                    if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+                        continue;
+                    if (strlen(entry->d_name) >= NAME_SIZE || count == ENTRIES_PER_DIR - 2) {
+                        fprintf(stderr, "[SIMPLE_FS] %s/%s does not fit: names have at most %u characters, "
+                                        "directories at most %u entries\n", path, entry->d_name, NAME_SIZE - 1,
+                                ENTRIES_PER_DIR - 2);
+                        success = false;
+                        break;
+                    }
+                    strcpy(names[count++], entry->d_name);
+                }
+                closedir(host);
+                qsort(names, count, NAME_SIZE, [](const void *a, const void *b) {
+                    return strcmp((const char *) a, (const char *) b);
+                });
+
+                char child[4096];
+                for (uint32_t i = 0; i < count && success; i++) {
+                    snprintf(child, sizeof(child), "%s/%s", path, names[i]);
+
+                    struct stat st{};
+                    if (stat(child, &st)) {
+                        fprintf(stderr, "[SIMPLE_FS] Can't stat %s\n", child);
+                        success = false;
+                    } else if (S_ISREG(st.st_mode)) {
+                        success = importFile(child, names[i], dir);
+                    } else if (S_ISDIR(st.st_mode)) {
+                        success = importSubdir(child, names[i], dir);
+                    } else {
+                        fprintf(stderr, "[SIMPLE_FS] Skipping %s, it is not a file or a directory\n", child);
+                    }
+                }
+
+                return success;
+            }
+
+            /// Same layout as SimpleFS::mkdir
+            bool importSubdir(const char *path, const char *name, Directory &parent) {
+                if (nextDir == image.super.DirBlocks * DIR_PER_BLOCK) {
+                    fprintf(stderr, "[SIMPLE_FS] Out of directories\n");
+                    return false;
+                }
+
+                Directory &dir = dirs[nextDir];
+                dir.inum = nextDir++;
+                dir.Valid = true;
+                strcpy(dir.Name, name);
+                if (!addEntry(dir, dir.inum, false, ".") || !addEntry(dir, parent.inum, false, "..") ||
+                    !addEntry(parent, dir.inum, false, name))
+                    return false;
+
+                return importDir(path, dir);
+            }
+
+            /// The tables are written in one go, the directory blocks are stored from the end of the disk
+            bool flush() {
+                if (!image.write(1, inodes, image.super.InodeBlocks))
+                    return false;
+
+                Block block;
+                for (uint32_t i = 0; i < image.super.DirBlocks; i++) {
+                    for (uint32_t k = 0; k < DIR_PER_BLOCK; k++)
+                        block.Directories[k] = dirs[i * DIR_PER_BLOCK + k];
+                    if (!image.write(image.super.Blocks - 1 - i, block.data))
+                        return false;
+                }
+                return true;
+            }
+        };
+    }
+
+    bool import(Image &image, const char *path) {
+        Builder builder{image};
+
+        /// Start from the root directory written by format
+        Block block;
+        if (!image.read(image.super.Blocks - 1, block.data))
+            return false;
+        builder.dirs[0] = block.Directories[0];
+
+        if (!builder.importDir(path, builder.dirs[0]) || !builder.flush())
+            return false;
+
+        printf("[SIMPLE_FS] Imported %u files (%u inline) and %u directories into %u data blocks\n",
+               builder.files, builder.inlineFiles, builder.nextDir - 1, builder.nextBlock - image.super.dataStart);
+        return true;
+    }
+}
@@ -0,0 +1,76 @@
+/*
+ * main.cpp
+ *
+ *  Created on: 10/18/26.
+ */
+
+#include "image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace simple_fs;
+
+namespace {
+    void usage() {
+        fprintf(stderr, "Usage:\n"
+                        "  simplefs format <image> [size]        create an empty file system\n"
+                        "  simplefs import <image> <dir> [size]  create a file system holding the tree at dir\n"
+                        "  simplefs fsck <image>                 check the consistency of a file system\n"
+                        "The size is in blocks of %u bytes, or in bytes with a K or M suffix.\n"
+                        "Without a size, the current size of the image is used.\n", BLOCK_SIZE);
+    }
+
+    /// Returns 0 for sizes that can't be parsed
+    uint32_t parseSize(const char *text) {
+        char *end;
+        unsigned long long value = strtoull(text, &end, 10);
+        if (!strcmp(end, "K"))
+            value = value * 1024 / BLOCK_SIZE;
+        else if (!strcmp(end, "M"))
+            value = value * 1024 * 1024 / BLOCK_SIZE;
+        else if (*end)
+            return 0;
+
+        /// Block numbers of compressed files have 28 bits
+        return value <= cluster::BLOCK_MASK ? value : 0;
+    }
+
+    bool openAndFormat(tool::Image &image, const char *path, const char *size) {
+        if (!image.open(path, true))
+            return false;
+
+        uint32_t blocks = size ? parseSize(size) : image.size();
+        if (!blocks) {
+            fprintf(stderr, "[SIMPLE_FS] Invalid size\n");
+            return false;
+        }
+        return tool::format(image, blocks);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage();
+        return 2;
+    }
+
+    const char *command = argv[1];
+    tool::Image image;
+    bool success;
+
+    if (!strcmp(command, "format") && argc <= 4) {
+        success = openAndFormat(image, argv[2], argc == 4 ? argv[3] : nullptr);
+    } else if (!strcmp(command, "import") && (argc == 4 || argc == 5)) {
+        success = openAndFormat(image, argv[2], argc == 5 ? argv[4] : nullptr) && tool::import(image, argv[3]);
+    } else if (!strcmp(command, "fsck") && argc == 3) {
+        success = image.open(argv[2], false) && tool::fsck(image);
+    } else {
+        usage();
+        return 2;
+    }
+
+    image.close();
+    return success ? 0 : 1;
+}